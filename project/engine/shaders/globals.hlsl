@@ -57,6 +57,10 @@ cbuffer PerView : register(b4)
     float g_EV_100;
     // 0 - bottom_left, 1 - top_left, 2 - bottom_right
     float4 g_frustum_corners[3];
+    // see LightClusters
+    float g_cluster_near;
+    float g_cluster_slice_scale;
+    float2 padding_per_view_0;
 };
 
 #endif
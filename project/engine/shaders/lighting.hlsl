@@ -7,6 +7,24 @@ TextureCube g_reflection : register(t8);
 
 TextureCubeArray<float4> g_shadow_maps : register(t9);
 
+// the same layout as LightSystem::GPUPointLight
+struct PointLight
+{
+    float3 position;
+    float radius;
+    float3 radiance;
+    float range;
+};
+
+// see LightClusters, point lights with index < g_POINT_LIGHTS_COUNT have shadows
+StructuredBuffer<PointLight> g_lights : register(t15);
+StructuredBuffer<uint2> g_light_clusters : register(t16); // offset and count in g_light_indices
+StructuredBuffer<uint> g_light_indices : register(t17);
+
+static const uint g_CLUSTER_TILES_X = 16;
+static const uint g_CLUSTER_TILES_Y = 9;
+static const uint g_CLUSTER_SLICES = 24;
+
 static const float g_DEPTH_OFFSET = 0.005f;
 static const float g_TRANSMITTANCE_POWER = 32.0f;
 
@@ -42,9 +60,10 @@ float calculateShadowCoefficient(float3 pos_WS,
     pos_WS += N * normal_offset; // affects only sample_dir, but not comp_depth
     float3 sample_dir = pos_WS - light_pos_WS;
 
-    float visibility = g_shadow_maps.SampleCmp(g_comparison_sampler,
-                                               float4(sample_dir, cubemap_index),
-                                               comp_depth);
+    // the shadow maps have no mips, the level is explicit for the dynamic loops
+    float visibility = g_shadow_maps.SampleCmpLevelZero(g_comparison_sampler,
+                                                        float4(sample_dir, cubemap_index),
+                                                        comp_depth);
     
     return 1.0f - visibility;
 }
@@ -85,6 +104,30 @@ void clampDirToHorizon(inout float3 dir,
     }
 }
 
+uint calculateClusterIndex(float3 pos_WS)
+{
+    float4 pos_CS = mul(float4(pos_WS, 1.0f), g_proj_view);
+    float2 ndc = pos_CS.xy / pos_CS.w;
+    float depth = pos_CS.w; // view space
+
+    uint2 tile = min(uint2(saturate(ndc * 0.5f + 0.5f) * float2(g_CLUSTER_TILES_X, g_CLUSTER_TILES_Y)),
+                     uint2(g_CLUSTER_TILES_X - 1, g_CLUSTER_TILES_Y - 1));
+    uint slice = min(uint(max(log(depth / g_cluster_near) * g_cluster_slice_scale, 0.0f)),
+                     g_CLUSTER_SLICES - 1);
+
+    return (slice * g_CLUSTER_TILES_Y + tile.y) * g_CLUSTER_TILES_X + tile.x;
+}
+
+// smooth cutoff at the light range, so the cluster borders aren't visible
+float calculateRangeFading(float L_length,
+                           float range)
+{
+    float ratio = L_length / range;
+    float fading = saturate(1.0f - ratio * ratio * ratio * ratio);
+
+    return fading * fading;
+}
+
 float calculateSolidAngle(float L_length,
                           float radius)
 {
@@ -277,10 +320,15 @@ float3 calculatePointLights(float3 albedo,
                             float3 pos_WS)
 {
     float3 color = float3(0.0f, 0.0f, 0.0f);
+
+    uint2 cluster = g_light_clusters[calculateClusterIndex(pos_WS)];
     
-    for (uint i = 0; i != g_POINT_LIGHTS_COUNT; ++i)
-    {        
-        float3 L = g_point_lights[i].position - pos_WS;
+    for (uint c = 0; c != cluster.y; ++c)
+    {
+        uint i = g_light_indices[cluster.x + c];
+        PointLight light = g_lights[i];
+
+        float3 L = light.position - pos_WS;
         float3 L_norm = normalize(L);
 
         float3 H = normalize(L_norm + V);
@@ -288,7 +336,7 @@ float3 calculatePointLights(float3 albedo,
         float NV = max(dot(N, V), 0.001f);
 
         // angular diameter of solid angle
-        float sina = g_point_lights[i].radius / length(L);
+        float sina = light.radius / length(L);
         float cosa = sqrt(1.0f - sina * sina);
 
         // to avoid illumination of regions of the surface that
@@ -297,10 +345,10 @@ float3 calculatePointLights(float3 albedo,
         float height_micro = NL * length(L); // distance: surface - light source
         float height_macro = GNL * length(L);
 
-        float fading_micro = saturate((height_micro + g_point_lights[i].radius) /
-                                      (2.0f * g_point_lights[i].radius));
-        float fading_macro = saturate((height_macro + g_point_lights[i].radius) /
-                                      (2.0f * g_point_lights[i].radius));
+        float fading_micro = saturate((height_micro + light.radius) /
+                                      (2.0f * light.radius));
+        float fading_macro = saturate((height_macro + light.radius) /
+                                      (2.0f * light.radius));
         NL = max(NL, fading_micro * sina);
         
         // take into light source size in specular part
@@ -309,7 +357,7 @@ float3 calculatePointLights(float3 albedo,
                                                 L,
                                                 L_norm,
                                                 length(L),
-                                                g_point_lights[i].radius);
+                                                light.radius);
         clampDirToHorizon(L2, NL, N, 0.001f);        
 
         float3 H2 = normalize(L2 + V);
@@ -318,7 +366,7 @@ float3 calculatePointLights(float3 albedo,
         float HL2 = max(dot(H, L2), 0.001f);
 
         float solid_angle = calculateSolidAngle(length(L),
-                                                g_point_lights[i].radius);
+                                                light.radius);
    
         float3 diffuse = LambertBRDF(albedo, metalness, fresnel, NL);
         float3 specular = CookTorranceBRDF(roughness,
@@ -328,15 +376,21 @@ float3 calculatePointLights(float3 albedo,
                                            NH2,
                                            HL2,
                                            solid_angle);
-        float3 color_i = (diffuse * solid_angle + specular) * g_point_lights[i].radiance;
+        float3 color_i = (diffuse * solid_angle + specular) * light.radiance;
+
+        float shadow = 1.0f;
+        if (i < g_POINT_LIGHTS_COUNT)
+        {
+            shadow = calculateShadowCoefficient(pos_WS,
+                                                N,
+                                                L,
+                                                light.position,
+                                                i);
+        }
 
-        float shadow = calculateShadowCoefficient(pos_WS,
-                                                  N,
-                                                  L,
-                                                  g_point_lights[i].position,
-                                                  i);
+        float range_fading = calculateRangeFading(length(L), light.range);
         
-        color += color_i * fading_micro * fading_macro * shadow;
+        color += color_i * fading_micro * fading_macro * shadow * range_fading;
     }
 
     return color;
@@ -8,7 +8,8 @@ cbuffer PerShadowMesh : register(b3)
 cbuffer PerShadowCubemap : register(b5)
 {
     int g_cubemap_index;
-    float3 padding_4;
+    uint g_face_mask; // bit i - the i-th face is rendered
+    float2 padding_4;
 }
 
 struct VS_INPUT
@@ -61,6 +62,8 @@ void geometryShader(triangle GS_INPUT input[3],
     // generate 6 triangles for each camera from 1 main triangle
     for (uint face = 0; face != 6; ++face)
     {
+        if (!(g_face_mask & (1u << face))) continue;
+
         for (uint i = 0; i != 3; ++i)
         {
             GS_OUTPUT output;
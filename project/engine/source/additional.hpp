@@ -9,18 +9,21 @@
 #include "opaque_instances.hpp"
 #include "dissolution_instances.hpp"
 #include "disappear_instances.hpp"
+#include "expiry_system.hpp"
 
 #include "model_manager.hpp"
 
 namespace engine
 {
-void moveDissolutionToOpaqueInstances();
+// the instance becomes opaque when its animation is finished
+InstanceHandle addDissolutionInstance(const std::shared_ptr<Model> & model,
+                                      const std::vector<DissolutionInstances::Material> & materials,
+                                      const DissolutionInstances::Instance & instance);
 
+// the instance is removed when its animation is finished
 void moveOpaqueToDisappearInstances(uint32_t model_id,
                                     float model_box_diameter,
                                     const glm::vec3 & sphere_origin);
-
-void updateDisappearInstances();
 } // namespace engine
 
 #endif
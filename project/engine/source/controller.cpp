@@ -15,6 +15,15 @@ void Controller::init(engine::Renderer & renderer,
     for (int i = 0; i != KEYS_COUNT; ++i) was_released[i] = true;
 }
 
+bool Controller::hasPendingWork() const
+{
+    for (int i = 0; i != KEYS_COUNT; ++i)
+    {
+        if (keys_log[i]) return true;
+    }
+    return false;
+}
+
 void Controller::initScene(Camera & camera)
 {
     camera.setPerspective(glm::radians(45.0f),
@@ -119,7 +128,7 @@ void Controller::initKnight(const math::Transform & transform)
     };
 
     auto model = model_mgr->getModel("../engine/assets/Knight/Knight.fbx");
-    uint32_t transform_id = trans_system->transforms.insert(transform);
+    uint32_t transform_id = trans_system->insert(transform);
 
     oi::Instance instance(transform_id,
                           mesh_system->getModelID(),
@@ -212,17 +221,16 @@ void Controller::spawnKnight(const math::Transform & transform)
                      tex_mgr->getTexture("../engine/assets/Knight/dds/Glove_Normal.dds")),
     };
 
-    uint32_t transform_id = trans_system->transforms.insert(transform);
+    uint32_t transform_id = trans_system->insert(transform);
     float spawn_time = engine::TimeSystem::getTimePoint();
 
     di::Instance instance(transform_id,
                           spawn_time,
                           3.0f);
     
-    mesh_system->addInstance<engine::DissolutionInstances>(
-        model_mgr->getModel("../engine/assets/Knight/Knight.fbx"),
-        materials,
-        instance);
+    engine::addDissolutionInstance(model_mgr->getModel("../engine/assets/Knight/Knight.fbx"),
+                                   materials,
+                                   instance);
 }
 
 void Controller::initWall(const math::Transform & transform)
@@ -276,7 +284,7 @@ void Controller::initWall(const math::Transform & transform)
     };
 
     auto model = model_mgr->getModel("../engine/assets/Wall/SunCityWall.fbx");
-    uint32_t transform_id = trans_system->transforms.insert(transform);
+    uint32_t transform_id = trans_system->insert(transform);
 
     oi::Instance instance(transform_id,
                           mesh_system->getModelID(),
@@ -295,7 +303,7 @@ void Controller::initCube(const math::Transform & transform,
     engine::TransformSystem * trans_system = engine::TransformSystem::getInstance();
 
     auto model = model_mgr->getDefaultCube("cube");
-    uint32_t transform_id = trans_system->transforms.insert(transform);
+    uint32_t transform_id = trans_system->insert(transform);
 
     oi::Instance instance(transform_id,
                           mesh_system->getModelID(),
@@ -314,7 +322,7 @@ void Controller::initPlane(const math::Transform & transform,
     engine::TransformSystem * trans_system = engine::TransformSystem::getInstance();
 
     auto model = model_mgr->getDefaultPlane("plane");
-    uint32_t transform_id = trans_system->transforms.insert(transform);
+    uint32_t transform_id = trans_system->insert(transform);
 
     oi::Instance instance(transform_id,
                           mesh_system->getModelID(),
@@ -333,7 +341,7 @@ void Controller::initSphere(const math::Transform & transform,
     engine::TransformSystem * trans_system = engine::TransformSystem::getInstance();
 
     auto model = model_mgr->getDefaultSphere("sphere");
-    uint32_t transform_id = trans_system->transforms.insert(transform);
+    uint32_t transform_id = trans_system->insert(transform);
 
     oi::Instance instance(transform_id,
                           mesh_system->getModelID(),
@@ -423,7 +431,7 @@ void Controller::initPointLight(const glm::vec3 & position,
                               math::EulerAngles(0.0f, 0.0f, 0.0f),
                               glm::vec3(radius));
     
-    uint32_t transform_id = trans_system->transforms.insert(transform);
+    uint32_t transform_id = trans_system->insert(transform);
     
     // data
     light_system->addPointLight(transform_id, radiance, radius);
@@ -1266,6 +1274,7 @@ void Controller::initParticleEmitters()
 {
     engine::ParticleSystem * particle_sys = engine::ParticleSystem::getInstance();
     engine::TextureManager * texture_mgr = engine::TextureManager::getInstance();
+    engine::TransformSystem * trans_system = engine::TransformSystem::getInstance();
 
     particle_sys->lightmap_RLT = texture_mgr->
         getTexture("../engine/assets/smoke/lightmap_RLT.dds");
@@ -1276,9 +1285,21 @@ void Controller::initParticleEmitters()
     particle_sys->motion_vectors = texture_mgr->
         getTexture("../engine/assets/smoke/motion_vectors.dds");
     
+    math::EulerAngles no_rotation(0.0f, 0.0f, 0.0f);
+
+    uint32_t red_id = trans_system->insert(math::Transform(glm::vec3(120.0f, -13.0f, 30.0f),
+                                                           no_rotation,
+                                                           glm::vec3(1.0f)));
+    uint32_t white_id = trans_system->insert(math::Transform(glm::vec3(120.0f, -12.0f, 0.0f),
+                                                             no_rotation,
+                                                             glm::vec3(1.0f)));
+    uint32_t yellow_id = trans_system->insert(math::Transform(glm::vec3(120.0f, -7.5f, -30.0f),
+                                                              no_rotation,
+                                                              glm::vec3(1.0f)));
+    
     // red
     particle_sys->addSmokeEmitter(
-        engine::SmokeEmitter(glm::vec3(120.0f, -13.0f, 30.0f),
+        engine::SmokeEmitter(red_id,
                              0.5f,
                              glm::vec3(1.0f, 0.0f, 0.0f),
                              0.1f,
@@ -1289,7 +1310,7 @@ void Controller::initParticleEmitters()
 
     // white
     particle_sys->addSmokeEmitter(
-        engine::SmokeEmitter(glm::vec3(120.0f, -12.0f, 0.0f),
+        engine::SmokeEmitter(white_id,
                              3.0f,
                              glm::vec3(1.0f, 1.0f, 1.0f),
                              0.25f,
@@ -1300,7 +1321,7 @@ void Controller::initParticleEmitters()
 
     // yellow
     particle_sys->addSmokeEmitter(
-        engine::SmokeEmitter(glm::vec3(120.0f, -7.5f, -30.0f),
+        engine::SmokeEmitter(yellow_id,
                              10.0f,
                              glm::vec3(0.86f, 0.47f, 0.0f),
                              0.25f,
@@ -1442,16 +1463,20 @@ void Controller::processInput(Camera & camera,
                 object.pos = nearest.pos;
             }
         }
-        else
+        else if (math::Transform * transform = trans_system->tryModifyTransform(object.transform_id))
         {
-            auto & transform = trans_system->transforms[object.transform_id];
-            
             glm::vec3 new_pos = camera.getPosition() + object.t * ray.direction;
-            transform.position += (new_pos - object.pos);
+            transform->position += (new_pos - object.pos);
             object.pos = new_pos;
 
-            mesh_system->opaque_instances.updateInstanceBuffers();
-            mesh_system->emissive_instances.updateInstanceBuffers();
+            mesh_system->opaque_instances.group.invalidateTransform(object.transform_id);
+            mesh_system->emissive_instances.group.invalidateTransform(object.transform_id);
+            mesh_system->invalidateInstanceTree();
+        }
+        else
+        {
+            // the grabbed object was removed
+            object.is_grabbed = false;
         }
     }
     else
@@ -1471,15 +1496,23 @@ void Controller::processInput(Camera & camera,
     }
     if (keys_log[KEY_R] && object.is_grabbed)
     {
-        auto & transform = trans_system->transforms[object.transform_id];
-        transform.rotation *= math::quatFromEuler(object_rotation_speed,
-                                                  math::Basis());
+        if (math::Transform * transform = trans_system->tryModifyTransform(object.transform_id))
+        {
+            transform->rotation *= math::quatFromEuler(object_rotation_speed,
+                                                       math::Basis());
+            mesh_system->invalidateInstanceTree();
+        }
+        else object.is_grabbed = false;
     }
     else if (keys_log[KEY_T] && object.is_grabbed)
     {
-        auto & transform = trans_system->transforms[object.transform_id];
-        transform.rotation *= math::quatFromEuler(-object_rotation_speed,
-                                                  math::Basis());
+        if (math::Transform * transform = trans_system->tryModifyTransform(object.transform_id))
+        {
+            transform->rotation *= math::quatFromEuler(-object_rotation_speed,
+                                                       math::Basis());
+            mesh_system->invalidateInstanceTree();
+        }
+        else object.is_grabbed = false;
     }
     if (keys_log[KEY_N] && was_released[KEY_N])
     {
@@ -1514,9 +1547,8 @@ void Controller::processInput(Camera & camera,
 
         if (mesh_system->findIntersection(ray, nearest))
         {
-            auto & transform = trans_system->transforms[nearest.transform_id];
-            glm::vec4 posMS_h = glm::inverse(transform.toMat4()) * glm::vec4(nearest.pos, 1.0f);
-            glm::vec3 posMS = glm::vec3(posMS_h) / posMS_h.w;
+            glm::vec3 posMS = trans_system->getWorldInv(nearest.transform_id) *
+                              glm::vec4(nearest.pos, 1.0f);
             
             decal_sys->addDecal(nearest.model_id,
                                 nearest.transform_id,
@@ -1545,9 +1577,9 @@ void Controller::processInput(Camera & camera,
 
         if (mesh_system->findIntersection(ray, nearest))
         {
-            glm::mat4 mesh_to_model = trans_system->transforms[nearest.transform_id].toMat4();
-            glm::vec3 box_min = mesh_to_model * glm::vec4(nearest.box.min, 1.0f);
-            glm::vec3 box_max = mesh_to_model * glm::vec4(nearest.box.max, 1.0f);
+            const glm::mat4x3 & model_to_world = trans_system->getWorld(nearest.transform_id);
+            glm::vec3 box_min = model_to_world * glm::vec4(nearest.box.min, 1.0f);
+            glm::vec3 box_max = model_to_world * glm::vec4(nearest.box.max, 1.0f);
             float box_diameter = length(box_max - box_min);
             
             engine::moveOpaqueToDisappearInstances(nearest.model_id,
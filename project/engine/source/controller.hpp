@@ -69,6 +69,9 @@ public:
                       const float delta_time,
                       const engine::windows::Window & win);
 
+    // some key or mouse button is held, so the camera or object can move
+    bool hasPendingWork() const;
+
     engine::Renderer * renderer;
     engine::Postprocess * post_process;
 
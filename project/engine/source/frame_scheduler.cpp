@@ -0,0 +1,50 @@
+#include "frame_scheduler.hpp"
+
+namespace engine
+{
+FrameScheduler::FrameScheduler(float frame_duration) :
+                               frame_duration(frame_duration)
+{}
+
+void FrameScheduler::requestFrame()
+{
+    is_frame_requested = true;
+}
+
+float FrameScheduler::getWaitTime(float time) const
+{
+    if (!is_frame_requested) return WAIT_FOREVER;
+
+    // time can go back after TimeSystem::unpause()
+    float elapsed_time = time - last_frame_time;
+    if (elapsed_time < 0.0f || elapsed_time >= frame_duration) return 0.0f;
+
+    return frame_duration - elapsed_time;
+}
+
+float FrameScheduler::beginFrame(float time)
+{
+    float delta_time = time - last_frame_time;
+
+    // don't let animations jump after the sleep or before the first frame
+    if (was_idle || delta_time < 0.0f || !std::isfinite(delta_time))
+        delta_time = frame_duration;
+
+    last_frame_time = time;
+    is_frame_requested = false;
+    was_idle = false;
+
+    ++stats.frames_count;
+
+    return delta_time;
+}
+
+void FrameScheduler::addIdleTime(float wall_time, float cpu_time)
+{
+    was_idle = true;
+
+    ++stats.idle_count;
+    stats.idle_time += wall_time;
+    stats.idle_cpu_time += cpu_time;
+}
+} // namespace engine
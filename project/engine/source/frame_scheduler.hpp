@@ -0,0 +1,55 @@
+#ifndef FRAME_SCHEDULER_HPP
+#define FRAME_SCHEDULER_HPP
+
+#include <cmath>
+#include <limits>
+#include <cstdint>
+
+namespace engine
+{
+// Decides whether the main loop should render a frame or sleep.
+// Platform independent: time is passed in seconds, waiting is done by the caller.
+class FrameScheduler
+{
+public:
+    static constexpr float WAIT_FOREVER = std::numeric_limits<float>::infinity();
+
+    struct Stats
+    {
+        uint32_t frames_count = 0;
+        uint32_t idle_count = 0; // how many times the loop was put to sleep
+        float idle_time = 0.0f; // wall clock seconds spent in sleep
+        float idle_cpu_time = 0.0f; // CPU seconds spent by the process in sleep
+    };
+
+    FrameScheduler(float frame_duration);
+
+    // the next frame will differ from the last one:
+    // input, window resize or time-dependent work reported by a subsystem
+    void requestFrame();
+
+    // 0 - render now, WAIT_FOREVER - nothing to render until requestFrame(),
+    // otherwise time until the next frame is due
+    float getWaitTime(float time) const;
+
+    // returns delta time for the frame which starts at the time
+    float beginFrame(float time);
+
+    // called after each sleep with the measured durations
+    void addIdleTime(float wall_time, float cpu_time);
+
+    const Stats & getStats() const { return stats; }
+    void resetStats() { stats = Stats(); }
+
+protected:
+    float frame_duration;
+    float last_frame_time = -std::numeric_limits<float>::infinity();
+
+    bool is_frame_requested = true; // render the first frame
+    bool was_idle = false;
+
+    Stats stats;
+};
+} // namespace engine
+
+#endif
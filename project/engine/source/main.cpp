@@ -6,7 +6,9 @@
 
 #include <windows.h>
 #include <windowsx.h>
+#include <timeapi.h>
 #include <string>
+#include <cmath>
 #include "glm.hpp"
 
 #include "window.hpp"
@@ -17,9 +19,13 @@
 #include "engine.hpp"
 #include "timer.hpp"
 #include "additional.hpp"
+#include "frame_scheduler.hpp"
+#include "transform_system.hpp"
 
 #include "win_undef.hpp"
 
+#pragma comment(lib, "winmm.lib")
+
 namespace
 {
 constexpr float FRAME_DURATION = 1.0f / 60.0f;
@@ -39,6 +45,8 @@ Camera camera(glm::vec3(0.0f, 4.0f, -30.0f),
               glm::vec3(0, 0, 1.0f)); // forward
 
 engine::Postprocess post_process;
+
+engine::FrameScheduler scheduler(FRAME_DURATION);
 } // namespace
 
 LRESULT CALLBACK WindowProc(HWND hWnd,
@@ -49,18 +57,43 @@ LRESULT CALLBACK WindowProc(HWND hWnd,
 engine::Timer timer;
 float delta_time = 0.0f;
 
-bool frameTimeElapsed()
+// user + kernel time of the process in seconds
+float getProcessCPUTime()
 {
-    float elapsed_time = timer.getElapsedTime();
-    
-    if (elapsed_time >= FRAME_DURATION)
-    {
-        timer.restart();
-        delta_time = elapsed_time;
-        
-        return true;
-    }
-    return false;
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    GetProcessTimes(GetCurrentProcess(),
+                    &creation_time,
+                    &exit_time,
+                    &kernel_time,
+                    &user_time);
+
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernel_time.dwLowDateTime;
+    kernel.HighPart = kernel_time.dwHighDateTime;
+    user.LowPart = user_time.dwLowDateTime;
+    user.HighPart = user_time.dwHighDateTime;
+
+    // in 100 nanosecond ticks
+    return float(double(kernel.QuadPart + user.QuadPart) * 1e-7);
+}
+
+// sleeps until any message arrives or the timeout (in seconds) is over,
+// only idle sleeps are reported to the scheduler, not the frame pacing ones
+void waitForMessages(float timeout = engine::FrameScheduler::WAIT_FOREVER,
+                     bool is_idle = true)
+{
+    float wall_start = timer.getElapsedTime();
+    float cpu_start = getProcessCPUTime();
+
+    DWORD timeout_ms = timeout == engine::FrameScheduler::WAIT_FOREVER ?
+        INFINITE : DWORD(std::ceil(timeout * 1000.0f));
+
+    MsgWaitForMultipleObjects(0, NULL, FALSE, timeout_ms, QS_ALLINPUT);
+
+    if (!is_idle) return;
+
+    scheduler.addIdleTime(timer.getElapsedTime() - wall_start,
+                          getProcessCPUTime() - cpu_start);
 }
 
 int WINAPI WinMain(HINSTANCE hInstance,
@@ -97,6 +130,9 @@ int WINAPI WinMain(HINSTANCE hInstance,
     controller.initScene(camera);
     controller.initPostprocess();
 
+    // 1 ms timer resolution, the default 15.6 ms is too coarse for the frame pacing
+    timeBeginPeriod(1);
+
     timer.restart();
     
     ShowWindow(win.handle, nCmdShow);
@@ -115,20 +151,57 @@ int WINAPI WinMain(HINSTANCE hInstance,
             if (msg.message == WM_QUIT) goto exit;
         }
 
-        if (frameTimeElapsed())
+        float wait_time = scheduler.getWaitTime(timer.getElapsedTime());
+
+        // nothing changed since the last frame
+        if (wait_time == engine::FrameScheduler::WAIT_FOREVER)
         {
-            int fps = static_cast<int>(1.0f / delta_time);
-            std::string fps_str = "FPS: " + std::to_string(fps);
-            SetWindowTextA(win.handle, TEXT(fps_str.c_str()));
+            // an expiry changes the scene too, so sleep only until it
+            float expiry_wait_time = engine::ExpirySystem::getInstance()->getNextExpiryTime() -
+                                     engine::TimeSystem::getTimePoint();
 
-            controller.processInput(camera, post_process, delta_time, win);
-            camera.updateMatrices();
-            engine::moveDissolutionToOpaqueInstances();
-            engine::updateDisappearInstances();
-            controller.renderer->renderFrame(win, camera, post_process, delta_time);
+            if (expiry_wait_time <= 0.0f) scheduler.requestFrame();
+            else waitForMessages(expiry_wait_time);
+            continue;
+        }
+        // the next frame isn't due yet, input can still wake the loop earlier
+        if (wait_time > 0.0f)
+        {
+            waitForMessages(wait_time, false);
+            continue;
+        }
+
+        delta_time = scheduler.beginFrame(timer.getElapsedTime());
+
+        const engine::FrameScheduler::Stats & stats = scheduler.getStats();
+        const engine::ShadowCache & shadow_cache = engine::LightSystem::getInstance()->getShadowCache();
+        const engine::StateCache & state_cache = engine::Globals::getInstance()->state_cache;
+        int fps = static_cast<int>(1.0f / delta_time);
+        std::string fps_str = "FPS: " + std::to_string(fps) +
+                              " | idle: " + std::to_string(int(stats.idle_time)) + " s" +
+                              ", idle CPU: " + std::to_string(int(stats.idle_cpu_time * 1000.0f)) + " ms" +
+                              " | shadow faces saved: " + std::to_string(shadow_cache.getSavedFacesCount()) +
+                              " | binds skipped: " + std::to_string(state_cache.getSkippedCount()) +
+                              "/" + std::to_string(state_cache.getSkippedCount() + state_cache.getIssuedCount());
+        SetWindowTextA(win.handle, TEXT(fps_str.c_str()));
+
+        controller.processInput(camera, post_process, delta_time, win);
+        camera.updateMatrices();
+        engine::TransformSystem::getInstance()->updateMatrices();
+        engine::ExpirySystem::getInstance()->update(engine::TimeSystem::getTimePoint());
+        controller.renderer->renderFrame(win, camera, post_process, delta_time);
+
+        // keep rendering while something is animated
+        if (controller.hasPendingWork() ||
+            engine::MeshSystem::getInstance()->hasPendingWork() ||
+            engine::ParticleSystem::getInstance()->hasPendingWork())
+        {
+            scheduler.requestFrame();
         }
     }
     exit:
+    timeEndPeriod(1);
+
     // no need to clean COM objects,
     // because DxResPtr does it in the destructor!
 
@@ -141,6 +214,23 @@ int WINAPI WinMain(HINSTANCE hInstance,
 
 LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
+    // input and resize change the next frame, wake up the main loop
+    switch(message)
+    {
+        case WM_SIZE:
+        case WM_PAINT:
+        case WM_KEYDOWN:
+        case WM_KEYUP:
+        case WM_RBUTTONDOWN:
+        case WM_RBUTTONUP:
+        case WM_LBUTTONDOWN:
+        case WM_LBUTTONUP:
+        {
+            scheduler.requestFrame();
+            break;
+        }
+    }
+
     switch(message)
     {
         case WM_DESTROY:
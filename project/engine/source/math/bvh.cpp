@@ -0,0 +1,356 @@
+#include "bvh.hpp"
+
+namespace
+{
+constexpr uint32_t SAH_BINS_COUNT = 12;
+constexpr float SAH_TRAVERSAL_COST = 1.0f;
+constexpr float SAH_INTERSECTION_COST = 1.0f;
+
+float surfaceArea(const math::BoundingBox & box)
+{
+    glm::vec3 size = box.size();
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+// the most items median splits can bring to leaves in the levels
+uint64_t getMedianCapacity(uint32_t max_leaf_size, uint32_t levels)
+{
+    return uint64_t(max_leaf_size) << std::min(levels, 32u);
+}
+
+struct Bin
+{
+    math::BoundingBox box = math::BoundingBox::empty();
+    uint32_t count = 0;
+};
+
+uint32_t intersectNodeScalar(const math::RayPacket & packet,
+                             const float * t_max,
+                             const math::BVHNode & node,
+                             float & t_nearest)
+{
+    uint32_t mask = 0;
+    t_nearest = std::numeric_limits<float>::infinity();
+
+    for (uint32_t i = 0; i != math::RayPacket::SIZE; ++i)
+    {
+        if (!(packet.mask & (1u << i))) continue;
+
+        glm::vec3 origin(packet.origin_x[i], packet.origin_y[i], packet.origin_z[i]);
+        glm::vec3 direction_inv(packet.direction_inv_x[i],
+                                packet.direction_inv_y[i],
+                                packet.direction_inv_z[i]);
+
+        float t = math::intersectNode(origin, direction_inv, node, t_max[i]);
+        if (std::isfinite(t))
+        {
+            mask |= 1u << i;
+            t_nearest = std::min(t_nearest, t);
+        }
+    }
+
+    return mask;
+}
+
+uint32_t intersectNodeSSE(const math::RayPacket & packet,
+                          const float * t_max,
+                          const math::BVHNode & node,
+                          float & t_nearest)
+{
+    __m128 box_min_x = _mm_set1_ps(node.box_min.x);
+    __m128 box_min_y = _mm_set1_ps(node.box_min.y);
+    __m128 box_min_z = _mm_set1_ps(node.box_min.z);
+
+    __m128 box_max_x = _mm_set1_ps(node.box_max.x);
+    __m128 box_max_y = _mm_set1_ps(node.box_max.y);
+    __m128 box_max_z = _mm_set1_ps(node.box_max.z);
+
+    __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    __m128 nearest = inf;
+
+    uint32_t mask = 0;
+
+    // 2 halves of the packet
+    for (uint32_t offset = 0; offset != math::RayPacket::SIZE; offset += 4)
+    {
+        __m128 origin_x = _mm_load_ps(packet.origin_x + offset);
+        __m128 origin_y = _mm_load_ps(packet.origin_y + offset);
+        __m128 origin_z = _mm_load_ps(packet.origin_z + offset);
+
+        __m128 direction_inv_x = _mm_load_ps(packet.direction_inv_x + offset);
+        __m128 direction_inv_y = _mm_load_ps(packet.direction_inv_y + offset);
+        __m128 direction_inv_z = _mm_load_ps(packet.direction_inv_z + offset);
+
+        __m128 t1_x = _mm_mul_ps(_mm_sub_ps(box_min_x, origin_x), direction_inv_x);
+        __m128 t1_y = _mm_mul_ps(_mm_sub_ps(box_min_y, origin_y), direction_inv_y);
+        __m128 t1_z = _mm_mul_ps(_mm_sub_ps(box_min_z, origin_z), direction_inv_z);
+
+        __m128 t2_x = _mm_mul_ps(_mm_sub_ps(box_max_x, origin_x), direction_inv_x);
+        __m128 t2_y = _mm_mul_ps(_mm_sub_ps(box_max_y, origin_y), direction_inv_y);
+        __m128 t2_z = _mm_mul_ps(_mm_sub_ps(box_max_z, origin_z), direction_inv_z);
+
+        __m128 t_near = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1_x, t2_x),
+                                              _mm_min_ps(t1_y, t2_y)),
+                                   _mm_max_ps(_mm_min_ps(t1_z, t2_z),
+                                              _mm_setzero_ps()));
+
+        __m128 t_far = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1_x, t2_x),
+                                             _mm_max_ps(t1_y, t2_y)),
+                                  _mm_min_ps(_mm_max_ps(t1_z, t2_z),
+                                             _mm_loadu_ps(t_max + offset)));
+
+        __m128 hit = _mm_cmple_ps(t_near, t_far);
+
+        mask |= uint32_t(_mm_movemask_ps(hit)) << offset;
+        nearest = _mm_min_ps(nearest, _mm_or_ps(_mm_and_ps(hit, t_near),
+                                                _mm_andnot_ps(hit, inf)));
+    }
+
+    alignas(16) float t[4];
+    _mm_store_ps(t, nearest);
+    t_nearest = std::min(std::min(t[0], t[1]), std::min(t[2], t[3]));
+
+    return mask & packet.mask;
+}
+
+MATH_TARGET_AVX2
+uint32_t intersectNodeAVX2(const math::RayPacket & packet,
+                           const float * t_max,
+                           const math::BVHNode & node,
+                           float & t_nearest)
+{
+    __m256 origin_x = _mm256_load_ps(packet.origin_x);
+    __m256 origin_y = _mm256_load_ps(packet.origin_y);
+    __m256 origin_z = _mm256_load_ps(packet.origin_z);
+
+    __m256 direction_inv_x = _mm256_load_ps(packet.direction_inv_x);
+    __m256 direction_inv_y = _mm256_load_ps(packet.direction_inv_y);
+    __m256 direction_inv_z = _mm256_load_ps(packet.direction_inv_z);
+
+    __m256 t1_x = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.box_min.x), origin_x), direction_inv_x);
+    __m256 t1_y = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.box_min.y), origin_y), direction_inv_y);
+    __m256 t1_z = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.box_min.z), origin_z), direction_inv_z);
+
+    __m256 t2_x = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.box_max.x), origin_x), direction_inv_x);
+    __m256 t2_y = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.box_max.y), origin_y), direction_inv_y);
+    __m256 t2_z = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(node.box_max.z), origin_z), direction_inv_z);
+
+    __m256 t_near = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(t1_x, t2_x),
+                                                _mm256_min_ps(t1_y, t2_y)),
+                                  _mm256_max_ps(_mm256_min_ps(t1_z, t2_z),
+                                                _mm256_setzero_ps()));
+
+    __m256 t_far = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(t1_x, t2_x),
+                                               _mm256_max_ps(t1_y, t2_y)),
+                                 _mm256_min_ps(_mm256_max_ps(t1_z, t2_z),
+                                               _mm256_loadu_ps(t_max)));
+
+    __m256 hit = _mm256_cmp_ps(t_near, t_far, _CMP_LE_OQ);
+
+    __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    __m256 nearest = _mm256_blendv_ps(inf, t_near, hit);
+
+    // horizontal min
+    __m128 nearest_4 = _mm_min_ps(_mm256_castps256_ps128(nearest),
+                                  _mm256_extractf128_ps(nearest, 1));
+    nearest_4 = _mm_min_ps(nearest_4, _mm_movehl_ps(nearest_4, nearest_4));
+    nearest_4 = _mm_min_ss(nearest_4, _mm_shuffle_ps(nearest_4, nearest_4, 1));
+    t_nearest = _mm_cvtss_f32(nearest_4);
+
+    return uint32_t(_mm256_movemask_ps(hit)) & packet.mask;
+}
+} // namespace
+
+namespace math
+{
+void buildBVH(const std::vector<BoundingBox> & boxes,
+              const std::vector<glm::vec3> & centers,
+              uint32_t max_leaf_size,
+              std::vector<BVHNode> & nodes,
+              std::vector<uint32_t> & indices,
+              uint32_t max_depth)
+{
+    assert(boxes.size() == centers.size());
+    assert(max_leaf_size > 0);
+
+    uint32_t items_count = uint32_t(boxes.size());
+
+    nodes.clear();
+    indices.resize(items_count);
+    for (uint32_t i = 0; i != items_count; ++i) indices[i] = i;
+
+    if (items_count == 0) return;
+
+    // binary tree with N leaves has at most 2N - 1 nodes
+    nodes.reserve(2 * items_count - 1);
+    nodes.push_back({glm::vec3(0.0f), 0, glm::vec3(0.0f), items_count});
+
+    struct Task
+    {
+        uint32_t node;
+        uint32_t depth;
+    };
+
+    std::vector<Task> stack;
+    stack.push_back({0, 0});
+
+    while (!stack.empty())
+    {
+        uint32_t node_index = stack.back().node;
+        uint32_t depth = stack.back().depth;
+        stack.pop_back();
+
+        uint32_t first = nodes[node_index].left_first;
+        uint32_t count = nodes[node_index].count;
+
+        BoundingBox box = BoundingBox::empty();
+        BoundingBox centers_box = BoundingBox::empty();
+        for (uint32_t i = first; i != first + count; ++i)
+        {
+            box.expand(boxes[indices[i]]);
+            centers_box.expand(centers[indices[i]]);
+        }
+
+        nodes[node_index].box_min = box.min;
+        nodes[node_index].box_max = box.max;
+
+        if (count <= max_leaf_size || depth == max_depth) continue;
+
+        uint32_t middle;
+
+        // a SAH child can be as big as the node, so SAH is used only while
+        // median splits of such a child still reach the leaves in max_depth
+        if (count > getMedianCapacity(max_leaf_size, max_depth - depth - 1))
+        {
+            glm::vec3 extent = centers_box.size();
+            int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+            middle = first + count / 2;
+            std::nth_element(indices.data() + first,
+                             indices.data() + middle,
+                             indices.data() + first + count,
+                             [&](uint32_t a, uint32_t b)
+                             {
+                                 return centers[a][axis] < centers[b][axis];
+                             });
+        }
+        else
+        {
+            // find the cheapest split plane
+            int best_axis = -1;
+            uint32_t best_split = 0;
+            float best_cost = std::numeric_limits<float>::max();
+
+            for (int axis = 0; axis != 3; ++axis)
+            {
+                float axis_min = centers_box.min[axis];
+                float axis_extent = centers_box.max[axis] - axis_min;
+                if (axis_extent <= 0.0f) continue;
+
+                float bin_scale = SAH_BINS_COUNT / axis_extent;
+
+                Bin bins[SAH_BINS_COUNT];
+                for (uint32_t i = first; i != first + count; ++i)
+                {
+                    uint32_t b = std::min(SAH_BINS_COUNT - 1,
+                                          uint32_t((centers[indices[i]][axis] - axis_min) * bin_scale));
+                    bins[b].box.expand(boxes[indices[i]]);
+                    ++bins[b].count;
+                }
+
+                // sweep from the right to collect the right side areas
+                float right_areas[SAH_BINS_COUNT - 1];
+                uint32_t right_counts[SAH_BINS_COUNT - 1];
+
+                BoundingBox right_box = BoundingBox::empty();
+                uint32_t right_count = 0;
+                for (uint32_t b = SAH_BINS_COUNT - 1; b != 0; --b)
+                {
+                    right_box.expand(bins[b].box);
+                    right_count += bins[b].count;
+
+                    right_areas[b - 1] = right_count ? surfaceArea(right_box) : 0.0f;
+                    right_counts[b - 1] = right_count;
+                }
+
+                // sweep from the left and evaluate every plane between bins
+                BoundingBox left_box = BoundingBox::empty();
+                uint32_t left_count = 0;
+                for (uint32_t b = 0; b != SAH_BINS_COUNT - 1; ++b)
+                {
+                    left_box.expand(bins[b].box);
+                    left_count += bins[b].count;
+
+                    if (left_count == 0 || right_counts[b] == 0) continue;
+
+                    float cost = surfaceArea(left_box) * left_count +
+                                 right_areas[b] * right_counts[b];
+
+                    if (cost < best_cost)
+                    {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_split = b;
+                    }
+                }
+            }
+
+            float parent_area = surfaceArea(box);
+            float leaf_cost = SAH_INTERSECTION_COST * count;
+            float split_cost = SAH_TRAVERSAL_COST +
+                               SAH_INTERSECTION_COST * best_cost / parent_area;
+
+            if (best_axis < 0)
+            {
+                // all centers coincide, SAH can't separate them -> split in half
+                middle = first + count / 2;
+            }
+            else
+            {
+                if (split_cost >= leaf_cost && count <= 4 * max_leaf_size) continue;
+
+                float axis_min = centers_box.min[best_axis];
+                float bin_scale = SAH_BINS_COUNT /
+                                  (centers_box.max[best_axis] - axis_min);
+
+                uint32_t * split = std::partition(
+                    indices.data() + first,
+                    indices.data() + first + count,
+                    [&](uint32_t index)
+                    {
+                        uint32_t b = std::min(SAH_BINS_COUNT - 1,
+                                              uint32_t((centers[index][best_axis] - axis_min) * bin_scale));
+                        return b <= best_split;
+                    });
+
+                middle = uint32_t(split - indices.data());
+            }
+        }
+
+        uint32_t left_index = uint32_t(nodes.size());
+
+        nodes.push_back({glm::vec3(0.0f), first, glm::vec3(0.0f), middle - first});
+        nodes.push_back({glm::vec3(0.0f), middle, glm::vec3(0.0f), first + count - middle});
+
+        nodes[node_index].left_first = left_index;
+        nodes[node_index].count = 0;
+
+        stack.push_back({left_index, depth + 1});
+        stack.push_back({left_index + 1, depth + 1});
+    }
+}
+
+uint32_t intersectNode(const RayPacket & packet,
+                       const float * t_max,
+                       const BVHNode & node,
+                       float & t_nearest,
+                       SIMDLevel level)
+{
+    switch (level)
+    {
+    case SIMDLevel::AVX2: return intersectNodeAVX2(packet, t_max, node, t_nearest);
+    case SIMDLevel::SSE: return intersectNodeSSE(packet, t_max, node, t_nearest);
+    default: return intersectNodeScalar(packet, t_max, node, t_nearest);
+    }
+}
+} // namespace math
@@ -0,0 +1,74 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include "glm.hpp"
+#include <limits>
+#include <vector>
+#include <cassert>
+#include <algorithm>
+
+#include "box.hpp"
+#include "ray.hpp"
+#include "simd.hpp"
+
+namespace math
+{
+// 32 bytes, so two nodes share one cache line
+struct BVHNode
+{
+    glm::vec3 box_min;
+    uint32_t left_first; // interior: index of the left child (right is next)
+                         // leaf: index of the first item in the reordered array
+    glm::vec3 box_max;
+    uint32_t count; // 0 for interior nodes
+
+    bool isLeaf() const { return count != 0; }
+};
+
+static_assert(sizeof(BVHNode) == 32, "sizeof(BVHNode)");
+
+// a traversal stack of BVH_MAX_DEPTH + 1 entries never overflows
+constexpr uint32_t BVH_MAX_DEPTH = 63;
+
+// Binned surface area heuristic builder.
+// boxes - bounds of the items, centers - points used for the split decision.
+// After the call indices holds the item order referenced by leaf ranges.
+// Leaves are at most max_depth levels below the root: nodes which can't reach
+// the leaves in time with SAH are split in the middle of the longest axis.
+void buildBVH(const std::vector<BoundingBox> & boxes,
+              const std::vector<glm::vec3> & centers,
+              uint32_t max_leaf_size,
+              std::vector<BVHNode> & nodes,
+              std::vector<uint32_t> & indices,
+              uint32_t max_depth = BVH_MAX_DEPTH);
+
+// slab test with precomputed 1 / direction,
+// returns distance to the box or infinity if it was missed
+inline float intersectNode(const glm::vec3 & origin,
+                           const glm::vec3 & direction_inv,
+                           const BVHNode & node,
+                           float t_max)
+{
+    glm::vec3 t1 = (node.box_min - origin) * direction_inv;
+    glm::vec3 t2 = (node.box_max - origin) * direction_inv;
+
+    glm::vec3 t_min = glm::min(t1, t2);
+    glm::vec3 t_max3 = glm::max(t1, t2);
+
+    float t_near = std::max(std::max(t_min.x, t_min.y), std::max(t_min.z, 0.0f));
+    float t_far = std::min(std::min(t_max3.x, t_max3.y), std::min(t_max3.z, t_max));
+
+    return t_near <= t_far ? t_near : std::numeric_limits<float>::infinity();
+}
+
+// slab test of the whole packet, returns mask of the lanes which hit the node
+// and the nearest distance among them in t_nearest,
+// t_max of the unused lanes has to be -infinity
+uint32_t intersectNode(const RayPacket & packet,
+                       const float * t_max,
+                       const BVHNode & node,
+                       float & t_nearest,
+                       SIMDLevel level = getSIMDLevel());
+} // namespace math
+
+#endif
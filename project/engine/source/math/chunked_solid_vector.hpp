@@ -0,0 +1,277 @@
+#ifndef CHUNKED_SOLID_VECTOR_H
+#define CHUNKED_SOLID_VECTOR_H
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <utility>
+#include <cassert>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace math
+{
+inline uint32_t countTrailingZeros(uint64_t value)
+{
+    assert(value != 0);
+
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return uint32_t(index);
+#else
+    return uint32_t(__builtin_ctzll(value));
+#endif
+}
+
+// SolidVector which never moves its elements:
+// they live in fixed-size chunks, so T & stays valid until erase()
+// and growth never copies the existing elements.
+// ID is the position of the element (chunk * CHUNK_SIZE + slot),
+// erased positions are refilled by the next inserts.
+// Empty chunks are kept as a pool for the following inserts.
+template<class T, uint32_t CHUNK_SIZE = 256>
+class ChunkedSolidVector
+{
+    static_assert(CHUNK_SIZE % 64 == 0, "CHUNK_SIZE must be a multiple of 64");
+
+public:
+    using ID = uint32_t;
+
+protected:
+    static constexpr uint32_t MASK_WORDS = CHUNK_SIZE / 64;
+
+    struct Chunk
+    {
+        alignas(T) unsigned char storage[CHUNK_SIZE * sizeof(T)];
+        uint64_t occupied[MASK_WORDS] = {};
+        uint32_t count = 0;
+        bool is_in_free_list = false;
+
+        T * get(uint32_t slot) { return reinterpret_cast<T *>(storage) + slot; }
+        const T * get(uint32_t slot) const { return reinterpret_cast<const T *>(storage) + slot; }
+
+        bool occupiedSlot(uint32_t slot) const
+        {
+            return (occupied[slot / 64] >> (slot % 64)) & 1;
+        }
+    };
+
+    void assertId(ID id) const
+    {
+        assert(occupied(id));
+    }
+
+public:
+    ChunkedSolidVector() = default;
+    ChunkedSolidVector(const ChunkedSolidVector & other) = delete;
+    void operator=(const ChunkedSolidVector & other) = delete;
+
+    ~ChunkedSolidVector() { clear(); }
+
+    bool occupied(ID id) const
+    {
+        uint32_t chunk = id / CHUNK_SIZE;
+        return chunk < chunks.size() && chunks[chunk]->occupiedSlot(id % CHUNK_SIZE);
+    }
+
+    uint32_t size() const { return count; }
+
+    // upper bound of IDs
+    uint32_t capacity() const { return uint32_t(chunks.size()) * CHUNK_SIZE; }
+
+    const T & operator[](ID id) const
+    {
+        assertId(id);
+        return *chunks[id / CHUNK_SIZE]->get(id % CHUNK_SIZE);
+    }
+    T & operator[](ID id)
+    {
+        assertId(id);
+        return *chunks[id / CHUNK_SIZE]->get(id % CHUNK_SIZE);
+    }
+
+    ID insert(const T & value)
+    {
+        return emplace(value);
+    }
+
+    template<class... Args>
+    ID emplace(Args && ... args)
+    {
+        uint32_t chunk_index = getFreeChunk();
+        Chunk & chunk = *chunks[chunk_index];
+
+        uint32_t slot = findFreeSlot(chunk, 0);
+        new (chunk.get(slot)) T(std::forward<Args>(args)...);
+        occupySlot(chunk_index, slot);
+
+        return chunk_index * CHUNK_SIZE + slot;
+    }
+
+    // fills chunks one by one, ids can be nullptr
+    void insert_n(const T * values, uint32_t values_count, ID * ids)
+    {
+        uint32_t inserted = 0;
+        while (inserted != values_count)
+        {
+            uint32_t chunk_index = getFreeChunk();
+            Chunk & chunk = *chunks[chunk_index];
+
+            uint32_t slot = 0;
+            while (inserted != values_count && chunk.count != CHUNK_SIZE)
+            {
+                slot = findFreeSlot(chunk, slot);
+                new (chunk.get(slot)) T(values[inserted]);
+                occupySlot(chunk_index, slot);
+
+                if (ids) ids[inserted] = chunk_index * CHUNK_SIZE + slot;
+                ++inserted;
+            }
+        }
+    }
+
+    void erase(ID id)
+    {
+        assertId(id);
+
+        uint32_t chunk_index = id / CHUNK_SIZE;
+        uint32_t slot = id % CHUNK_SIZE;
+        Chunk & chunk = *chunks[chunk_index];
+
+        chunk.get(slot)->~T();
+        chunk.occupied[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+        --chunk.count;
+        --count;
+
+        if (!chunk.is_in_free_list)
+        {
+            chunk.is_in_free_list = true;
+            free_chunks.push_back(chunk_index);
+        }
+    }
+
+    void erase_n(const ID * ids, uint32_t ids_count)
+    {
+        for (uint32_t i = 0; i != ids_count; ++i)
+            erase(ids[i]);
+    }
+
+    // f(ID, T &) is called in the order of IDs,
+    // elements of a chunk are visited sequentially in memory
+    template<class F>
+    void forEach(F && f)
+    {
+        for (uint32_t c = 0, size = chunks.size(); c != size; ++c)
+        {
+            Chunk & chunk = *chunks[c];
+            if (chunk.count == 0) continue;
+
+            for (uint32_t w = 0; w != MASK_WORDS; ++w)
+            {
+                for (uint64_t mask = chunk.occupied[w]; mask != 0; mask &= mask - 1)
+                {
+                    uint32_t slot = w * 64 + countTrailingZeros(mask);
+                    f(c * CHUNK_SIZE + slot, *chunk.get(slot));
+                }
+            }
+        }
+    }
+
+    template<class F>
+    void forEach(F && f) const
+    {
+        for (uint32_t c = 0, size = chunks.size(); c != size; ++c)
+        {
+            const Chunk & chunk = *chunks[c];
+            if (chunk.count == 0) continue;
+
+            for (uint32_t w = 0; w != MASK_WORDS; ++w)
+            {
+                for (uint64_t mask = chunk.occupied[w]; mask != 0; mask &= mask - 1)
+                {
+                    uint32_t slot = w * 64 + countTrailingZeros(mask);
+                    f(c * CHUNK_SIZE + slot, *chunk.get(slot));
+                }
+            }
+        }
+    }
+
+    // destroys the elements, but keeps the chunks for the following inserts
+    void clear()
+    {
+        free_chunks.clear();
+
+        for (uint32_t c = 0, size = chunks.size(); c != size; ++c)
+        {
+            Chunk & chunk = *chunks[c];
+
+            for (uint32_t w = 0; w != MASK_WORDS; ++w)
+            {
+                for (uint64_t mask = chunk.occupied[w]; mask != 0; mask &= mask - 1)
+                    chunk.get(w * 64 + countTrailingZeros(mask))->~T();
+
+                chunk.occupied[w] = 0;
+            }
+
+            chunk.count = 0;
+            chunk.is_in_free_list = true;
+            free_chunks.push_back(c);
+        }
+
+        count = 0;
+    }
+
+protected:
+    // index of a chunk with at least one free slot
+    uint32_t getFreeChunk()
+    {
+        // a chunk can be full if it was refilled after erase()
+        while (!free_chunks.empty() && chunks[free_chunks.back()]->count == CHUNK_SIZE)
+        {
+            chunks[free_chunks.back()]->is_in_free_list = false;
+            free_chunks.pop_back();
+        }
+
+        if (free_chunks.empty())
+        {
+            chunks.emplace_back(std::make_unique<Chunk>());
+            chunks.back()->is_in_free_list = true;
+            free_chunks.push_back(uint32_t(chunks.size() - 1));
+        }
+
+        return free_chunks.back();
+    }
+
+    static uint32_t findFreeSlot(const Chunk & chunk, uint32_t from_slot)
+    {
+        for (uint32_t w = from_slot / 64; w != MASK_WORDS; ++w)
+        {
+            if (~chunk.occupied[w] != 0)
+                return w * 64 + countTrailingZeros(~chunk.occupied[w]);
+        }
+
+        assert(false && "the chunk is full");
+        return CHUNK_SIZE;
+    }
+
+    void occupySlot(uint32_t chunk_index, uint32_t slot)
+    {
+        Chunk & chunk = *chunks[chunk_index];
+
+        chunk.occupied[slot / 64] |= uint64_t(1) << (slot % 64);
+        ++chunk.count;
+        ++count;
+    }
+
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    std::vector<uint32_t> free_chunks; // chunks which may have free slots
+
+    uint32_t count = 0;
+};
+} // namespace math
+
+#endif
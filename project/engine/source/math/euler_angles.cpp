@@ -38,8 +38,8 @@ bool areAlmostEqual(float a, float b, float epsilon)
 
 glm::mat4 rotateZ(float angle)
 {
-    float cosa = std::cosf(angle);
-    float sina = std::sinf(angle);
+    float cosa = std::cos(angle);
+    float sina = std::sin(angle);
 
     glm::mat4x4 rotate(cosa, -sina, 0.0f, 0.0f,
                        sina,  cosa, 0.0f, 0.0f,
@@ -0,0 +1,208 @@
+#include "frustum.hpp"
+
+namespace
+{
+constexpr uint32_t PLANES_COUNT = 6;
+
+// the farthest corner along the plane normal,
+// the box is outside if even this corner is behind the plane
+struct PlaneCorners
+{
+    const float * x;
+    const float * y;
+    const float * z;
+};
+
+void selectCorners(const math::Frustum & frustum,
+                   const math::BoxBatch & boxes,
+                   PlaneCorners * corners)
+{
+    for (uint32_t p = 0; p != PLANES_COUNT; ++p)
+    {
+        const glm::vec4 & plane = frustum.planes[p];
+
+        corners[p].x = plane.x >= 0.0f ? boxes.max_x.data() : boxes.min_x.data();
+        corners[p].y = plane.y >= 0.0f ? boxes.max_y.data() : boxes.min_y.data();
+        corners[p].z = plane.z >= 0.0f ? boxes.max_z.data() : boxes.min_z.data();
+    }
+}
+
+void cullScalar(const math::Frustum & frustum,
+                const PlaneCorners * corners,
+                uint32_t begin,
+                uint32_t end,
+                uint8_t * visible)
+{
+    for (uint32_t i = begin; i != end; ++i)
+    {
+        bool is_visible = true;
+
+        for (uint32_t p = 0; p != PLANES_COUNT; ++p)
+        {
+            const glm::vec4 & plane = frustum.planes[p];
+
+            float distance = plane.x * corners[p].x[i] +
+                             plane.y * corners[p].y[i] +
+                             plane.z * corners[p].z[i] +
+                             plane.w;
+
+            if (distance < 0.0f) is_visible = false;
+        }
+
+        visible[i] = is_visible;
+    }
+}
+
+// 4 boxes starting from the offset
+void cullSSE(const math::Frustum & frustum,
+             const PlaneCorners * corners,
+             uint32_t offset,
+             uint8_t * visible)
+{
+    __m128 outside = _mm_setzero_ps();
+
+    for (uint32_t p = 0; p != PLANES_COUNT; ++p)
+    {
+        const glm::vec4 & plane = frustum.planes[p];
+
+        __m128 distance = _mm_set1_ps(plane.w);
+        distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.x),
+                                                   _mm_loadu_ps(corners[p].x + offset)));
+        distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.y),
+                                                   _mm_loadu_ps(corners[p].y + offset)));
+        distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z),
+                                                   _mm_loadu_ps(corners[p].z + offset)));
+
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+    }
+
+    int mask = _mm_movemask_ps(outside);
+    for (uint32_t i = 0; i != 4; ++i)
+        visible[offset + i] = !(mask & (1 << i));
+}
+
+// 8 boxes starting from the offset
+MATH_TARGET_AVX2
+void cullAVX2(const math::Frustum & frustum,
+              const PlaneCorners * corners,
+              uint32_t offset,
+              uint8_t * visible)
+{
+    __m256 outside = _mm256_setzero_ps();
+
+    for (uint32_t p = 0; p != PLANES_COUNT; ++p)
+    {
+        const glm::vec4 & plane = frustum.planes[p];
+
+        __m256 distance = _mm256_set1_ps(plane.w);
+        distance = _mm256_fmadd_ps(_mm256_set1_ps(plane.x),
+                                   _mm256_loadu_ps(corners[p].x + offset),
+                                   distance);
+        distance = _mm256_fmadd_ps(_mm256_set1_ps(plane.y),
+                                   _mm256_loadu_ps(corners[p].y + offset),
+                                   distance);
+        distance = _mm256_fmadd_ps(_mm256_set1_ps(plane.z),
+                                   _mm256_loadu_ps(corners[p].z + offset),
+                                   distance);
+
+        outside = _mm256_or_ps(outside,
+                               _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+    }
+
+    int mask = _mm256_movemask_ps(outside);
+    for (uint32_t i = 0; i != 8; ++i)
+        visible[offset + i] = !(mask & (1 << i));
+}
+} // namespace
+
+namespace math
+{
+Frustum Frustum::fromViewProj(const glm::mat4 & view_proj)
+{
+    // glm is column-major, row i of the matrix
+    glm::vec4 rows[4];
+    for (uint32_t i = 0; i != 4; ++i)
+        rows[i] = glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0]; // left
+    frustum.planes[1] = rows[3] - rows[0]; // right
+    frustum.planes[2] = rows[3] + rows[1]; // bottom
+    frustum.planes[3] = rows[3] - rows[1]; // top
+    frustum.planes[4] = rows[2]; // z >= 0
+    frustum.planes[5] = rows[3] - rows[2]; // z <= w
+
+    return frustum;
+}
+
+void BoxBatch::resize(uint32_t size)
+{
+    min_x.resize(size);
+    min_y.resize(size);
+    min_z.resize(size);
+
+    max_x.resize(size);
+    max_y.resize(size);
+    max_z.resize(size);
+}
+
+void BoxBatch::set(uint32_t index, const BoundingBox & box)
+{
+    min_x[index] = box.min.x;
+    min_y[index] = box.min.y;
+    min_z[index] = box.min.z;
+
+    max_x[index] = box.max.x;
+    max_y[index] = box.max.y;
+    max_z[index] = box.max.z;
+}
+
+BoundingBox BoxBatch::get(uint32_t index) const
+{
+    return {{min_x[index], min_y[index], min_z[index]},
+            {max_x[index], max_y[index], max_z[index]}};
+}
+
+BoundingBox transformBox(const BoundingBox & box, const glm::mat4 & transform)
+{
+    glm::vec3 center(transform * glm::vec4(box.center(), 1.0f));
+    glm::vec3 extent = box.size() / 2.0f;
+
+    // extent along each world axis is the sum of the projected box axes
+    glm::vec3 world_extent = glm::abs(glm::vec3(transform[0])) * extent.x +
+                             glm::abs(glm::vec3(transform[1])) * extent.y +
+                             glm::abs(glm::vec3(transform[2])) * extent.z;
+
+    return {center - world_extent, center + world_extent};
+}
+
+void cullBoxes(const Frustum & frustum,
+               const BoxBatch & boxes,
+               uint32_t begin,
+               uint32_t end,
+               uint8_t * visible,
+               SIMDLevel level)
+{
+    PlaneCorners corners[PLANES_COUNT];
+    selectCorners(frustum, boxes, corners);
+
+    uint32_t i = begin;
+
+    switch (level)
+    {
+    case SIMDLevel::AVX2:
+        for (; i + 8 <= end; i += 8)
+            cullAVX2(frustum, corners, i, visible);
+        break;
+    case SIMDLevel::SSE:
+        for (; i + 4 <= end; i += 4)
+            cullSSE(frustum, corners, i, visible);
+        break;
+    default:
+        break;
+    }
+
+    // the tail which doesn't fill a whole register
+    cullScalar(frustum, corners, i, end, visible);
+}
+} // namespace math
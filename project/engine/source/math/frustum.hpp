@@ -0,0 +1,54 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include "glm.hpp"
+#include <vector>
+
+#include "box.hpp"
+#include "simd.hpp"
+
+namespace math
+{
+// a point is inside if dot(plane.xyz, point) + plane.w >= 0 for all planes,
+// planes aren't normalized
+struct Frustum
+{
+    // D3D clip space: -w <= x, y <= w and 0 <= z <= w,
+    // the same for the reversed depth
+    static Frustum fromViewProj(const glm::mat4 & view_proj);
+
+    glm::vec4 planes[6];
+};
+
+// world space boxes transposed to SoA, so SIMD kernels load 4/8 of them at once
+struct BoxBatch
+{
+    void resize(uint32_t size);
+    void set(uint32_t index, const BoundingBox & box);
+    BoundingBox get(uint32_t index) const;
+
+    uint32_t size() const { return uint32_t(min_x.size()); }
+
+    std::vector<float> min_x;
+    std::vector<float> min_y;
+    std::vector<float> min_z;
+
+    std::vector<float> max_x;
+    std::vector<float> max_y;
+    std::vector<float> max_z;
+};
+
+// box of the transformed box
+BoundingBox transformBox(const BoundingBox & box, const glm::mat4 & transform);
+
+// visible[i] = 1 if boxes[i] isn't fully outside of one of the planes, otherwise 0,
+// boxes near the frustum corners can be visible, but never the opposite
+void cullBoxes(const Frustum & frustum,
+               const BoxBatch & boxes,
+               uint32_t begin,
+               uint32_t end,
+               uint8_t * visible,
+               SIMDLevel level = getSIMDLevel());
+} // namespace math
+
+#endif
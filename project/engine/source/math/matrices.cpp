@@ -27,4 +27,30 @@ glm::mat4 Transform::toMat4() const
     // scale -> rotate -> translate
     return translation * glm::mat4_cast(rotation) * scaling;
 }
+
+glm::mat4x3 Transform::toMat4x3() const
+{
+    glm::mat3 R = glm::mat3_cast(rotation);
+
+    return glm::mat4x3(R[0] * scale.x,
+                       R[1] * scale.y,
+                       R[2] * scale.z,
+                       position);
+}
+
+glm::mat4x3 Transform::toInvMat4x3() const
+{
+    // (T * R * S)^-1 = S^-1 * R^T * T^-1
+    glm::mat3 R = glm::mat3_cast(rotation);
+    glm::vec3 scale_inv = 1.0f / scale;
+
+    glm::mat3 RS_inv(R[0][0] * scale_inv.x, R[1][0] * scale_inv.y, R[2][0] * scale_inv.z,
+                     R[0][1] * scale_inv.x, R[1][1] * scale_inv.y, R[2][1] * scale_inv.z,
+                     R[0][2] * scale_inv.x, R[1][2] * scale_inv.y, R[2][2] * scale_inv.z);
+
+    return glm::mat4x3(RS_inv[0],
+                       RS_inv[1],
+                       RS_inv[2],
+                       -(RS_inv * position));
+}
 } // namespace math
@@ -21,6 +21,10 @@ public:
 
     glm::mat4 toMat4() const;
 
+    // affine 3x4 matrices, the last row is always (0, 0, 0, 1)
+    glm::mat4x3 toMat4x3() const;
+    glm::mat4x3 toInvMat4x3() const;
+
     glm::vec3 position;
     glm::vec3 scale;
     glm::quat rotation;
@@ -1,105 +1,383 @@
 #include "random.hpp"
 
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr uint64_t RANDOM_SEED = 0x5EED;
+
+constexpr float FLOAT_UNIT = 1.0f / 16777216.0f; // 2^-24
+
+uint64_t splitMix64(uint64_t & x)
+{
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+uint32_t rotl(uint32_t x, int k)
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+// one step of all the lanes
+void stepScalar(uint32_t (&s)[4][math::Random::LANES_COUNT], uint32_t * dst)
+{
+    for (uint32_t lane = 0; lane != math::Random::LANES_COUNT; ++lane)
+    {
+        dst[lane] = s[0][lane] + s[3][lane];
+
+        uint32_t t = s[1][lane] << 9;
+
+        s[2][lane] ^= s[0][lane];
+        s[3][lane] ^= s[1][lane];
+        s[1][lane] ^= s[2][lane];
+        s[0][lane] ^= s[3][lane];
+        s[2][lane] ^= t;
+        s[3][lane] = rotl(s[3][lane], 11);
+    }
+}
+
+// 4 lanes starting from the offset, returns the outputs
+__m128i stepSSE(uint32_t (&s)[4][math::Random::LANES_COUNT], uint32_t offset)
+{
+    __m128i s0 = _mm_load_si128(reinterpret_cast<const __m128i *>(s[0] + offset));
+    __m128i s1 = _mm_load_si128(reinterpret_cast<const __m128i *>(s[1] + offset));
+    __m128i s2 = _mm_load_si128(reinterpret_cast<const __m128i *>(s[2] + offset));
+    __m128i s3 = _mm_load_si128(reinterpret_cast<const __m128i *>(s[3] + offset));
+
+    __m128i result = _mm_add_epi32(s0, s3);
+    __m128i t = _mm_slli_epi32(s1, 9);
+
+    s2 = _mm_xor_si128(s2, s0);
+    s3 = _mm_xor_si128(s3, s1);
+    s1 = _mm_xor_si128(s1, s2);
+    s0 = _mm_xor_si128(s0, s3);
+    s2 = _mm_xor_si128(s2, t);
+    s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+    _mm_store_si128(reinterpret_cast<__m128i *>(s[0] + offset), s0);
+    _mm_store_si128(reinterpret_cast<__m128i *>(s[1] + offset), s1);
+    _mm_store_si128(reinterpret_cast<__m128i *>(s[2] + offset), s2);
+    _mm_store_si128(reinterpret_cast<__m128i *>(s[3] + offset), s3);
+
+    return result;
+}
+
+// min + scale * [0; 1), mul and add are separate to match the scalar code
+void fillSSE(uint32_t (&s)[4][math::Random::LANES_COUNT],
+             float * dst,
+             uint32_t steps_count,
+             float min,
+             float scale)
+{
+    __m128 unit = _mm_set1_ps(FLOAT_UNIT);
+    __m128 min_4 = _mm_set1_ps(min);
+    __m128 scale_4 = _mm_set1_ps(scale);
+
+    for (uint32_t step = 0; step != steps_count; ++step, dst += math::Random::LANES_COUNT)
+    {
+        for (uint32_t offset = 0; offset != math::Random::LANES_COUNT; offset += 4)
+        {
+            __m128i bits = _mm_srli_epi32(stepSSE(s, offset), 8);
+            __m128 value = _mm_mul_ps(_mm_cvtepi32_ps(bits), unit);
+            value = _mm_add_ps(min_4, _mm_mul_ps(scale_4, value));
+
+            _mm_storeu_ps(dst + offset, value);
+        }
+    }
+}
+
+// FMA, so the values can differ from the scalar ones in the last bit
+MATH_TARGET_AVX2
+void fillAVX2(uint32_t (&s)[4][math::Random::LANES_COUNT],
+              float * dst,
+              uint32_t steps_count,
+              float min,
+              float scale)
+{
+    __m256i s0 = _mm256_load_si256(reinterpret_cast<const __m256i *>(s[0]));
+    __m256i s1 = _mm256_load_si256(reinterpret_cast<const __m256i *>(s[1]));
+    __m256i s2 = _mm256_load_si256(reinterpret_cast<const __m256i *>(s[2]));
+    __m256i s3 = _mm256_load_si256(reinterpret_cast<const __m256i *>(s[3]));
+
+    __m256 unit = _mm256_set1_ps(FLOAT_UNIT);
+    __m256 min_8 = _mm256_set1_ps(min);
+    __m256 scale_8 = _mm256_set1_ps(scale);
+
+    // the state stays in registers between the steps
+    for (uint32_t step = 0; step != steps_count; ++step, dst += math::Random::LANES_COUNT)
+    {
+        __m256i bits = _mm256_srli_epi32(_mm256_add_epi32(s0, s3), 8);
+        __m256i t = _mm256_slli_epi32(s1, 9);
+
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+
+        __m256 value = _mm256_mul_ps(_mm256_cvtepi32_ps(bits), unit);
+        value = _mm256_fmadd_ps(scale_8, value, min_8);
+
+        _mm256_storeu_ps(dst, value);
+    }
+
+    _mm256_store_si256(reinterpret_cast<__m256i *>(s[0]), s0);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(s[1]), s1);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(s[2]), s2);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(s[3]), s3);
+}
+} // namespace
+
 namespace math
 {
-// [min; max)
-float randomFromRange(float min, float max)
+void Random::setSeed(uint64_t seed, uint64_t stream)
 {
-    std::random_device random_device;
-    std::mt19937 mersenne_random(random_device());
-    
-    std::uniform_real_distribution<float> distribution(min, max);
-    return distribution(random_device);
+    uint64_t x = seed ^ splitMix64(stream);
+
+    for (uint32_t lane = 0; lane != LANES_COUNT; ++lane)
+    {
+        uint64_t a = splitMix64(x);
+        uint64_t b = splitMix64(x);
+
+        state[0][lane] = uint32_t(a);
+        state[1][lane] = uint32_t(a >> 32);
+        state[2][lane] = uint32_t(b);
+        state[3][lane] = uint32_t(b >> 32);
+    }
+
+    buffered = LANES_COUNT;
 }
 
-std::vector<glm::vec2> poissonDiscSampling(uint32_t width,
-                                           uint32_t height,
-                                           float radius,
-                                           uint32_t k)
+void Random::refill()
 {
-    std::vector<glm::vec2> positions;
-    
-    float cell_size = radius / sqrtf(2.0f);
+    stepScalar(state, buffer);
+    buffered = 0;
+}
+
+void Random::fill(float * dst,
+                  uint32_t count,
+                  float min,
+                  float max,
+                  SIMDLevel level)
+{
+    uint32_t i = 0;
+
+    // the rest of the last step goes first
+    for (; i != count && buffered != LANES_COUNT; ++i)
+        dst[i] = range(min, max);
+
+    uint32_t steps_count = (count - i) / LANES_COUNT;
+    float scale = max - min;
+
+    switch (level)
+    {
+    case SIMDLevel::AVX2:
+        fillAVX2(state, dst + i, steps_count, min, scale);
+        i += steps_count * LANES_COUNT;
+        break;
+    case SIMDLevel::SSE:
+        fillSSE(state, dst + i, steps_count, min, scale);
+        i += steps_count * LANES_COUNT;
+        break;
+    default:
+        break;
+    }
+
+    for (; i != count; ++i)
+        dst[i] = range(min, max);
+}
 
-    std::vector<glm::vec2> grid(width * height, glm::vec2(-1.0f));
+void Random::fill(glm::vec3 * dst,
+                  uint32_t count,
+                  const glm::vec3 & min,
+                  const glm::vec3 & max,
+                  SIMDLevel level)
+{
+    if (count == 0) return;
+
+    // [0; 1) is exact, so scaling it later gives the same values as range()
+    float * values = &dst[0].x;
+    fill(values, count * 3, 0.0f, 1.0f, level);
+
+    for (uint32_t i = 0; i != count; ++i)
+        dst[i] = min + (max - min) * dst[i];
+}
+
+Random & getThreadRandom()
+{
+    static std::atomic<uint64_t> threads_count{0};
+
+    thread_local Random random(RANDOM_SEED, threads_count++);
+    return random;
+}
+
+PoissonDiscSampler::PoissonDiscSampler(const glm::vec2 & size,
+                                       float radius,
+                                       float tile_size,
+                                       uint32_t k,
+                                       uint64_t seed) :
+                                       size(size),
+                                       radius(radius),
+                                       cell_size(radius / sqrtf(2.0f)),
+                                       k(k),
+                                       seed(seed)
+{
+    grid_width = std::max(int(ceilf(size.x / cell_size)), 1);
+    grid_height = std::max(int(ceilf(size.y / cell_size)), 1);
+    grid.assign(size_t(grid_width) * grid_height, glm::vec2(-1.0f));
+
+    // a sample sees 2 cells around, so tiles of one pass are 2 cells apart at least
+    tile_cells = std::max(int(ceilf(tile_size / cell_size)), 2);
+    tiles_x = (grid_width + tile_cells - 1) / tile_cells;
+    tiles_y = (grid_height + tile_cells - 1) / tile_cells;
+
+    tile_samples.resize(getTilesCount());
+
+    for (uint32_t y = 0; y != tiles_y; ++y)
+    {
+        for (uint32_t x = 0; x != tiles_x; ++x)
+            pass_tiles[(x & 1) + (y & 1) * 2].push_back(y * tiles_x + x);
+    }
+}
 
-    glm::vec2 random_point(randomFromRange(0.0f, width),
-                           randomFromRange(0.0f, height));
+bool PoissonDiscSampler::isFar(const glm::vec2 & point) const
+{
+    glm::vec<2, int> cell = getCell(point);
+
+    for (int y = std::max(cell.y - 2, 0), max_y = std::min(cell.y + 2, grid_height - 1); y <= max_y; ++y)
+    {
+        for (int x = std::max(cell.x - 2, 0), max_x = std::min(cell.x + 2, grid_width - 1); x <= max_x; ++x)
+        {
+            const glm::vec2 & neighbor = grid[y * grid_width + x];
+            if (neighbor.x < 0.0f) continue;
+
+            glm::vec2 offset = neighbor - point;
+            if (glm::dot(offset, offset) < radius * radius) return false;
+        }
+    }
 
-    grid[uint32_t(random_point.x / cell_size) +
-         uint32_t(random_point.y / cell_size) * width] = random_point;
+    return true;
+}
 
+void PoissonDiscSampler::sampleTile(uint32_t tile)
+{
+    glm::vec<2, int> tile_min(int(tile % tiles_x) * tile_cells,
+                              int(tile / tiles_x) * tile_cells);
+    glm::vec<2, int> tile_max(std::min(tile_min.x + tile_cells, grid_width),
+                              std::min(tile_min.y + tile_cells, grid_height));
+
+    // a sample belongs to the tile of its cell, so the tiles never write to the same cells
+    auto isInside = [&](const glm::vec2 & point)
+    {
+        if (point.x < 0.0f || point.x >= size.x ||
+            point.y < 0.0f || point.y >= size.y) return false;
+
+        glm::vec<2, int> cell = getCell(point);
+        return cell.x >= tile_min.x && cell.x < tile_max.x &&
+               cell.y >= tile_min.y && cell.y < tile_max.y;
+    };
+
+    Random random(seed, tile);
+
+    std::vector<glm::vec2> & samples = tile_samples[tile];
+    samples.clear();
+
+    // the samples of the sampled neighbors grow into the tile
     std::vector<glm::vec2> active;
-    active.push_back(random_point);
+    for (int y = std::max(tile_min.y - 2, 0), max_y = std::min(tile_max.y + 2, grid_height); y != max_y; ++y)
+    {
+        for (int x = std::max(tile_min.x - 2, 0), max_x = std::min(tile_max.x + 2, grid_width); x != max_x; ++x)
+        {
+            const glm::vec2 & neighbor = grid[y * grid_width + x];
+            if (neighbor.x >= 0.0f) active.push_back(neighbor);
+        }
+    }
+
+    auto addSample = [&](const glm::vec2 & point)
+    {
+        glm::vec<2, int> cell = getCell(point);
+        grid[cell.y * grid_width + cell.x] = point;
+
+        samples.push_back(point);
+        active.push_back(point);
+    };
+
+    glm::vec2 start = random.range(glm::vec2(tile_min) * cell_size,
+                                   glm::min(glm::vec2(tile_max) * cell_size, size));
+    if (isInside(start) && isFar(start)) addSample(start);
+
+    std::vector<float> lengths(k);
+    std::vector<float> angles(k);
+
+    while (!active.empty())
+    {
+        uint32_t index = random.index(uint32_t(active.size()));
+        glm::vec2 center = active[index];
+
+        // candidates of one point in a batch
+        random.fill(lengths.data(), k, radius, 2.0f * radius);
+        random.fillAngles(angles.data(), k);
 
-    positions.push_back(random_point);
-    
-    while (active.size() > 0)
-    {        
-        uint32_t rand_i = uint32_t(randomFromRange(0.0f, active.size()));
         bool found = false;
-        
         for (uint32_t i = 0; i != k; ++i)
         {
-            float length = randomFromRange(radius, 2 * radius);
-            float angle = randomFromRange(0.0f, 2 * PI);
-
-            glm::vec2 sample = active[rand_i] +
-                               glm::vec2(cosf(angle), sinf(angle)) * length;
-
-            // check if coordinates belong to the grid
-            if (sample.x < 0.0f || sample.x >= int(width) ||
-                sample.y < 0.0f || sample.y >= int(height)) continue;
-            
-            glm::vec<2, int> sample_coord(int(sample.x / cell_size),
-                                          int(sample.y / cell_size));
-            
-            // check if this grid's cell is empty
-            if (grid[sample_coord.x + sample_coord.y * width].x >= 0.0f) continue;
+            glm::vec2 sample = center + glm::vec2(cosf(angles[i]), sinf(angles[i])) * lengths[i];
+
+            if (!isInside(sample) || !isFar(sample)) continue;
 
+            addSample(sample);
             found = true;
-            
-            for (int row = -1; row <= 1; ++row)
-            {
-                for (int col = -1; col <= 1; ++col)
-                {
-                    if (row == 0 && col == 0) continue;                    
-                    
-                    glm::vec<2, int> neighbor_coord(sample_coord.x + row,
-                                                    sample_coord.y + col);
-
-                    // check if coordinates belong to the grid
-                    if (neighbor_coord.x < 0.0f || neighbor_coord.x >= int(width) ||
-                        neighbor_coord.y < 0.0f || neighbor_coord.y >= int(height)) continue;
-                    
-                    glm::vec2 neighbor = grid[neighbor_coord.x +
-                                              neighbor_coord.y * width];
-
-                    // check if this grid's cell not empty
-                    if (neighbor.x >= 0.0f)
-                    {
-                        float dist = glm::distance(sample, neighbor);
-                        if (dist < radius)
-                        {
-                            found = false;
-                            goto next_sample;
-                        }
-                    }
-                }
-            }
-
-            if (found)
-            {
-                grid[sample_coord.x + sample_coord.y * width] = sample;
-                active.push_back(sample);
-                positions.push_back(sample);
-                break;
-            }
-            
-            next_sample: continue;
+            break;
         }
-        if (!found) active.erase(active.begin() + rand_i);
+
+        // swap-remove, the order of active points doesn't matter
+        if (!found)
+        {
+            active[index] = active.back();
+            active.pop_back();
+        }
+    }
+}
+
+void PoissonDiscSampler::sampleAll()
+{
+    for (uint32_t pass = 0; pass != PASSES_COUNT; ++pass)
+    {
+        for (uint32_t tile : pass_tiles[pass])
+            sampleTile(tile);
     }
+}
+
+void PoissonDiscSampler::getSamples(std::vector<glm::vec2> & samples) const
+{
+    samples.clear();
+
+    for (const std::vector<glm::vec2> & tile : tile_samples)
+        samples.insert(samples.end(), tile.begin(), tile.end());
+}
+
+std::vector<glm::vec2> poissonDiscSampling(uint32_t width,
+                                           uint32_t height,
+                                           float radius,
+                                           uint32_t k)
+{
+    glm::vec2 size(width, height);
+
+    PoissonDiscSampler sampler(size,
+                               radius,
+                               std::max(size.x, size.y),
+                               k,
+                               getThreadRandom().next());
+    sampler.sampleAll();
+
+    std::vector<glm::vec2> positions;
+    sampler.getSamples(positions);
 
     return positions;
 }
@@ -1,16 +1,152 @@
 #ifndef RANDOM_HPP
 #define RANDOM_HPP
 
-#include <random>
 #include <vector>
+#include <cstdint>
 #include "glm.hpp"
 
 #include "constants.hpp"
+#include "simd.hpp"
 
 namespace math
 {
-float randomFromRange(float min, float max);
+// xoshiro128+ with LANES_COUNT independent streams stepped together,
+// so batches are generated with SSE/AVX2 and the single values are taken from a buffer
+// of one step. The bits depend only on the seed, not on the SIMD level,
+// floats of AVX2 batches can differ in the last bit because of FMA.
+// Not thread-safe, every thread uses its own one, see getThreadRandom().
+class Random
+{
+public:
+    static constexpr uint32_t LANES_COUNT = 8;
+
+    // different streams of one seed are independent
+    explicit Random(uint64_t seed = 0, uint64_t stream = 0) { setSeed(seed, stream); }
+
+    void setSeed(uint64_t seed, uint64_t stream = 0);
+
+    uint32_t next()
+    {
+        if (buffered == LANES_COUNT) refill();
+        return buffer[buffered++];
+    }
+
+    // [0; 1), 24 bits
+    float nextFloat() { return float(next() >> 8) * (1.0f / 16777216.0f); }
+
+    // [min; max)
+    float range(float min, float max) { return min + (max - min) * nextFloat(); }
+    glm::vec2 range(const glm::vec2 & min, const glm::vec2 & max)
+    {
+        float x = range(min.x, max.x);
+        return glm::vec2(x, range(min.y, max.y));
+    }
+    glm::vec3 range(const glm::vec3 & min, const glm::vec3 & max)
+    {
+        float x = range(min.x, max.x);
+        float y = range(min.y, max.y);
+        return glm::vec3(x, y, range(min.z, max.z));
+    }
+
+    // [0; count)
+    uint32_t index(uint32_t count) { return uint32_t((uint64_t(next()) * count) >> 32); }
+
+    // [0; 2 * PI)
+    float angle() { return range(0.0f, 2.0f * PI); }
+
+    // the same values as the same number of range() calls, see the note about AVX2
+    void fill(float * dst,
+              uint32_t count,
+              float min,
+              float max,
+              SIMDLevel level = getSIMDLevel());
+
+    void fill(glm::vec3 * dst,
+              uint32_t count,
+              const glm::vec3 & min,
+              const glm::vec3 & max,
+              SIMDLevel level = getSIMDLevel());
+
+    void fillAngles(float * dst, uint32_t count, SIMDLevel level = getSIMDLevel())
+    {
+        fill(dst, count, 0.0f, 2.0f * PI, level);
+    }
+
+protected:
+    void refill();
+
+    // SoA, state[i][lane]
+    alignas(32) uint32_t state[4][LANES_COUNT];
+
+    // the last step, taken by next()
+    alignas(32) uint32_t buffer[LANES_COUNT] = {};
+    uint32_t buffered = LANES_COUNT; // index of the next value
+};
+
+// the generator of the calling thread, seeded by the order in which threads
+// first used it, so the sequence of the main thread is the same on every run
+Random & getThreadRandom();
+
+// Bridson's Poisson-disc sampling of [0; size) split into square tiles.
+// Tiles of one pass don't touch each other, so they can be sampled in parallel,
+// a tile starts from the samples near its border left by the previous passes,
+// so the samples grow across the seams without gaps or overlaps.
+// Every tile has its own generator, so the result doesn't depend on the threads.
+class PoissonDiscSampler
+{
+public:
+    static constexpr uint32_t PASSES_COUNT = 4;
+
+    // radius - min distance between two samples,
+    // tile_size is rounded up to the grid cells,
+    // k - limit of candidates around a sample before it's rejected
+    PoissonDiscSampler(const glm::vec2 & size,
+                       float radius,
+                       float tile_size,
+                       uint32_t k = 30,
+                       uint64_t seed = 0);
+
+    uint32_t getTilesCount() const { return tiles_x * tiles_y; }
+
+    const std::vector<uint32_t> & getPassTiles(uint32_t pass) const { return pass_tiles[pass]; }
+
+    // the tiles of the previous passes have to be sampled,
+    // thread-safe for different tiles of one pass
+    void sampleTile(uint32_t tile);
+
+    // every pass on the calling thread
+    void sampleAll();
+
+    // in the tile order
+    void getSamples(std::vector<glm::vec2> & samples) const;
+
+protected:
+    glm::vec<2, int> getCell(const glm::vec2 & point) const
+    {
+        return glm::vec<2, int>(point / cell_size);
+    }
+
+    // no sample is closer than radius
+    bool isFar(const glm::vec2 & point) const;
+
+    glm::vec2 size;
+    float radius;
+    float cell_size; // at most one sample per cell
+    uint32_t k;
+    uint64_t seed;
+
+    int grid_width; // in cells
+    int grid_height;
+    std::vector<glm::vec2> grid; // x < 0 - empty cell
+
+    int tile_cells; // tile size in cells
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    std::vector<uint32_t> pass_tiles[PASSES_COUNT];
+    std::vector<std::vector<glm::vec2>> tile_samples;
+};
 
+// one tile on the calling thread,
 // r - min distance between two samples
 // k - limit of samples to choose before rejection
 std::vector<glm::vec2> poissonDiscSampling(uint32_t width,
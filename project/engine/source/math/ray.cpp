@@ -62,4 +62,32 @@ bool Ray::intersect(MeshIntersection & nearest,
     return true;
 }
 
+void RayPacket::clear()
+{
+    for (uint32_t i = 0; i != SIZE; ++i) set(i, Ray(glm::vec3(0.0f), glm::vec3(1.0f)));
+    mask = 0;
+}
+
+void RayPacket::set(uint32_t lane, const Ray & ray)
+{
+    origin_x[lane] = ray.origin.x;
+    origin_y[lane] = ray.origin.y;
+    origin_z[lane] = ray.origin.z;
+
+    direction_x[lane] = ray.direction.x;
+    direction_y[lane] = ray.direction.y;
+    direction_z[lane] = ray.direction.z;
+
+    direction_inv_x[lane] = 1.0f / ray.direction.x;
+    direction_inv_y[lane] = 1.0f / ray.direction.y;
+    direction_inv_z[lane] = 1.0f / ray.direction.z;
+
+    mask |= 1u << lane;
+}
+
+Ray RayPacket::get(uint32_t lane) const
+{
+    return Ray(glm::vec3(origin_x[lane], origin_y[lane], origin_z[lane]),
+               glm::vec3(direction_x[lane], direction_y[lane], direction_z[lane]));
+}
 } // namespace math
@@ -2,6 +2,7 @@
 #define RAY_HPP
 
 #include <algorithm>
+#include <cstdint>
 #include "glm.hpp"
 
 #include "box.hpp"
@@ -29,6 +30,33 @@ public:
 glm::vec3 origin;
 glm::vec3 direction;
 };
+
+// up to SIZE rays in SoA layout for SIMD traversal
+struct alignas(32) RayPacket
+{
+    static constexpr uint32_t SIZE = 8;
+
+    void clear();
+    void set(uint32_t lane, const Ray & ray);
+    Ray get(uint32_t lane) const;
+
+    bool empty() const { return mask == 0; }
+
+    float origin_x[SIZE];
+    float origin_y[SIZE];
+    float origin_z[SIZE];
+
+    float direction_x[SIZE];
+    float direction_y[SIZE];
+    float direction_z[SIZE];
+
+    // 1 / direction for slab tests
+    float direction_inv_x[SIZE];
+    float direction_inv_y[SIZE];
+    float direction_inv_z[SIZE];
+
+    uint32_t mask = 0; // bit per active lane
+};
 } // namespace math
 
 #endif
@@ -0,0 +1,75 @@
+#include "simd.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+math::SIMDLevel detectSIMDLevel()
+{
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 0);
+    int ids_count = info[0];
+
+    __cpuid(info, 1);
+    bool has_sse2 = (info[3] & (1 << 26)) != 0;
+    bool has_osxsave = (info[2] & (1 << 27)) != 0;
+    bool has_avx = (info[2] & (1 << 28)) != 0;
+    bool has_fma = (info[2] & (1 << 12)) != 0;
+
+    bool has_avx2 = false;
+    if (ids_count >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        has_avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    // OS has to save YMM registers on context switch
+    bool os_saves_ymm = has_osxsave && (_xgetbv(0) & 0x6) == 0x6;
+
+    if (has_avx && has_avx2 && has_fma && os_saves_ymm) return math::SIMDLevel::AVX2;
+    if (has_sse2) return math::SIMDLevel::SSE;
+#else
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2") &&
+        __builtin_cpu_supports("fma")) return math::SIMDLevel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return math::SIMDLevel::SSE;
+#endif
+    return math::SIMDLevel::SCALAR;
+}
+
+// function statics, so it's safe to call from other static initializers
+const math::SIMDLevel & supportedLevel()
+{
+    static const math::SIMDLevel level = detectSIMDLevel();
+    return level;
+}
+
+math::SIMDLevel & currentLevel()
+{
+    static math::SIMDLevel level = supportedLevel();
+    return level;
+}
+} // namespace
+
+namespace math
+{
+SIMDLevel getSIMDLevel()
+{
+    return currentLevel();
+}
+
+void setSIMDLevel(SIMDLevel level)
+{
+    currentLevel() = level < supportedLevel() ? level : supportedLevel();
+}
+
+SIMDLevel getSupportedSIMDLevel()
+{
+    return supportedLevel();
+}
+} // namespace math
@@ -0,0 +1,34 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <immintrin.h>
+#include <cstdint>
+
+// MSVC allows AVX2 intrinsics in any function,
+// GCC and Clang need the target to be enabled per function
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MATH_TARGET_AVX2
+#else
+#define MATH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace math
+{
+enum class SIMDLevel
+{
+    SCALAR,
+    SSE, // SSE2, 4 floats
+    AVX2 // 8 floats
+};
+
+// the best level supported by CPU and OS, or the one set by setSIMDLevel()
+SIMDLevel getSIMDLevel();
+
+// can't raise the level above the supported one,
+// use SIMDLevel::SCALAR to compare against the reference code
+void setSIMDLevel(SIMDLevel level);
+
+SIMDLevel getSupportedSIMDLevel();
+} // namespace math
+
+#endif
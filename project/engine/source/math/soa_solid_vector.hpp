@@ -0,0 +1,208 @@
+#ifndef SOA_SOLID_VECTOR_H
+#define SOA_SOLID_VECTOR_H
+
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <limits>
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+
+namespace math
+{
+// SolidVector with generational handles and SoA storage:
+// each of Columns is stored in its own dense array,
+// so a kernel streams only the columns it touches.
+// A handle is generation (high bits) + slot (low bits),
+// so a stale handle of an erased element is never valid again
+// (until the generation wraps around after 4096 reuses of the slot).
+template<class... Columns>
+class SoASolidVector
+{
+public:
+    using Handle = uint32_t;
+
+    static constexpr uint32_t SLOT_BITS = 20;
+    static constexpr uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+    static constexpr uint32_t GENERATION_MASK = (1u << (32 - SLOT_BITS)) - 1;
+
+    // never returned by insert()
+    static constexpr Handle INVALID_HANDLE = std::numeric_limits<Handle>::max();
+
+    template<uint32_t C>
+    using Column = typename std::tuple_element<C, std::tuple<Columns...>>::type;
+
+protected:
+    struct Slot
+    {
+        uint32_t index; // in columns if occupied, otherwise the next unused slot
+        uint32_t generation;
+        bool occupied;
+    };
+
+    static uint32_t getSlot(Handle handle) { return handle & SLOT_MASK; }
+    static uint32_t getGeneration(Handle handle) { return handle >> SLOT_BITS; }
+
+    static Handle makeHandle(uint32_t slot, uint32_t generation)
+    {
+        return (generation << SLOT_BITS) | slot;
+    }
+
+    void assertHandle(Handle handle) const
+    {
+        assert(valid(handle) && "stale or invalid handle");
+    }
+
+public:
+    bool valid(Handle handle) const
+    {
+        uint32_t slot = getSlot(handle);
+        return slot < slots.size() &&
+               slots[slot].occupied &&
+               slots[slot].generation == getGeneration(handle);
+    }
+
+    uint32_t size() const { return uint32_t(backward_map.size()); }
+
+    // index of the element in the column arrays, changes after erase()
+    uint32_t indexOf(Handle handle) const
+    {
+        assertHandle(handle);
+        return slots[getSlot(handle)].index;
+    }
+
+    Handle handleAt(uint32_t index) const
+    {
+        assert(index < backward_map.size());
+
+        uint32_t slot = backward_map[index];
+        return makeHandle(slot, slots[slot].generation);
+    }
+
+    template<uint32_t C>
+    const std::vector<Column<C>> & column() const { return std::get<C>(columns); }
+    template<uint32_t C>
+    std::vector<Column<C>> & column() { return std::get<C>(columns); }
+
+    template<uint32_t C>
+    const Column<C> & at(uint32_t index) const
+    {
+        assert(index < size());
+        return std::get<C>(columns)[index];
+    }
+    template<uint32_t C>
+    Column<C> & at(uint32_t index)
+    {
+        assert(index < size());
+        return std::get<C>(columns)[index];
+    }
+
+    template<uint32_t C>
+    const Column<C> & get(Handle handle) const
+    {
+        return std::get<C>(columns)[indexOf(handle)];
+    }
+    template<uint32_t C>
+    Column<C> & get(Handle handle)
+    {
+        return std::get<C>(columns)[indexOf(handle)];
+    }
+
+    // nullptr for a stale handle, for handles which can outlive their elements
+    template<uint32_t C>
+    const Column<C> * find(Handle handle) const
+    {
+        return valid(handle) ? &std::get<C>(columns)[slots[getSlot(handle)].index] : nullptr;
+    }
+    template<uint32_t C>
+    Column<C> * find(Handle handle)
+    {
+        return valid(handle) ? &std::get<C>(columns)[slots[getSlot(handle)].index] : nullptr;
+    }
+
+    Handle insert(const Columns & ... values)
+    {
+        uint32_t slot = next_unused;
+        assert(slot <= slots.size());
+
+        if (slot == slots.size())
+        {
+            // the last slot is reserved, so INVALID_HANDLE is never made
+            assert(slot < SLOT_MASK && "SoASolidVector is full");
+            slots.push_back({static_cast<uint32_t>(slots.size() + 1), 0, false});
+        }
+
+        Slot & s = slots[slot];
+        assert(!s.occupied);
+
+        next_unused = s.index;
+        s.index = size();
+        s.occupied = true;
+
+        pushBack(std::index_sequence_for<Columns...>(), values...);
+        backward_map.push_back(slot);
+
+        return makeHandle(slot, s.generation);
+    }
+
+    void erase(Handle handle)
+    {
+        assertHandle(handle);
+
+        uint32_t slot = getSlot(handle);
+        uint32_t index = slots[slot].index;
+
+        // the last element is moved in place of the erased one
+        swapRemove(std::index_sequence_for<Columns...>(), index);
+
+        uint32_t moved_slot = backward_map.back();
+        backward_map[index] = moved_slot;
+        backward_map.pop_back();
+
+        slots[moved_slot].index = index;
+
+        Slot & s = slots[slot];
+        s.index = next_unused;
+        s.generation = (s.generation + 1) & GENERATION_MASK;
+        s.occupied = false;
+        next_unused = slot;
+    }
+
+    void clear()
+    {
+        clearColumns(std::index_sequence_for<Columns...>());
+        slots.clear();
+        backward_map.clear();
+        next_unused = 0;
+    }
+
+protected:
+    template<std::size_t... C>
+    void pushBack(std::index_sequence<C...>, const Columns & ... values)
+    {
+        (std::get<C>(columns).push_back(values), ...);
+    }
+
+    template<std::size_t... C>
+    void swapRemove(std::index_sequence<C...>, uint32_t index)
+    {
+        ((std::get<C>(columns)[index] = std::move(std::get<C>(columns).back()),
+          std::get<C>(columns).pop_back()), ...);
+    }
+
+    template<std::size_t... C>
+    void clearColumns(std::index_sequence<C...>)
+    {
+        (std::get<C>(columns).clear(), ...);
+    }
+
+    std::tuple<std::vector<Columns>...> columns;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> backward_map; // column index -> slot
+
+    uint32_t next_unused = 0;
+};
+} // namespace math
+
+#endif
@@ -0,0 +1,322 @@
+#include "transform_batch.hpp"
+
+namespace
+{
+constexpr uint32_t MATRIX_FLOATS = 12; // glm::mat4x3 is 4 columns of vec3
+
+// lanes are transposed back from SoA: matrix i gets columns[k][i] as its k-th float
+void storeMatrices(const float (*columns)[8],
+                   uint32_t lanes,
+                   glm::mat4x3 * matrices)
+{
+    for (uint32_t i = 0; i != lanes; ++i)
+    {
+        float * dst = &matrices[i][0][0];
+        for (uint32_t k = 0; k != MATRIX_FLOATS; ++k)
+            dst[k] = columns[k][i];
+    }
+}
+
+void computeScalar(const math::TransformBatch & batch,
+                   uint32_t begin,
+                   uint32_t end,
+                   glm::mat4x3 * world,
+                   glm::mat4x3 * world_inv)
+{
+    for (uint32_t i = begin; i != end; ++i)
+    {
+        math::Transform transform;
+        transform.position = glm::vec3(batch.position_x[i],
+                                       batch.position_y[i],
+                                       batch.position_z[i]);
+        transform.rotation = glm::quat(batch.rotation_w[i],
+                                       batch.rotation_x[i],
+                                       batch.rotation_y[i],
+                                       batch.rotation_z[i]);
+        transform.scale = glm::vec3(batch.scale_x[i],
+                                    batch.scale_y[i],
+                                    batch.scale_z[i]);
+
+        world[i] = transform.toMat4x3();
+        world_inv[i] = transform.toInvMat4x3();
+    }
+}
+
+// 4 transforms starting from the offset
+void computeSSE(const math::TransformBatch & batch,
+                uint32_t offset,
+                glm::mat4x3 * world,
+                glm::mat4x3 * world_inv)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 p_x = _mm_loadu_ps(batch.position_x.data() + offset);
+    __m128 p_y = _mm_loadu_ps(batch.position_y.data() + offset);
+    __m128 p_z = _mm_loadu_ps(batch.position_z.data() + offset);
+
+    __m128 q_x = _mm_loadu_ps(batch.rotation_x.data() + offset);
+    __m128 q_y = _mm_loadu_ps(batch.rotation_y.data() + offset);
+    __m128 q_z = _mm_loadu_ps(batch.rotation_z.data() + offset);
+    __m128 q_w = _mm_loadu_ps(batch.rotation_w.data() + offset);
+
+    __m128 s_x = _mm_loadu_ps(batch.scale_x.data() + offset);
+    __m128 s_y = _mm_loadu_ps(batch.scale_y.data() + offset);
+    __m128 s_z = _mm_loadu_ps(batch.scale_z.data() + offset);
+
+    // quaternion -> rotation matrix, the same as glm::mat3_cast()
+    __m128 x2 = _mm_add_ps(q_x, q_x);
+    __m128 y2 = _mm_add_ps(q_y, q_y);
+    __m128 z2 = _mm_add_ps(q_z, q_z);
+
+    __m128 xx = _mm_mul_ps(q_x, x2);
+    __m128 yy = _mm_mul_ps(q_y, y2);
+    __m128 zz = _mm_mul_ps(q_z, z2);
+    __m128 xy = _mm_mul_ps(q_x, y2);
+    __m128 xz = _mm_mul_ps(q_x, z2);
+    __m128 yz = _mm_mul_ps(q_y, z2);
+    __m128 wx = _mm_mul_ps(q_w, x2);
+    __m128 wy = _mm_mul_ps(q_w, y2);
+    __m128 wz = _mm_mul_ps(q_w, z2);
+
+    // r_ij - column i, row j
+    __m128 r_00 = _mm_sub_ps(one, _mm_add_ps(yy, zz));
+    __m128 r_01 = _mm_add_ps(xy, wz);
+    __m128 r_02 = _mm_sub_ps(xz, wy);
+
+    __m128 r_10 = _mm_sub_ps(xy, wz);
+    __m128 r_11 = _mm_sub_ps(one, _mm_add_ps(xx, zz));
+    __m128 r_12 = _mm_add_ps(yz, wx);
+
+    __m128 r_20 = _mm_add_ps(xz, wy);
+    __m128 r_21 = _mm_sub_ps(yz, wx);
+    __m128 r_22 = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+
+    alignas(16) float columns[MATRIX_FLOATS][8];
+
+    // world = T * R * S
+    _mm_store_ps(columns[0], _mm_mul_ps(r_00, s_x));
+    _mm_store_ps(columns[1], _mm_mul_ps(r_01, s_x));
+    _mm_store_ps(columns[2], _mm_mul_ps(r_02, s_x));
+    _mm_store_ps(columns[3], _mm_mul_ps(r_10, s_y));
+    _mm_store_ps(columns[4], _mm_mul_ps(r_11, s_y));
+    _mm_store_ps(columns[5], _mm_mul_ps(r_12, s_y));
+    _mm_store_ps(columns[6], _mm_mul_ps(r_20, s_z));
+    _mm_store_ps(columns[7], _mm_mul_ps(r_21, s_z));
+    _mm_store_ps(columns[8], _mm_mul_ps(r_22, s_z));
+    _mm_store_ps(columns[9], p_x);
+    _mm_store_ps(columns[10], p_y);
+    _mm_store_ps(columns[11], p_z);
+
+    storeMatrices(columns, 4, world + offset);
+
+    // world_inv = S^-1 * R^T * T^-1
+    __m128 s_inv_x = _mm_div_ps(one, s_x);
+    __m128 s_inv_y = _mm_div_ps(one, s_y);
+    __m128 s_inv_z = _mm_div_ps(one, s_z);
+
+    __m128 inv_00 = _mm_mul_ps(r_00, s_inv_x);
+    __m128 inv_01 = _mm_mul_ps(r_10, s_inv_y);
+    __m128 inv_02 = _mm_mul_ps(r_20, s_inv_z);
+
+    __m128 inv_10 = _mm_mul_ps(r_01, s_inv_x);
+    __m128 inv_11 = _mm_mul_ps(r_11, s_inv_y);
+    __m128 inv_12 = _mm_mul_ps(r_21, s_inv_z);
+
+    __m128 inv_20 = _mm_mul_ps(r_02, s_inv_x);
+    __m128 inv_21 = _mm_mul_ps(r_12, s_inv_y);
+    __m128 inv_22 = _mm_mul_ps(r_22, s_inv_z);
+
+    __m128 t_x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(inv_00, p_x),
+                                       _mm_mul_ps(inv_10, p_y)),
+                            _mm_mul_ps(inv_20, p_z));
+    __m128 t_y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(inv_01, p_x),
+                                       _mm_mul_ps(inv_11, p_y)),
+                            _mm_mul_ps(inv_21, p_z));
+    __m128 t_z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(inv_02, p_x),
+                                       _mm_mul_ps(inv_12, p_y)),
+                            _mm_mul_ps(inv_22, p_z));
+
+    _mm_store_ps(columns[0], inv_00);
+    _mm_store_ps(columns[1], inv_01);
+    _mm_store_ps(columns[2], inv_02);
+    _mm_store_ps(columns[3], inv_10);
+    _mm_store_ps(columns[4], inv_11);
+    _mm_store_ps(columns[5], inv_12);
+    _mm_store_ps(columns[6], inv_20);
+    _mm_store_ps(columns[7], inv_21);
+    _mm_store_ps(columns[8], inv_22);
+    _mm_store_ps(columns[9], _mm_sub_ps(zero, t_x));
+    _mm_store_ps(columns[10], _mm_sub_ps(zero, t_y));
+    _mm_store_ps(columns[11], _mm_sub_ps(zero, t_z));
+
+    storeMatrices(columns, 4, world_inv + offset);
+}
+
+// 8 transforms starting from the offset
+MATH_TARGET_AVX2
+void computeAVX2(const math::TransformBatch & batch,
+                 uint32_t offset,
+                 glm::mat4x3 * world,
+                 glm::mat4x3 * world_inv)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    __m256 p_x = _mm256_loadu_ps(batch.position_x.data() + offset);
+    __m256 p_y = _mm256_loadu_ps(batch.position_y.data() + offset);
+    __m256 p_z = _mm256_loadu_ps(batch.position_z.data() + offset);
+
+    __m256 q_x = _mm256_loadu_ps(batch.rotation_x.data() + offset);
+    __m256 q_y = _mm256_loadu_ps(batch.rotation_y.data() + offset);
+    __m256 q_z = _mm256_loadu_ps(batch.rotation_z.data() + offset);
+    __m256 q_w = _mm256_loadu_ps(batch.rotation_w.data() + offset);
+
+    __m256 s_x = _mm256_loadu_ps(batch.scale_x.data() + offset);
+    __m256 s_y = _mm256_loadu_ps(batch.scale_y.data() + offset);
+    __m256 s_z = _mm256_loadu_ps(batch.scale_z.data() + offset);
+
+    // quaternion -> rotation matrix, the same as glm::mat3_cast()
+    __m256 x2 = _mm256_add_ps(q_x, q_x);
+    __m256 y2 = _mm256_add_ps(q_y, q_y);
+    __m256 z2 = _mm256_add_ps(q_z, q_z);
+
+    __m256 xx = _mm256_mul_ps(q_x, x2);
+    __m256 yy = _mm256_mul_ps(q_y, y2);
+    __m256 zz = _mm256_mul_ps(q_z, z2);
+    __m256 xy = _mm256_mul_ps(q_x, y2);
+    __m256 xz = _mm256_mul_ps(q_x, z2);
+    __m256 yz = _mm256_mul_ps(q_y, z2);
+    __m256 wx = _mm256_mul_ps(q_w, x2);
+    __m256 wy = _mm256_mul_ps(q_w, y2);
+    __m256 wz = _mm256_mul_ps(q_w, z2);
+
+    // r_ij - column i, row j
+    __m256 r_00 = _mm256_sub_ps(one, _mm256_add_ps(yy, zz));
+    __m256 r_01 = _mm256_add_ps(xy, wz);
+    __m256 r_02 = _mm256_sub_ps(xz, wy);
+
+    __m256 r_10 = _mm256_sub_ps(xy, wz);
+    __m256 r_11 = _mm256_sub_ps(one, _mm256_add_ps(xx, zz));
+    __m256 r_12 = _mm256_add_ps(yz, wx);
+
+    __m256 r_20 = _mm256_add_ps(xz, wy);
+    __m256 r_21 = _mm256_sub_ps(yz, wx);
+    __m256 r_22 = _mm256_sub_ps(one, _mm256_add_ps(xx, yy));
+
+    alignas(32) float columns[MATRIX_FLOATS][8];
+
+    // world = T * R * S
+    _mm256_store_ps(columns[0], _mm256_mul_ps(r_00, s_x));
+    _mm256_store_ps(columns[1], _mm256_mul_ps(r_01, s_x));
+    _mm256_store_ps(columns[2], _mm256_mul_ps(r_02, s_x));
+    _mm256_store_ps(columns[3], _mm256_mul_ps(r_10, s_y));
+    _mm256_store_ps(columns[4], _mm256_mul_ps(r_11, s_y));
+    _mm256_store_ps(columns[5], _mm256_mul_ps(r_12, s_y));
+    _mm256_store_ps(columns[6], _mm256_mul_ps(r_20, s_z));
+    _mm256_store_ps(columns[7], _mm256_mul_ps(r_21, s_z));
+    _mm256_store_ps(columns[8], _mm256_mul_ps(r_22, s_z));
+    _mm256_store_ps(columns[9], p_x);
+    _mm256_store_ps(columns[10], p_y);
+    _mm256_store_ps(columns[11], p_z);
+
+    storeMatrices(columns, 8, world + offset);
+
+    // world_inv = S^-1 * R^T * T^-1
+    __m256 s_inv_x = _mm256_div_ps(one, s_x);
+    __m256 s_inv_y = _mm256_div_ps(one, s_y);
+    __m256 s_inv_z = _mm256_div_ps(one, s_z);
+
+    __m256 inv_00 = _mm256_mul_ps(r_00, s_inv_x);
+    __m256 inv_01 = _mm256_mul_ps(r_10, s_inv_y);
+    __m256 inv_02 = _mm256_mul_ps(r_20, s_inv_z);
+
+    __m256 inv_10 = _mm256_mul_ps(r_01, s_inv_x);
+    __m256 inv_11 = _mm256_mul_ps(r_11, s_inv_y);
+    __m256 inv_12 = _mm256_mul_ps(r_21, s_inv_z);
+
+    __m256 inv_20 = _mm256_mul_ps(r_02, s_inv_x);
+    __m256 inv_21 = _mm256_mul_ps(r_12, s_inv_y);
+    __m256 inv_22 = _mm256_mul_ps(r_22, s_inv_z);
+
+    __m256 t_x = _mm256_fmadd_ps(inv_20, p_z, _mm256_fmadd_ps(inv_10, p_y, _mm256_mul_ps(inv_00, p_x)));
+    __m256 t_y = _mm256_fmadd_ps(inv_21, p_z, _mm256_fmadd_ps(inv_11, p_y, _mm256_mul_ps(inv_01, p_x)));
+    __m256 t_z = _mm256_fmadd_ps(inv_22, p_z, _mm256_fmadd_ps(inv_12, p_y, _mm256_mul_ps(inv_02, p_x)));
+
+    _mm256_store_ps(columns[0], inv_00);
+    _mm256_store_ps(columns[1], inv_01);
+    _mm256_store_ps(columns[2], inv_02);
+    _mm256_store_ps(columns[3], inv_10);
+    _mm256_store_ps(columns[4], inv_11);
+    _mm256_store_ps(columns[5], inv_12);
+    _mm256_store_ps(columns[6], inv_20);
+    _mm256_store_ps(columns[7], inv_21);
+    _mm256_store_ps(columns[8], inv_22);
+    _mm256_store_ps(columns[9], _mm256_sub_ps(zero, t_x));
+    _mm256_store_ps(columns[10], _mm256_sub_ps(zero, t_y));
+    _mm256_store_ps(columns[11], _mm256_sub_ps(zero, t_z));
+
+    storeMatrices(columns, 8, world_inv + offset);
+}
+} // namespace
+
+namespace math
+{
+void TransformBatch::clear()
+{
+    position_x.clear();
+    position_y.clear();
+    position_z.clear();
+
+    rotation_x.clear();
+    rotation_y.clear();
+    rotation_z.clear();
+    rotation_w.clear();
+
+    scale_x.clear();
+    scale_y.clear();
+    scale_z.clear();
+}
+
+void TransformBatch::push_back(const Transform & transform)
+{
+    position_x.push_back(transform.position.x);
+    position_y.push_back(transform.position.y);
+    position_z.push_back(transform.position.z);
+
+    rotation_x.push_back(transform.rotation.x);
+    rotation_y.push_back(transform.rotation.y);
+    rotation_z.push_back(transform.rotation.z);
+    rotation_w.push_back(transform.rotation.w);
+
+    scale_x.push_back(transform.scale.x);
+    scale_y.push_back(transform.scale.y);
+    scale_z.push_back(transform.scale.z);
+}
+
+void computeAffineMatrices(const TransformBatch & batch,
+                           glm::mat4x3 * world,
+                           glm::mat4x3 * world_inv,
+                           SIMDLevel level)
+{
+    uint32_t size = batch.size();
+    uint32_t i = 0;
+
+    switch (level)
+    {
+    case SIMDLevel::AVX2:
+        for (; i + 8 <= size; i += 8)
+            computeAVX2(batch, i, world, world_inv);
+        break;
+    case SIMDLevel::SSE:
+        for (; i + 4 <= size; i += 4)
+            computeSSE(batch, i, world, world_inv);
+        break;
+    default:
+        break;
+    }
+
+    // the tail which doesn't fill a whole register
+    computeScalar(batch, i, size, world, world_inv);
+}
+} // namespace math
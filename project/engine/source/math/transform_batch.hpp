@@ -0,0 +1,42 @@
+#ifndef TRANSFORM_BATCH_HPP
+#define TRANSFORM_BATCH_HPP
+
+#include "glm.hpp"
+#include <vector>
+
+#include "matrices.hpp"
+#include "simd.hpp"
+
+namespace math
+{
+// transforms transposed to SoA, so SIMD kernels load 4/8 of them at once
+struct TransformBatch
+{
+    void clear();
+    void push_back(const Transform & transform);
+
+    uint32_t size() const { return uint32_t(position_x.size()); }
+
+    std::vector<float> position_x;
+    std::vector<float> position_y;
+    std::vector<float> position_z;
+
+    std::vector<float> rotation_x;
+    std::vector<float> rotation_y;
+    std::vector<float> rotation_z;
+    std::vector<float> rotation_w;
+
+    std::vector<float> scale_x;
+    std::vector<float> scale_y;
+    std::vector<float> scale_z;
+};
+
+// the same result as Transform::toMat4x3() and Transform::toInvMat4x3(),
+// world and world_inv must have batch.size() elements
+void computeAffineMatrices(const TransformBatch & batch,
+                           glm::mat4x3 * world,
+                           glm::mat4x3 * world_inv,
+                           SIMDLevel level = getSIMDLevel());
+} // namespace math
+
+#endif
@@ -0,0 +1,448 @@
+#include "triangle_bvh.hpp"
+
+namespace
+{
+// enough for any tree of buildBVH()
+constexpr uint32_t TRAVERSAL_STACK_SIZE = math::BVH_MAX_DEPTH + 1;
+
+using TriangleBlock = math::TriangleBVH::TriangleBlock;
+
+const glm::vec3 & getPos(const math::Mesh & mesh,
+                         uint32_t triangle_index,
+                         uint32_t vertex_index)
+{
+    uint32_t index = mesh.triangles.empty() ?
+        triangle_index * 3 + vertex_index :
+        mesh.triangles[triangle_index].indices[vertex_index];
+
+    return mesh.vertices[index].position;
+}
+
+// ---------------------------- ray vs triangle block ----------------------------
+// every function writes t of the hit for each triangle of the block,
+// or infinity if the triangle was missed or is further than t_max
+
+void intersectBlockScalar(const math::Ray & ray,
+                          const TriangleBlock & block,
+                          float t_max,
+                          float * t)
+{
+    for (uint32_t i = 0; i != math::TriangleBVH::BLOCK_SIZE; ++i)
+    {
+        glm::vec3 V1(block.v1_x[i], block.v1_y[i], block.v1_z[i]);
+        glm::vec3 edge_1(block.edge_1_x[i], block.edge_1_y[i], block.edge_1_z[i]);
+        glm::vec3 edge_2(block.edge_2_x[i], block.edge_2_y[i], block.edge_2_z[i]);
+
+        math::MeshIntersection hit;
+        hit.reset(0.0f, t_max);
+
+        t[i] = ray.intersect(hit, V1, V1 + edge_1, V1 + edge_2) ?
+            hit.t : std::numeric_limits<float>::infinity();
+    }
+}
+
+// Moller-Trumbore for 4 triangles starting from the offset
+void intersectBlockSSE(const math::Ray & ray,
+                       const TriangleBlock & block,
+                       uint32_t offset,
+                       float t_max,
+                       float * t)
+{
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    __m128 dir_x = _mm_set1_ps(ray.direction.x);
+    __m128 dir_y = _mm_set1_ps(ray.direction.y);
+    __m128 dir_z = _mm_set1_ps(ray.direction.z);
+
+    __m128 edge_1_x = _mm_load_ps(block.edge_1_x + offset);
+    __m128 edge_1_y = _mm_load_ps(block.edge_1_y + offset);
+    __m128 edge_1_z = _mm_load_ps(block.edge_1_z + offset);
+
+    __m128 edge_2_x = _mm_load_ps(block.edge_2_x + offset);
+    __m128 edge_2_y = _mm_load_ps(block.edge_2_y + offset);
+    __m128 edge_2_z = _mm_load_ps(block.edge_2_z + offset);
+
+    // vec_1 = cross(direction, edge_2)
+    __m128 vec_1_x = _mm_sub_ps(_mm_mul_ps(dir_y, edge_2_z), _mm_mul_ps(dir_z, edge_2_y));
+    __m128 vec_1_y = _mm_sub_ps(_mm_mul_ps(dir_z, edge_2_x), _mm_mul_ps(dir_x, edge_2_z));
+    __m128 vec_1_z = _mm_sub_ps(_mm_mul_ps(dir_x, edge_2_y), _mm_mul_ps(dir_y, edge_2_x));
+
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge_1_x, vec_1_x),
+                                       _mm_mul_ps(edge_1_y, vec_1_y)),
+                            _mm_mul_ps(edge_1_z, vec_1_z));
+
+    // ray || triangle
+    __m128 mask = _mm_cmpge_ps(_mm_andnot_ps(sign_mask, det),
+                               _mm_set1_ps(math::SOME_SMALL_NUMBER));
+
+    __m128 det_inv = _mm_div_ps(one, det);
+
+    // vec_2 = origin - V1
+    __m128 vec_2_x = _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_load_ps(block.v1_x + offset));
+    __m128 vec_2_y = _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_load_ps(block.v1_y + offset));
+    __m128 vec_2_z = _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_load_ps(block.v1_z + offset));
+
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vec_2_x, vec_1_x),
+                                                _mm_mul_ps(vec_2_y, vec_1_y)),
+                                     _mm_mul_ps(vec_2_z, vec_1_z)),
+                          det_inv);
+
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(u, one));
+
+    // vec_3 = cross(vec_2, edge_1)
+    __m128 vec_3_x = _mm_sub_ps(_mm_mul_ps(vec_2_y, edge_1_z), _mm_mul_ps(vec_2_z, edge_1_y));
+    __m128 vec_3_y = _mm_sub_ps(_mm_mul_ps(vec_2_z, edge_1_x), _mm_mul_ps(vec_2_x, edge_1_z));
+    __m128 vec_3_z = _mm_sub_ps(_mm_mul_ps(vec_2_x, edge_1_y), _mm_mul_ps(vec_2_y, edge_1_x));
+
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dir_x, vec_3_x),
+                                                _mm_mul_ps(dir_y, vec_3_y)),
+                                     _mm_mul_ps(dir_z, vec_3_z)),
+                          det_inv);
+
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+
+    __m128 t_hit = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge_2_x, vec_3_x),
+                                                    _mm_mul_ps(edge_2_y, vec_3_y)),
+                                         _mm_mul_ps(edge_2_z, vec_3_z)),
+                              det_inv);
+
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(t_hit, zero));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(t_hit, _mm_set1_ps(t_max)));
+
+    __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    _mm_storeu_ps(t, _mm_or_ps(_mm_and_ps(mask, t_hit), _mm_andnot_ps(mask, inf)));
+}
+
+MATH_TARGET_AVX2
+inline __m256 dot8(__m256 a_x, __m256 a_y, __m256 a_z,
+                   __m256 b_x, __m256 b_y, __m256 b_z)
+{
+    return _mm256_fmadd_ps(a_z, b_z, _mm256_fmadd_ps(a_y, b_y, _mm256_mul_ps(a_x, b_x)));
+}
+
+MATH_TARGET_AVX2
+void intersectBlockAVX2(const math::Ray & ray,
+                        const TriangleBlock & block,
+                        float t_max,
+                        float * t)
+{
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    __m256 dir_x = _mm256_set1_ps(ray.direction.x);
+    __m256 dir_y = _mm256_set1_ps(ray.direction.y);
+    __m256 dir_z = _mm256_set1_ps(ray.direction.z);
+
+    __m256 edge_1_x = _mm256_load_ps(block.edge_1_x);
+    __m256 edge_1_y = _mm256_load_ps(block.edge_1_y);
+    __m256 edge_1_z = _mm256_load_ps(block.edge_1_z);
+
+    __m256 edge_2_x = _mm256_load_ps(block.edge_2_x);
+    __m256 edge_2_y = _mm256_load_ps(block.edge_2_y);
+    __m256 edge_2_z = _mm256_load_ps(block.edge_2_z);
+
+    // vec_1 = cross(direction, edge_2)
+    __m256 vec_1_x = _mm256_fmsub_ps(dir_y, edge_2_z, _mm256_mul_ps(dir_z, edge_2_y));
+    __m256 vec_1_y = _mm256_fmsub_ps(dir_z, edge_2_x, _mm256_mul_ps(dir_x, edge_2_z));
+    __m256 vec_1_z = _mm256_fmsub_ps(dir_x, edge_2_y, _mm256_mul_ps(dir_y, edge_2_x));
+
+    __m256 det = dot8(edge_1_x, edge_1_y, edge_1_z, vec_1_x, vec_1_y, vec_1_z);
+
+    // ray || triangle
+    __m256 mask = _mm256_cmp_ps(_mm256_andnot_ps(sign_mask, det),
+                                _mm256_set1_ps(math::SOME_SMALL_NUMBER),
+                                _CMP_GE_OQ);
+
+    __m256 det_inv = _mm256_div_ps(one, det);
+
+    // vec_2 = origin - V1
+    __m256 vec_2_x = _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_load_ps(block.v1_x));
+    __m256 vec_2_y = _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_load_ps(block.v1_y));
+    __m256 vec_2_z = _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_load_ps(block.v1_z));
+
+    __m256 u = _mm256_mul_ps(dot8(vec_2_x, vec_2_y, vec_2_z, vec_1_x, vec_1_y, vec_1_z),
+                             det_inv);
+
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, one, _CMP_LE_OQ));
+
+    // vec_3 = cross(vec_2, edge_1)
+    __m256 vec_3_x = _mm256_fmsub_ps(vec_2_y, edge_1_z, _mm256_mul_ps(vec_2_z, edge_1_y));
+    __m256 vec_3_y = _mm256_fmsub_ps(vec_2_z, edge_1_x, _mm256_mul_ps(vec_2_x, edge_1_z));
+    __m256 vec_3_z = _mm256_fmsub_ps(vec_2_x, edge_1_y, _mm256_mul_ps(vec_2_y, edge_1_x));
+
+    __m256 v = _mm256_mul_ps(dot8(dir_x, dir_y, dir_z, vec_3_x, vec_3_y, vec_3_z),
+                             det_inv);
+
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+
+    __m256 t_hit = _mm256_mul_ps(dot8(edge_2_x, edge_2_y, edge_2_z, vec_3_x, vec_3_y, vec_3_z),
+                                 det_inv);
+
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(t_hit, zero, _CMP_GE_OQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(t_hit, _mm256_set1_ps(t_max), _CMP_LT_OQ));
+
+    __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    _mm256_storeu_ps(t, _mm256_blendv_ps(inf, t_hit, mask));
+}
+} // namespace
+
+namespace math
+{
+const uint32_t TriangleBVH::MAX_LEAF_TRIANGLES = TriangleBVH::BLOCK_SIZE;
+
+void TriangleBVH::clear()
+{
+    mesh = nullptr;
+
+    nodes.clear();
+    blocks.clear();
+    triangle_ids.clear();
+}
+
+void TriangleBVH::initialize(std::shared_ptr<Mesh> mesh)
+{
+    clear();
+
+    this->mesh = mesh;
+
+    uint32_t triangles_count = mesh->triangles.empty() ?
+        uint32_t(mesh->vertices.size() / 3) :
+        uint32_t(mesh->triangles.size());
+
+    std::vector<BoundingBox> boxes(triangles_count);
+    std::vector<glm::vec3> centers(triangles_count);
+
+    for (uint32_t i = 0; i != triangles_count; ++i)
+    {
+        const glm::vec3 & V1 = getPos(*mesh, i, 0);
+        const glm::vec3 & V2 = getPos(*mesh, i, 1);
+        const glm::vec3 & V3 = getPos(*mesh, i, 2);
+
+        boxes[i] = BoundingBox::empty();
+        boxes[i].expand(V1);
+        boxes[i].expand(V2);
+        boxes[i].expand(V3);
+
+        centers[i] = (V1 + V2 + V3) / 3.0f;
+    }
+
+    std::vector<uint32_t> indices;
+    buildBVH(boxes, centers, MAX_LEAF_TRIANGLES, nodes, indices);
+
+    // pack leaf triangles into blocks in leaf order
+    for (auto & node : nodes)
+    {
+        if (!node.isLeaf()) continue;
+
+        uint32_t first = node.left_first;
+        node.left_first = uint32_t(blocks.size());
+
+        for (uint32_t i = 0; i != node.count; ++i)
+        {
+            if (i % BLOCK_SIZE == 0)
+            {
+                blocks.push_back(TriangleBlock()); // zero initialized
+                triangle_ids.resize(triangle_ids.size() + BLOCK_SIZE, 0);
+            }
+
+            TriangleBlock & block = blocks.back();
+            uint32_t lane = i % BLOCK_SIZE;
+            uint32_t triangle = indices[first + i];
+
+            const glm::vec3 & V1 = getPos(*mesh, triangle, 0);
+            glm::vec3 edge_1 = getPos(*mesh, triangle, 1) - V1;
+            glm::vec3 edge_2 = getPos(*mesh, triangle, 2) - V1;
+
+            block.v1_x[lane] = V1.x;
+            block.v1_y[lane] = V1.y;
+            block.v1_z[lane] = V1.z;
+
+            block.edge_1_x[lane] = edge_1.x;
+            block.edge_1_y[lane] = edge_1.y;
+            block.edge_1_z[lane] = edge_1.z;
+
+            block.edge_2_x[lane] = edge_2.x;
+            block.edge_2_y[lane] = edge_2.y;
+            block.edge_2_z[lane] = edge_2.z;
+
+            triangle_ids[(blocks.size() - 1) * BLOCK_SIZE + lane] = triangle;
+        }
+    }
+}
+
+bool TriangleBVH::intersectLeaf(const Ray & ray,
+                                const BVHNode & leaf,
+                                MeshIntersection & nearest) const
+{
+    SIMDLevel level = getSIMDLevel();
+
+    bool found = false;
+
+    uint32_t blocks_count = (leaf.count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    for (uint32_t b = leaf.left_first; b != leaf.left_first + blocks_count; ++b)
+    {
+        float t[BLOCK_SIZE];
+
+        switch (level)
+        {
+        case SIMDLevel::AVX2:
+            intersectBlockAVX2(ray, blocks[b], nearest.t, t);
+            break;
+        case SIMDLevel::SSE:
+            intersectBlockSSE(ray, blocks[b], 0, nearest.t, t);
+            intersectBlockSSE(ray, blocks[b], 4, nearest.t, t + 4);
+            break;
+        default:
+            intersectBlockScalar(ray, blocks[b], nearest.t, t);
+        }
+
+        for (uint32_t i = 0; i != BLOCK_SIZE; ++i)
+        {
+            if (t[i] >= nearest.t) continue;
+
+            nearest.t = t[i];
+            nearest.pos = ray.origin + t[i] * ray.direction;
+            nearest.triangle = triangle_ids[b * BLOCK_SIZE + i];
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+bool TriangleBVH::intersect(const Ray & ray,
+                            MeshIntersection & nearest) const
+{
+    if (nodes.empty()) return false;
+
+    glm::vec3 direction_inv = 1.0f / ray.direction;
+
+    if (!std::isfinite(intersectNode(ray.origin, direction_inv, nodes[0], nearest.t)))
+        return false;
+
+    bool found = false;
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size != 0)
+    {
+        const BVHNode & node = nodes[stack[--stack_size]];
+
+        if (node.isLeaf())
+        {
+            if (intersectLeaf(ray, node, nearest)) found = true;
+            continue;
+        }
+
+        uint32_t near_index = node.left_first;
+        uint32_t far_index = node.left_first + 1;
+
+        float t_near = intersectNode(ray.origin, direction_inv, nodes[near_index], nearest.t);
+        float t_far = intersectNode(ray.origin, direction_inv, nodes[far_index], nearest.t);
+
+        if (t_far < t_near)
+        {
+            std::swap(near_index, far_index);
+            std::swap(t_near, t_far);
+        }
+
+        // push the far child first, so the near one is visited next
+        if (std::isfinite(t_far))
+        {
+            assert(stack_size < TRAVERSAL_STACK_SIZE);
+            stack[stack_size++] = far_index;
+        }
+        if (std::isfinite(t_near))
+        {
+            assert(stack_size < TRAVERSAL_STACK_SIZE);
+            stack[stack_size++] = near_index;
+        }
+    }
+
+    return found;
+}
+
+uint32_t TriangleBVH::intersect(const RayPacket & packet,
+                                MeshIntersection * nearest) const
+{
+    if (nodes.empty() || packet.empty()) return 0;
+
+    SIMDLevel level = getSIMDLevel();
+
+    // unused lanes can't hit anything
+    alignas(32) float t_max[RayPacket::SIZE];
+    for (uint32_t i = 0; i != RayPacket::SIZE; ++i)
+    {
+        t_max[i] = (packet.mask & (1u << i)) ?
+            nearest[i].t : -std::numeric_limits<float>::infinity();
+    }
+
+    float t_nearest;
+    if (!intersectNode(packet, t_max, nodes[0], t_nearest, level)) return 0;
+
+    uint32_t found = 0;
+
+    // the whole packet goes down the tree while at least one ray hits the node
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size != 0)
+    {
+        const BVHNode & node = nodes[stack[--stack_size]];
+
+        if (node.isLeaf())
+        {
+            float t_node;
+            uint32_t mask = intersectNode(packet, t_max, node, t_node, level);
+
+            for (uint32_t i = 0; i != RayPacket::SIZE; ++i)
+            {
+                if (!(mask & (1u << i))) continue;
+
+                if (intersectLeaf(packet.get(i), node, nearest[i]))
+                {
+                    t_max[i] = nearest[i].t;
+                    found |= 1u << i;
+                }
+            }
+            continue;
+        }
+
+        uint32_t near_index = node.left_first;
+        uint32_t far_index = node.left_first + 1;
+
+        float t_near, t_far;
+        uint32_t near_mask = intersectNode(packet, t_max, nodes[near_index], t_near, level);
+        uint32_t far_mask = intersectNode(packet, t_max, nodes[far_index], t_far, level);
+
+        if (t_far < t_near)
+        {
+            std::swap(near_index, far_index);
+            std::swap(near_mask, far_mask);
+        }
+
+        if (far_mask)
+        {
+            assert(stack_size < TRAVERSAL_STACK_SIZE);
+            stack[stack_size++] = far_index;
+        }
+        if (near_mask)
+        {
+            assert(stack_size < TRAVERSAL_STACK_SIZE);
+            stack[stack_size++] = near_index;
+        }
+    }
+
+    return found;
+}
+} // namespace math
@@ -0,0 +1,72 @@
+#ifndef TRIANGLE_BVH_HPP
+#define TRIANGLE_BVH_HPP
+
+#include "glm.hpp"
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <array>
+#include <memory>
+
+#include "box.hpp"
+#include "ray.hpp"
+#include "bvh.hpp"
+#include "simd.hpp"
+#include "triangle_octree.hpp"
+#include "mesh_intersection.hpp"
+
+namespace math
+{
+// Flat BVH over mesh triangles built with SAH.
+// Leaf triangles are stored in SoA blocks, so one ray is tested
+// against a whole block per instruction, see getSIMDLevel().
+class TriangleBVH
+{
+public:
+    static constexpr uint32_t BLOCK_SIZE = 8;
+    const static uint32_t MAX_LEAF_TRIANGLES;
+
+    void clear();
+    bool inited() const { return mesh != nullptr; }
+
+    void initialize(std::shared_ptr<Mesh> mesh);
+
+    bool intersect(const Ray & ray,
+                   MeshIntersection & nearest) const;
+
+    // nearest[i] is used for lane i of the packet,
+    // returns mask of lanes which found a nearer intersection
+    uint32_t intersect(const RayPacket & packet,
+                       MeshIntersection * nearest) const;
+
+    // unused lanes are degenerate triangles, so they are never hit
+    struct alignas(32) TriangleBlock
+    {
+        float v1_x[BLOCK_SIZE];
+        float v1_y[BLOCK_SIZE];
+        float v1_z[BLOCK_SIZE];
+
+        float edge_1_x[BLOCK_SIZE];
+        float edge_1_y[BLOCK_SIZE];
+        float edge_1_z[BLOCK_SIZE];
+
+        float edge_2_x[BLOCK_SIZE];
+        float edge_2_y[BLOCK_SIZE];
+        float edge_2_z[BLOCK_SIZE];
+    };
+
+protected:
+    bool intersectLeaf(const Ray & ray,
+                       const BVHNode & leaf,
+                       MeshIntersection & nearest) const;
+
+    std::shared_ptr<Mesh> mesh = nullptr;
+
+    // leaf: left_first - index of the first block, count - triangles in the leaf
+    std::vector<BVHNode> nodes;
+    std::vector<TriangleBlock> blocks;
+    std::vector<uint32_t> triangle_ids; // BLOCK_SIZE per block, index in Mesh::triangles
+};
+} // namespace math
+
+#endif
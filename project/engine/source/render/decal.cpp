@@ -4,7 +4,6 @@ namespace engine
 {
 Decal::Decal(uint32_t model_id,
              uint32_t transform_id,
-             const glm::vec3 & posMS,
              const glm::vec2 & size,
              float angle,
              const glm::vec3 & albedo,
@@ -13,7 +12,6 @@ Decal::Decal(uint32_t model_id,
              const glm::vec3 & up) :
              model_id(model_id),
              transform_id(transform_id),
-             posMS(posMS),
              size(size),
              angle(angle),
              albedo(albedo),
@@ -3,6 +3,8 @@
 
 #include "glm.hpp"
 
+#include "expiry_system.hpp"
+
 namespace engine
 {
 class Decal
@@ -10,7 +12,6 @@ class Decal
 public:
     Decal(uint32_t model_id,
           uint32_t transform_id,
-          const glm::vec3 & posMS,
           const glm::vec2 & size,
           float angle,
           const glm::vec3 & albedo,
@@ -20,9 +21,9 @@ public:
 
     uint32_t model_id;
 
+    // child of the decorated instance transform
     uint32_t transform_id;
     
-    glm::vec3 posMS;
     glm::vec2 size;
     float angle;
     
@@ -31,6 +32,10 @@ public:
     glm::vec3 forward;
     glm::vec3 right;
     glm::vec3 up;
+
+    // cancelled when the decal is removed earlier,
+    // so the callback can't remove another decal which reuses the id
+    ExpirySystem::ID expiry_id = ExpirySystem::INVALID_ID;
 };
 } // namespace engine
 
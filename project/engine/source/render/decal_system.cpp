@@ -5,6 +5,19 @@
 namespace
 {
 constexpr glm::vec2 DECAL_INIT_SIZE(2.0f);
+
+// the basis of a decal is orthonormal and has no scale,
+// so the inverse is the transposed rotation and the rotated back translation
+glm::mat4 invertRigid(const glm::mat4 & transform)
+{
+    glm::mat3 rotation_inv = glm::transpose(glm::mat3(transform));
+    glm::vec3 position_inv = -(rotation_inv * glm::vec3(transform[3]));
+
+    return glm::mat4(glm::vec4(rotation_inv[0], 0.0f),
+                     glm::vec4(rotation_inv[1], 0.0f),
+                     glm::vec4(rotation_inv[2], 0.0f),
+                     glm::vec4(position_inv, 1.0f));
+}
 } // namespace
 
 namespace engine
@@ -32,26 +45,60 @@ void DecalSystem::del()
     else spdlog::error("DecalsSystem::del() was called twice!");
 }
 
-void DecalSystem::addDecal(uint32_t model_id,
-                           uint32_t transform_id,
-                           const glm::vec3 & posMS,
-                           const glm::vec3 & forward,
-                           const glm::vec3 & right,
-                           const glm::vec3 & up)
+uint32_t DecalSystem::addDecal(uint32_t model_id,
+                               uint32_t transform_id,
+                               const glm::vec3 & posMS,
+                               const glm::vec3 & forward,
+                               const glm::vec3 & right,
+                               const glm::vec3 & up,
+                               float lifetime)
 {
-    glm::vec3 albedo(math::randomFromRange(0.0f, 1.0f),
-                     math::randomFromRange(0.0f, 1.0f),
-                     math::randomFromRange(0.0f, 1.0f));
+    math::Random & random = math::getThreadRandom();
+
+    glm::vec3 albedo = random.range(glm::vec3(0.0f), glm::vec3(1.0f));
+
+    // the decal moves with the instance, but keeps its world orientation
+    uint32_t decal_transform_id = TransformSystem::getInstance()->
+        insert(math::Transform(posMS,
+                               math::EulerAngles(0.0f, 0.0f, 0.0f),
+                               glm::vec3(1.0f)),
+               transform_id);
     
-    decals.push_back(Decal(model_id,
-                           transform_id,
-                           posMS,
-                           DECAL_INIT_SIZE,
-                           math::randomFromRange(0.0f, 2.0f * math::PI),
-                           albedo,
-                           forward,
-                           right,
-                           up));
+    uint32_t decal_id = decals.insert(Decal(model_id,
+                                            decal_transform_id,
+                                            DECAL_INIT_SIZE,
+                                            random.angle(),
+                                            albedo,
+                                            forward,
+                                            right,
+                                            up));
+
+    if (lifetime > 0.0f)
+    {
+        decals[decal_id].expiry_id = ExpirySystem::getInstance()->
+            schedule(TimeSystem::getTimePoint() + lifetime,
+                     [this, decal_id]()
+                     {
+                         removeDecal(decal_id);
+                     });
+    }
+
+    return decal_id;
+}
+
+void DecalSystem::removeDecal(uint32_t decal_id)
+{
+    if (!decals.occupied(decal_id)) return;
+
+    TransformSystem * trans_sys = TransformSystem::getInstance();
+    const Decal & decal = decals[decal_id];
+
+    // does nothing if the decal is removed by its own expiry
+    ExpirySystem::getInstance()->cancel(decal.expiry_id);
+
+    if (trans_sys->isValid(decal.transform_id)) trans_sys->erase(decal.transform_id);
+
+    decals.erase(decal_id);
 }
 
 void DecalSystem::updateInstanceBuffer()
@@ -62,14 +109,16 @@ void DecalSystem::updateInstanceBuffer()
     D3D11_MAPPED_SUBRESOURCE mapped = instance_buffer.map();
     GPUInstance * dst = static_cast<GPUInstance *>(mapped.pData);
 
-    uint32_t copied_count = 0;
-    for (auto & decal : decals)
+    TransformSystem * trans_sys = TransformSystem::getInstance();
+
+    // a decal whose transform was already erased isn't drawn
+    instances_count = 0;
+    decals.forEach([&](uint32_t, const Decal & decal)
     {
-        TransformSystem * trans_sys = TransformSystem::getInstance();
-        auto & transform = trans_sys->transforms[decal.transform_id];
-        
-        glm::vec4 pos_h = transform.toMat4() * glm::vec4(decal.posMS, 1.0f);
-        glm::vec3 position = glm::vec3(pos_h) / pos_h.w;
+        const glm::mat4x3 * world = trans_sys->findWorld(decal.transform_id);
+        if (!world) return;
+
+        glm::vec3 position = (*world)[3];
         
         glm::mat4x4 model_matrix(decal.right.x, decal.right.y, decal.right.z, 0.0f,
                                  decal.up.x, decal.up.y, decal.up.z, 0.0f,
@@ -78,13 +127,13 @@ void DecalSystem::updateInstanceBuffer()
 
         model_matrix = model_matrix * math::rotateZ(decal.angle);
         
-        dst[copied_count++] = GPUInstance(position,
-                                          decal.size,
-                                          decal.albedo,
-                                          model_matrix,
-                                          glm::inverse(model_matrix),
-                                          decal.model_id);
-    }
+        dst[instances_count++] = GPUInstance(position,
+                                             decal.size,
+                                             decal.albedo,
+                                             model_matrix,
+                                             invertRigid(model_matrix),
+                                             decal.model_id);
+    });
     
     instance_buffer.unmap();
 }
@@ -93,9 +142,10 @@ void DecalSystem::render(DxResPtr<ID3D11ShaderResourceView> depth_srv,
                          DxResPtr<ID3D11ShaderResourceView> normals_srv,
                          DxResPtr<ID3D11ShaderResourceView> model_id_srv)
 {
-    updateInstanceBuffer();
+    // the buffer keeps the old size after the last decal was removed
+    if (decals.size() == 0) return;
 
-    if (instance_buffer.get_size() == 0) return;
+    updateInstanceBuffer();
 
     Globals * globals = Globals::getInstance();
     
@@ -109,18 +159,12 @@ void DecalSystem::render(DxResPtr<ID3D11ShaderResourceView> depth_srv,
     instance_buffer.bind(1);
     
     normals->bind(0);
-    globals->device_context4->PSSetShaderResources(1,
-                                                   1,
-                                                   depth_srv.get());
-    globals->device_context4->PSSetShaderResources(2,
-                                                   1,
-                                                   normals_srv.get());
-    globals->device_context4->PSSetShaderResources(3,
-                                                   1,
-                                                   model_id_srv.get());
+    globals->bindPSShaderResources(1, 1, depth_srv.get());
+    globals->bindPSShaderResources(2, 1, normals_srv.get());
+    globals->bindPSShaderResources(3, 1, model_id_srv.get());
 
     globals->device_context4->DrawInstanced(36,
-                                            instance_buffer.get_size(),
+                                            instances_count,
                                             0,
                                             0);
 }
@@ -10,6 +10,10 @@
 #include "texture.hpp"
 #include "random.hpp"
 #include "matrices.hpp"
+#include "transform_system.hpp"
+#include "chunked_solid_vector.hpp"
+#include "expiry_system.hpp"
+#include "time_system.hpp"
 
 namespace engine
 {
@@ -26,12 +30,16 @@ public:
 
     static void del();
 
-    void addDecal(uint32_t model_id,
-                  uint32_t transform_id,
-                  const glm::vec3 & posMS,
-                  const glm::vec3 & forward,
-                  const glm::vec3 & right,
-                  const glm::vec3 & up);
+    // lifetime in seconds, 0 - the decal is never removed
+    uint32_t addDecal(uint32_t model_id,
+                      uint32_t transform_id,
+                      const glm::vec3 & posMS,
+                      const glm::vec3 & forward,
+                      const glm::vec3 & right,
+                      const glm::vec3 & up,
+                      float lifetime = 0.0f);
+
+    void removeDecal(uint32_t decal_id);
 
     void updateInstanceBuffer();
     void render(DxResPtr<ID3D11ShaderResourceView> depth_srv,
@@ -74,8 +82,10 @@ private:
     };
 
     VertexBuffer<GPUInstance> instance_buffer;
+    uint32_t instances_count = 0; // decals with a valid transform
 
-    std::vector<Decal> decals;
+    // decals are never moved, so a Decal & can be kept by the caller
+    math::ChunkedSolidVector<Decal> decals;
 };
 } // namespace engine
 
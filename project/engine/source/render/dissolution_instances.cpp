@@ -5,49 +5,43 @@ namespace engine
 void DissolutionInstances::updateInstanceBuffers()
 {
     TransformSystem * trans_system = TransformSystem::getInstance();
-    
-    uint32_t total_instances = 0;
-    
-    for (auto & per_model : per_model)
-        for (auto & per_mesh : per_model.per_mesh)
-            for (auto & per_material : per_mesh.per_material)
-                total_instances += uint32_t(per_material.instances.size());
-
-    if (total_instances == 0) return;
 
-    instance_buffer.init(total_instances);
-    D3D11_MAPPED_SUBRESOURCE mapped = instance_buffer.map();
-    GPUInstance * dst = static_cast<GPUInstance *>(mapped.pData);
-    
-    uint32_t copied_count = 0;
-    for (auto & per_model : per_model)
-    {
-        for (auto & per_mesh : per_model.per_mesh)
+    // repacks everything only if a bucket outgrew its range,
+    // otherwise just the added, moved and transformed instances
+    group.updateStaging(staging, [trans_system](const Instance & instance)
         {
-            for (auto & per_material : per_mesh.per_material)
-            {
-                uint32_t instances_size = per_material.instances.size();
-                for (uint32_t i = 0; i != instances_size; ++i)
-                {
-                    dst[copied_count++] = GPUInstance(
-                        trans_system->
-                            transforms[per_material.instances[i].transform_id].toMat4(),
-                        per_material.instances[i].spawn_time,
-                        per_material.instances[i].animation_time);
-                }
-            }
-        }
-    }
-
-    instance_buffer.unmap();
+            return GPUInstance(
+                glm::mat4(trans_system->getWorld(instance.transform_id)),
+                instance.spawn_time,
+                instance.animation_time);
+        });
+
+    instance_buffer.update(staging);
+    is_world_boxes_dirty = true;
+}
+
+void DissolutionInstances::updateWorldBoxes()
+{
+    if (group.isInstanceBufferDirty()) updateInstanceBuffers();
+    if (!is_world_boxes_dirty) return;
+
+    is_world_boxes_dirty = false;
+    group.computeWorldBoxes(staging, world_boxes);
 }
 
-void DissolutionInstances::render()
+void DissolutionInstances::addDrawPackets(DrawQueue & queue, uint32_t shader)
 {
+    updateWorldBoxes();
     if (instance_buffer.get_size() == 0) return;
 
+    group.addDrawPackets(queue, shader, world_boxes);
+}
+
+void DissolutionInstances::render(const DrawQueue & queue, uint32_t begin, uint32_t end)
+{
+    if (begin == end) return;
+
     Globals * globals = Globals::getInstance();
-    LightSystem * light_sys = LightSystem::getInstance();
 
     //globals->bindA2CBlendState();
     globals->bindDefaultBlendState();
@@ -60,112 +54,45 @@ void DissolutionInstances::render()
 
     dissolve->bind(13);
     noise->bind(14);
-    
-    uint32_t rendered_instances = 0;
-    
-    for (auto & per_model: per_model)
-    {
-        if (per_model.model == nullptr) continue;
-
-        // bind vertex and index buffers
-        per_model.model->bind();
 
-        uint32_t per_mesh_size = per_model.per_mesh.size();
-        for (uint32_t i = 0; i < per_mesh_size; ++i)
-        {
-            Model::MeshRange & mesh_range = per_model.model->getMeshRange(i);
-
-            for (auto & per_material : per_model.per_mesh[i].per_material)
-            {
-                if (per_material.instances.empty()) continue;
-
-                Material & material = per_material.material;
-
-                globals->bindRasterizer(material.is_double_sided);
-
-                globals->setPerMeshBuffer(mesh_range.mesh_to_model,
-                                          static_cast<bool>(material.albedo),
-                                          static_cast<bool>(material.roughness),
-                                          static_cast<bool>(material.metalness),
-                                          static_cast<bool>(material.normal),
-                                          material.is_directx_style_normal_map,
-                                          material.albedo_default,
-                                          material.roughness_default,
-                                          material.metalness_default);
-                globals->updatePerMeshBuffer();
-                
-                if (static_cast<bool>(material.albedo)) material.albedo->bind(0);
-                if (static_cast<bool>(material.roughness)) material.roughness->bind(1);
-                if (static_cast<bool>(material.metalness)) material.metalness->bind(2);
-                if (static_cast<bool>(material.normal)) material.normal->bind(3);
-                
-                uint32_t instances_count = uint32_t(per_material.instances.size());
-
-                globals->device_context4->DrawIndexedInstanced(mesh_range.index_count,
-                                                               instances_count,
-                                                               mesh_range.index_offset,
-                                                               mesh_range.vertex_offset,
-                                                               rendered_instances);
-                rendered_instances += instances_count;
-            }
-        }
-    }
+    group.renderPackets(queue, begin, end, [globals](Model::MeshRange & mesh_range,
+                                                     const Material & material,
+                                                     bool is_material_changed)
+    {
+        if (is_material_changed) globals->bindRasterizer(material.is_double_sided);
+
+        globals->setPerMeshBuffer(mesh_range.mesh_to_model,
+                                  static_cast<bool>(material.albedo),
+                                  static_cast<bool>(material.roughness),
+                                  static_cast<bool>(material.metalness),
+                                  static_cast<bool>(material.normal),
+                                  material.is_directx_style_normal_map,
+                                  material.albedo_default,
+                                  material.roughness_default,
+                                  material.metalness_default);
+        globals->updatePerMeshBuffer();
+
+        if (!is_material_changed) return;
+
+        if (static_cast<bool>(material.albedo)) material.albedo->bind(0);
+        if (static_cast<bool>(material.roughness)) material.roughness->bind(1);
+        if (static_cast<bool>(material.metalness)) material.metalness->bind(2);
+        if (static_cast<bool>(material.normal)) material.normal->bind(3);
+    });
 }
 
-void DissolutionInstances::renderWithoutMaterials(int cubemaps_count)
+void DissolutionInstances::updateShadowCasters(int cubemaps_count, ShadowCache & cache)
 {
-    if (instance_buffer.get_size() == 0) return;
-
-    Globals * globals = Globals::getInstance();
-
-    globals->bindA2CBlendState();
-    
-    globals->device_context4->
-        IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    updateWorldBoxes();
 
-    instance_buffer.bind(1);
-    
-    uint32_t rendered_instances = 0;
-    
-    for (auto & per_model: per_model)
-    {
-        if (per_model.model == nullptr) continue;
+    shadow_casters.updateGroup(group, staging, world_boxes, cubemaps_count, cache);
+}
 
-        // bind vertex and index buffers
-        per_model.model->bind();
+void DissolutionInstances::renderWithoutMaterials(const ShadowCache & cache)
+{
+    // alpha to coverage cuts the dissolved parts out of the shadow
+    Globals::getInstance()->bindA2CBlendState();
 
-        uint32_t per_mesh_size = per_model.per_mesh.size();
-        for (uint32_t i = 0; i < per_mesh_size; ++i)
-        {
-            Model::MeshRange & mesh_range = per_model.model->getMeshRange(i);
-
-            for (auto & per_material : per_model.per_mesh[i].per_material)
-            {
-                if (per_material.instances.empty()) continue;
-
-                Material & material = per_material.material;
-
-                globals->bindRasterizer(material.is_double_sided);
-
-                globals->setPerShadowMeshBuffer(mesh_range.mesh_to_model);
-                globals->updatePerShadowMeshBuffer();
-                
-                uint32_t instances_count = uint32_t(per_material.instances.size());
-
-                for (int cubemap_index = 0; cubemap_index != cubemaps_count; ++cubemap_index)
-                {
-                    globals->setPerShadowCubemapBuffer(cubemap_index);
-                    globals->updatePerShadowCubemapBuffer();
-                    
-                    globals->device_context4->DrawIndexedInstanced(mesh_range.index_count,
-                                                                   instances_count,
-                                                                   mesh_range.index_offset,
-                                                                   mesh_range.vertex_offset,
-                                                                   rendered_instances);
-                }                
-                rendered_instances += instances_count;
-            }
-        }
-    }
+    shadow_casters.renderGroup(group, cache, staging, caster_buffer);
 }
 } // namespace engine
@@ -10,6 +10,11 @@
 #include "vertex_buffer.hpp"
 #include "model.hpp"
 #include "transform_system.hpp"
+#include "instance_group.hpp"
+#include "instance_buffer.hpp"
+#include "frustum.hpp"
+#include "shadow_casters.hpp"
+#include "draw_queue.hpp"
 
 namespace engine
 {
@@ -86,39 +91,19 @@ public:
                  metalness_default(metalness_default)
         {}
         
-        bool operator==(const Material & other)
+        // default values are used only without textures
+        bool operator==(const Material & other) const
         {
-            if (static_cast<bool>(albedo))
-            {
-                if (albedo != other.albedo) return false;
-            }                
-            else
-            {
-                if (albedo_default != other.albedo_default) return false;
-            }
-            
-            if (static_cast<bool>(roughness))
-            {
-                if (roughness != other.roughness) return false;
-            }                
-            else
-            {
-                if (roughness_default != other.roughness_default) return false;
-            }
-            
-            if (static_cast<bool>(metalness))
-            {
-                if (metalness != other.metalness) return false;
-            }                
-            else
-            {
-                if (metalness_default != other.metalness_default) return false;
-            }
-            
-            if (static_cast<bool>(normal))
-            {
-                if (normal != other.normal) return false;
-            }
+            if (albedo != other.albedo) return false;
+            if (!albedo && albedo_default != other.albedo_default) return false;
+
+            if (roughness != other.roughness) return false;
+            if (!roughness && roughness_default != other.roughness_default) return false;
+
+            if (metalness != other.metalness) return false;
+            if (!metalness && metalness_default != other.metalness_default) return false;
+
+            if (normal != other.normal) return false;
 
             if (is_double_sided != other.is_double_sided) return false;
 
@@ -127,10 +112,35 @@ public:
             return true;
         }
 
-        bool operator!=(const Material & other)
+        bool operator!=(const Material & other) const
         {
             return !(*this == other);
         }
+
+        size_t hash() const
+        {
+            size_t seed = 0;
+
+            hashCombine(seed, albedo.get());
+            if (!albedo)
+            {
+                hashCombine(seed, albedo_default.x);
+                hashCombine(seed, albedo_default.y);
+                hashCombine(seed, albedo_default.z);
+            }
+
+            hashCombine(seed, roughness.get());
+            if (!roughness) hashCombine(seed, roughness_default);
+
+            hashCombine(seed, metalness.get());
+            if (!metalness) hashCombine(seed, metalness_default);
+
+            hashCombine(seed, normal.get());
+            hashCombine(seed, is_double_sided);
+            hashCombine(seed, is_directx_style_normal_map);
+
+            return seed;
+        }
         
         std::shared_ptr<Texture> albedo;
         std::shared_ptr<Texture> roughness;
@@ -145,30 +155,30 @@ public:
         bool is_directx_style_normal_map;
     };
 
-    struct PerMaterial
-    {
-        Material material;
-        std::vector<Instance> instances;
-    };
-
-    struct PerMesh
-    {
-        std::vector<PerMaterial> per_material;
-    };
-
-    struct PerModel
-    {
-        std::shared_ptr<Model> model;
-        std::vector<PerMesh> per_mesh;
-    };
-
+    // called by addDrawPackets() if the group was changed
     void updateInstanceBuffers();
-    
-    void render();
-    void renderWithoutMaterials(int cubemaps_count);
-
-    std::vector<PerModel> per_model;
-    VertexBuffer<GPUInstance> instance_buffer;
+    // world_boxes of the current instances, updates the instance buffers first
+    void updateWorldBoxes();
+
+    // adds a draw packet per bucket, instances aren't culled
+    void addDrawPackets(DrawQueue & queue, uint32_t shader);
+    // draws the sorted packets [begin, end) added by addDrawPackets()
+    void render(const DrawQueue & queue, uint32_t begin, uint32_t end);
+    // culls the shadow casters of each cubemap face and adds their signatures to the cache,
+    // shadows are rendered from all instances, not the camera-culled ones
+    void updateShadowCasters(int cubemaps_count, ShadowCache & cache);
+    // draws the casters into the faces invalidated in the cache
+    void renderWithoutMaterials(const ShadowCache & cache);
+
+    InstanceGroup<Material, Instance> group;
+    InstanceStaging<GPUInstance> staging;
+    InstanceBuffer<GPUInstance> instance_buffer;
+
+    // culled per light and cube face, see renderWithoutMaterials()
+    math::BoxBatch world_boxes; // the same order as staging
+    bool is_world_boxes_dirty = true;
+    ShadowCasters shadow_casters;
+    VertexBuffer<GPUInstance> caster_buffer;
 
     std::shared_ptr<Shader> shader;
     
@@ -0,0 +1,115 @@
+#include "draw_queue.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+constexpr uint32_t RADIX_BITS = 8;
+constexpr uint32_t RADIX = 1 << RADIX_BITS;
+constexpr uint32_t DIGITS_COUNT = 64 / RADIX_BITS;
+
+constexpr uint32_t DEPTH_BITS = 20;
+
+// bits of non-negative floats are ordered as the floats,
+// the 20 high bits keep the exponent and 11 bits of the mantissa
+uint64_t quantizeDepth(float depth)
+{
+    depth = std::max(depth, 0.0f);
+
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+
+    return bits >> (31 - DEPTH_BITS);
+}
+} // namespace
+
+namespace engine
+{
+uint64_t DrawQueue::makeOpaqueKey(uint32_t pass,
+                                  uint32_t shader,
+                                  uint32_t material_id,
+                                  uint32_t mesh_id,
+                                  float depth)
+{
+    assert(pass < 16 && shader < 16 && material_id < 65536 && "key overflow");
+
+    return uint64_t(pass) << 60 |
+           uint64_t(shader) << 56 |
+           uint64_t(getDepthLayer(depth)) << 52 |
+           uint64_t(material_id) << 36 |
+           uint64_t(mesh_id) << 20 |
+           quantizeDepth(depth);
+}
+
+float DrawQueue::getQuantizedDepth(uint64_t key)
+{
+    uint32_t bits = uint32_t(key & ((1u << DEPTH_BITS) - 1)) << (31 - DEPTH_BITS);
+
+    float depth;
+    std::memcpy(&depth, &bits, sizeof(depth));
+
+    return depth;
+}
+
+uint32_t DrawQueue::getDepthLayer(float depth)
+{
+    uint32_t layer = 0;
+    for (float layer_end = FIRST_DEPTH_LAYER;
+         layer != DEPTH_LAYERS_COUNT - 1 && depth >= layer_end;
+         layer_end *= 2.0f) ++layer;
+
+    return layer;
+}
+
+void DrawQueue::clear(const glm::vec3 & view_pos, const glm::vec3 & view_dir)
+{
+    this->view_pos = view_pos;
+    this->view_dir = view_dir;
+
+    packets.clear();
+    entries.clear();
+}
+
+void DrawQueue::sort()
+{
+    uint32_t size = entries.size();
+    if (size < 2) return;
+
+    // histograms of all the digits in one pass
+    uint32_t counts[DIGITS_COUNT][RADIX] = {};
+    for (const Entry & entry : entries)
+    {
+        for (uint32_t digit = 0; digit != DIGITS_COUNT; ++digit)
+            ++counts[digit][(entry.key >> (digit * RADIX_BITS)) & (RADIX - 1)];
+    }
+
+    sorted_entries.resize(size);
+    Entry * src = entries.data();
+    Entry * dst = sorted_entries.data();
+
+    // LSD, each pass is stable
+    for (uint32_t digit = 0; digit != DIGITS_COUNT; ++digit)
+    {
+        uint32_t shift = digit * RADIX_BITS;
+
+        // most of the digits are the same for all keys, e.g. unused passes and shaders
+        if (counts[digit][(src[0].key >> shift) & (RADIX - 1)] == size) continue;
+
+        uint32_t offsets[RADIX];
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i != RADIX; ++i)
+        {
+            offsets[i] = offset;
+            offset += counts[digit][i];
+        }
+
+        for (uint32_t i = 0; i != size; ++i)
+            dst[offsets[(src[i].key >> shift) & (RADIX - 1)]++] = src[i];
+
+        std::swap(src, dst);
+    }
+
+    if (src != entries.data()) entries.swap(sorted_entries);
+}
+} // namespace engine
@@ -0,0 +1,100 @@
+#ifndef DRAW_QUEUE_HPP
+#define DRAW_QUEUE_HPP
+
+#include "glm.hpp"
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+#include "box.hpp"
+
+namespace engine
+{
+// Opaque draw packets of one frame sorted by 64-bit keys, from the most significant bits:
+// pass 4 | shader 4 | depth layer 4 | material 16 | mesh 16 | depth 20
+// Packets are grouped by state inside of each depth layer,
+// so state changes are minimal and near layers are drawn first.
+// Translucent particles are sorted back to front by ParticleSystem instead.
+// Keys are radix-sorted, packets with equal keys keep the order they were added in.
+class DrawQueue
+{
+public:
+    static constexpr uint32_t OPAQUE_PASS = 0;
+
+    static constexpr uint32_t DEPTH_LAYERS_COUNT = 4;
+    static constexpr float FIRST_DEPTH_LAYER = 16.0f; // every next layer is twice as deep
+
+    // one instanced draw of a bucket of InstanceGroup
+    struct Packet
+    {
+        uint32_t model; // index in group.per_model
+        uint32_t mesh;
+        uint32_t material; // index in per_mesh[mesh].per_material
+        uint32_t instances_offset; // in the instance buffer
+        uint32_t instances_count;
+    };
+
+    static uint64_t makeOpaqueKey(uint32_t pass,
+                                  uint32_t shader,
+                                  uint32_t material_id,
+                                  uint32_t mesh_id,
+                                  float depth);
+
+    // model is the index in group.per_model
+    static uint32_t getMeshID(uint32_t model, uint32_t mesh)
+    {
+        assert(model < 1024 && mesh < 64 && "mesh ID overflow");
+        return (model << 6) | mesh;
+    }
+
+    static uint32_t getDepthLayer(float depth);
+
+    // the fields of makeOpaqueKey()
+    static uint32_t getPass(uint64_t key) { return uint32_t(key >> 60); }
+    static uint32_t getShader(uint64_t key) { return uint32_t(key >> 56) & 0xF; }
+    static uint32_t getLayer(uint64_t key) { return uint32_t(key >> 52) & 0xF; }
+    static uint32_t getMaterial(uint64_t key) { return uint32_t(key >> 36) & 0xFFFF; }
+    static uint32_t getMesh(uint64_t key) { return uint32_t(key >> 20) & 0xFFFF; }
+    // the depth rounded down to 11 bits of the mantissa
+    static float getQuantizedDepth(uint64_t key);
+
+    // starts a frame, depth is the distance along view_dir
+    void clear(const glm::vec3 & view_pos, const glm::vec3 & view_dir);
+
+    // depth of the nearest point of the bounding sphere of the box, 0 if the camera is inside
+    float getDepth(const math::BoundingBox & box) const
+    {
+        return glm::max(glm::dot(box.center() - view_pos, view_dir) - box.radius(), 0.0f);
+    }
+
+    void add(uint64_t key, const Packet & packet)
+    {
+        entries.push_back({key, uint32_t(packets.size())});
+        packets.push_back(packet);
+    }
+
+    void sort();
+
+    uint32_t size() const { return uint32_t(entries.size()); }
+
+    // in the sorted order
+    uint64_t getKey(uint32_t index) const { return entries[index].key; }
+    const Packet & getPacket(uint32_t index) const { return packets[entries[index].packet]; }
+
+protected:
+    struct Entry
+    {
+        uint64_t key;
+        uint32_t packet; // index in packets
+    };
+
+    glm::vec3 view_pos;
+    glm::vec3 view_dir;
+
+    std::vector<Packet> packets; // in the order they were added
+    std::vector<Entry> entries;
+    std::vector<Entry> sorted_entries; // radix sort ping-pong
+};
+} // namespace engine
+
+#endif
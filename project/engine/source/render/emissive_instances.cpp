@@ -5,44 +5,22 @@ namespace engine
 void EmissiveInstances::updateInstanceBuffers()
 {
     TransformSystem * trans_system = TransformSystem::getInstance();
-    
-    uint32_t total_instances = 0;
-    
-    for (auto & per_model : per_model)
-        for (auto & per_mesh : per_model.per_mesh)
-            for (auto & per_material : per_mesh.per_material)
-                total_instances += uint32_t(per_material.instances.size());
-
-    if (total_instances == 0) return;
 
-    instance_buffer.init(total_instances);
-    D3D11_MAPPED_SUBRESOURCE mapped = instance_buffer.map();
-    GPUInstance * dst = static_cast<GPUInstance *>(mapped.pData);
-
-    uint32_t copied_count = 0;
-    for (auto & per_model : per_model)
-    {
-        for (auto & per_mesh : per_model.per_mesh)
+    // repacks everything only if a bucket outgrew its range,
+    // otherwise just the added, moved and transformed instances
+    group.updateStaging(staging, [trans_system](const Instance & instance)
         {
-            for (auto & per_material : per_mesh.per_material)
-            {
-                uint32_t instances_size = per_material.instances.size();
-                for (uint32_t i = 0; i != instances_size; ++i)
-                {
-                    dst[copied_count++] = GPUInstance(
-                        trans_system->
-                            transforms[per_material.instances[i].transform_id].toMat4(),
-                        per_material.instances[i].radiance);
-                }
-            }
-        }
-    }
+            return GPUInstance(
+                glm::mat4(trans_system->getWorld(instance.transform_id)),
+                instance.radiance);
+        });
 
-    instance_buffer.unmap();
+    instance_buffer.update(staging);
 }
 
 void EmissiveInstances::render()
 {
+    if (group.isInstanceBufferDirty()) updateInstanceBuffers();
     if (instance_buffer.get_size() == 0) return;
 
     Globals * globals = Globals::getInstance();
@@ -55,9 +33,7 @@ void EmissiveInstances::render()
     shader->bind();
     instance_buffer.bind(1);
 
-    uint32_t rendered_instances = 0;
-    
-    for (auto & per_model: per_model)
+    for (auto & per_model: group.per_model)
     {
         if (per_model.model == nullptr) continue;
 
@@ -87,8 +63,7 @@ void EmissiveInstances::render()
                                                                instances_count,
                                                                mesh_range.index_offset,
                                                                mesh_range.vertex_offset,
-                                                               rendered_instances);               
-                rendered_instances += instances_count;
+                                                               per_material.offset);
             }
         }
     }
@@ -10,6 +10,8 @@
 #include "vertex_buffer.hpp"
 #include "model.hpp"
 #include "transform_system.hpp"
+#include "instance_group.hpp"
+#include "instance_buffer.hpp"
 
 namespace engine
 {
@@ -46,40 +48,27 @@ public:
     {
         Material() = default;
 
-        bool operator==(const Material & other)
+        bool operator==(const Material & other) const
         {
             return true;
         }
 
-        bool operator!=(const Material & other)
+        bool operator!=(const Material & other) const
         {
             return !(*this == other);
-        }       
-    };
-
-    struct PerMaterial
-    {
-        Material material;
-        std::vector<Instance> instances;
-    };
-
-    struct PerMesh
-    {
-        std::vector<PerMaterial> per_material;
-    };
+        }
 
-    struct PerModel
-    {
-        std::shared_ptr<Model> model;
-        std::vector<PerMesh> per_mesh;
+        size_t hash() const { return 0; }
     };
 
+    // called by render() if the group was changed
     void updateInstanceBuffers();
     
     void render();
 
-    std::vector<PerModel> per_model;
-    VertexBuffer<GPUInstance> instance_buffer;
+    InstanceGroup<Material, Instance> group;
+    InstanceStaging<GPUInstance> staging;
+    InstanceBuffer<GPUInstance> instance_buffer;
 
     std::shared_ptr<Shader> shader;
 };
@@ -5,6 +5,7 @@ namespace engine
 void Engine::init()
 {    
     // INIT SINGLETONS
+    ThreadPool::init();
     Globals::init();
     ShaderManager::init();
     TextureManager::init();
@@ -15,6 +16,7 @@ void Engine::init()
     ParticleSystem::init();
     GrassSystem::init();
     DecalSystem::init();
+    ExpirySystem::init();
 
     TimeSystem::init();
 }
@@ -22,6 +24,7 @@ void Engine::init()
 void Engine::del()
 {
     // destruct singletons in reverse order!
+    ExpirySystem::del();
     DecalSystem::del();
     GrassSystem::del();
     ParticleSystem::del();
@@ -32,5 +35,6 @@ void Engine::del()
     TextureManager::del();
     ShaderManager::del();
     Globals::del();
+    ThreadPool::del();
 }
 } // namespace engine
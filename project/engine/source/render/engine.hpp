@@ -13,6 +13,8 @@
 #include "time_system.hpp"
 #include "grass_system.hpp"
 #include "decal_system.hpp"
+#include "expiry_system.hpp"
+#include "thread_pool.hpp"
 
 namespace engine
 {
@@ -0,0 +1,86 @@
+#include "expiry_system.hpp"
+
+#include <algorithm>
+#include "spdlog.h"
+
+namespace engine
+{
+ExpirySystem * ExpirySystem::instance = nullptr;
+
+void ExpirySystem::init()
+{
+    if (!instance) instance = new ExpirySystem();
+    else spdlog::error("ExpirySystem::init() was called twice!");
+}
+
+ExpirySystem * ExpirySystem::getInstance()
+{
+    return instance;
+}
+
+void ExpirySystem::del()
+{
+    if (instance)
+    {
+        delete instance;
+        instance = nullptr;
+    }
+    else spdlog::error("ExpirySystem::del() was called twice!");
+}
+
+ExpirySystem::ID ExpirySystem::schedule(float expiry_time, Callback callback)
+{
+    ID id = next_id++;
+
+    callbacks.emplace(id, std::move(callback));
+
+    heap.push_back({expiry_time, id});
+    std::push_heap(heap.begin(), heap.end());
+
+    return id;
+}
+
+void ExpirySystem::cancel(ID id)
+{
+    callbacks.erase(id);
+    popCancelled();
+}
+
+void ExpirySystem::update(float time)
+{
+    popCancelled();
+
+    while (!heap.empty() && heap.front().expiry_time <= time)
+    {
+        ID id = heap.front().id;
+        std::pop_heap(heap.begin(), heap.end());
+        heap.pop_back();
+
+        auto found = callbacks.find(id);
+        if (found != callbacks.end())
+        {
+            // the callback can schedule new ones, so it's removed before the call
+            Callback callback = std::move(found->second);
+            callbacks.erase(found);
+
+            callback();
+        }
+
+        popCancelled();
+    }
+}
+
+float ExpirySystem::getNextExpiryTime() const
+{
+    return heap.empty() ? NEVER : heap.front().expiry_time;
+}
+
+void ExpirySystem::popCancelled()
+{
+    while (!heap.empty() && callbacks.find(heap.front().id) == callbacks.end())
+    {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.pop_back();
+    }
+}
+} // namespace engine
@@ -0,0 +1,79 @@
+#ifndef EXPIRY_SYSTEM_HPP
+#define EXPIRY_SYSTEM_HPP
+
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <limits>
+#include <cstdint>
+
+namespace engine
+{
+// Calls registered callbacks when their expiry time is reached.
+// Entries are kept in a min-heap by the expiry time,
+// so update() touches only the expired ones.
+// Time is TimeSystem::getTimePoint().
+class ExpirySystem final
+{
+public:
+    using ID = uint32_t;
+    using Callback = std::function<void()>;
+
+    static constexpr float NEVER = std::numeric_limits<float>::infinity();
+
+    // never returned by schedule(), cancelling it does nothing
+    static constexpr ID INVALID_ID = std::numeric_limits<ID>::max();
+
+    // deleted methods should be public for better error messages
+    ExpirySystem(const ExpirySystem & other) = delete;
+    void operator=(const ExpirySystem & other) = delete;
+
+    static void init();
+
+    static ExpirySystem * getInstance();
+
+    static void del();
+
+    // callback is called once by update(), it can schedule new callbacks
+    ID schedule(float expiry_time, Callback callback);
+
+    // does nothing if the callback was already called
+    void cancel(ID id);
+
+    // calls the callbacks with expiry_time <= time in the order of expiry
+    void update(float time);
+
+    // NEVER if nothing is scheduled
+    float getNextExpiryTime() const;
+
+    bool empty() const { return callbacks.empty(); }
+
+private:
+    ExpirySystem() = default;
+    ~ExpirySystem() = default;
+
+    struct Entry
+    {
+        float expiry_time;
+        ID id;
+
+        // for the min-heap, equal times are called in the schedule order
+        bool operator<(const Entry & other) const
+        {
+            if (expiry_time != other.expiry_time) return expiry_time > other.expiry_time;
+            return id > other.id;
+        }
+    };
+
+    // cancelled entries stay in the heap until they are popped
+    void popCancelled();
+
+    std::vector<Entry> heap;
+    std::unordered_map<ID, Callback> callbacks;
+    ID next_id = 0;
+
+    static ExpirySystem * instance;
+};
+} // namespace engine
+
+#endif
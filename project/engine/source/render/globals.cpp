@@ -218,8 +218,11 @@ void Globals::initRasterizers()
 
 void Globals::bindRasterizer(bool is_double_sided)
 {
-    if (is_double_sided) device_context4->RSSetState(double_sided_rasterizer.ptr());
-    else device_context4->RSSetState(one_sided_rasterizer.ptr());
+    ID3D11RasterizerState * rasterizer = is_double_sided ?
+        double_sided_rasterizer.ptr() : one_sided_rasterizer.ptr();
+
+    if (state_cache.set(StateCache::State::RASTERIZER, rasterizer))
+        device_context4->RSSetState(rasterizer);
 }
 
 void Globals::initBlendStates()
@@ -253,6 +256,8 @@ void Globals::initBlendStates()
 
 void Globals::bindDefaultBlendState()
 {
+    if (!state_cache.set(StateCache::State::BLEND_STATE, nullptr)) return;
+
     device_context4->OMSetBlendState(nullptr,
                                      nullptr,
                                      0xffffffff);
@@ -260,6 +265,8 @@ void Globals::bindDefaultBlendState()
 
 void Globals::bindTranslucentBlendState()
 {
+    if (!state_cache.set(StateCache::State::BLEND_STATE, translucent_blend_state.ptr())) return;
+
     device_context4->OMSetBlendState(translucent_blend_state.ptr(),
                                      nullptr,
                                      0xffffffff);
@@ -267,11 +274,30 @@ void Globals::bindTranslucentBlendState()
 
 void Globals::bindA2CBlendState()
 {
+    if (!state_cache.set(StateCache::State::BLEND_STATE, a2c_blend_state.ptr())) return;
+
     device_context4->OMSetBlendState(a2c_blend_state.ptr(),
                                      nullptr,
                                      0xffffffff);
 }
 
+void Globals::bindPSShaderResources(uint32_t slot,
+                                    uint32_t count,
+                                    ID3D11ShaderResourceView * const * srvs)
+{
+    if (state_cache.setPixelSRVs(slot, count, srvs))
+        device_context4->PSSetShaderResources(slot, count, srvs);
+}
+
+void Globals::bindRenderTargets(uint32_t count,
+                                ID3D11RenderTargetView * const * rtvs,
+                                ID3D11DepthStencilView * dsv)
+{
+    state_cache.invalidatePixelSRVs();
+
+    device_context4->OMSetRenderTargets(count, rtvs, dsv);
+}
+
 void Globals::initPerFrameBuffer()
 {
     D3D11_BUFFER_DESC cb_desc;
@@ -306,28 +332,29 @@ void Globals::setPerFrameBuffer(int g_reflection_mips_count,
     per_frame_buffer_data.g_delta_time = g_delta_time;
     per_frame_buffer_data.g_sparks_data_buffer_size = g_sparks_data_buffer_size;
 
+    // the rest of the point lights are only in the light clusters
     auto & point_lights = light_system->getPointLights();
-    for (uint32_t size = point_lights.size(), i = 0; i != size; ++i)
+    for (uint32_t size = std::min(uint32_t(point_lights.size()), 4u), i = 0; i != size; ++i)
     {
-        uint32_t transform_id = point_lights[i].transform_id;
+        glm::vec3 position = trans_system->getWorld(point_lights[i].transform_id)[3];
         
-        per_frame_buffer_data.g_point_lights[i].position =
-            trans_system->transforms[transform_id].position;
+        per_frame_buffer_data.g_point_lights[i].position = position;
 
         per_frame_buffer_data.g_point_lights[i].radiance =
             point_lights[i].radiance;
 
         per_frame_buffer_data.g_point_lights[i].radius =
             point_lights[i].radius;
+    }
 
-        // shadow map
-        std::vector<Camera> cameras = Camera::generateCubemapCameras(
-            trans_system->transforms[transform_id].position);
-
-        for (uint32_t c_size = cameras.size(), c = 0; c != c_size; ++c)
+    // shadow map, cached in LightSystem::updateShadowCubemaps()
+    auto & shadow_cubemaps = light_system->getShadowCubemaps();
+    for (uint32_t size = shadow_cubemaps.size(), i = 0; i != size; ++i)
+    {
+        for (uint32_t face = 0; face != 6; ++face)
         {
-            per_frame_buffer_data.g_light_proj_view[6 * i + c] =
-                cameras[c].getViewProj();
+            per_frame_buffer_data.g_light_proj_view[6 * i + face] =
+                shadow_cubemaps[i].view_proj[face];
         }
     }
 
@@ -418,6 +445,10 @@ void Globals::setPerViewBuffer(const Camera & camera,
     per_view_buffer_data.g_frustum_corners[0] = glm::vec4(bottom_left_WS, 1.0f);
     per_view_buffer_data.g_frustum_corners[1] = glm::vec4(top_left_WS, 1.0f);
     per_view_buffer_data.g_frustum_corners[2] = glm::vec4(bottom_right_WS, 1.0f);
+
+    const LightClusters & light_clusters = LightSystem::getInstance()->getLightClusters();
+    per_view_buffer_data.g_cluster_near = light_clusters.getNear();
+    per_view_buffer_data.g_cluster_slice_scale = light_clusters.getSliceScale();
 }
 
 void Globals::updatePerViewBuffer()
@@ -649,9 +680,10 @@ void Globals::initPerShadowCubemapBuffer()
     assert(result >= 0 && "CreateBuffer");
 }
 
-void Globals::setPerShadowCubemapBuffer(int cubemap_index)
+void Globals::setPerShadowCubemapBuffer(int cubemap_index, uint32_t face_mask)
 {
     per_shadow_cubemap_buffer_data.cubemap_index = cubemap_index;
+    per_shadow_cubemap_buffer_data.face_mask = face_mask;
 }
 
 void Globals::updatePerShadowCubemapBuffer()
@@ -18,6 +18,7 @@
 #include "light_system.hpp"
 #include "transform_system.hpp"
 #include "time_system.hpp"
+#include "state_cache.hpp"
 
 #include "win_undef.hpp"
 
@@ -67,6 +68,10 @@ struct PerViewBufferData
     glm::vec3 g_camera_pos;
     float g_EV_100;
     glm::vec4 g_frustum_corners[3];
+    // see LightClusters
+    float g_cluster_near;
+    float g_cluster_slice_scale;
+    glm::vec2 padding_per_view_0;
 };
 
 struct PerMeshBufferData
@@ -100,7 +105,8 @@ struct PerShadowMeshBufferData
 struct PerShadowCubemapBufferData
 {
     int cubemap_index;
-    glm::vec3 padding_4;
+    uint32_t face_mask; // bit i - the i-th face of the cubemap is rendered
+    glm::vec2 padding_4;
 };
 
 // Singleton for global rendering resources
@@ -130,6 +136,16 @@ public:
     void bindTranslucentBlendState();
     void bindA2CBlendState();    
 
+    // pixel shader SRVs, skipped if already bound
+    void bindPSShaderResources(uint32_t slot,
+                               uint32_t count,
+                               ID3D11ShaderResourceView * const * srvs);
+
+    // forgets the bound pixel shader SRVs, D3D unbinds the ones bound as targets
+    void bindRenderTargets(uint32_t count,
+                           ID3D11RenderTargetView * const * rtvs,
+                           ID3D11DepthStencilView * dsv);
+
     void initPerFrameBuffer();
     void setPerFrameBuffer(int g_reflection_mips_count,
                            int g_shadow_map_size,
@@ -169,7 +185,7 @@ public:
     void updatePerShadowMeshBuffer();
 
     void initPerShadowCubemapBuffer();
-    void setPerShadowCubemapBuffer(int cubemap_index);
+    void setPerShadowCubemapBuffer(int cubemap_index, uint32_t face_mask = 0x3F);
     void updatePerShadowCubemapBuffer();
     
     DxResPtr<IDXGIFactory5> factory5;
@@ -205,6 +221,9 @@ public:
     DxResPtr<ID3D11BlendState> translucent_blend_state;
     DxResPtr<ID3D11BlendState> a2c_blend_state;
 
+    // everything bound through Globals, Shader, Texture and vertex buffers
+    StateCache state_cache;
+
 private:
     Globals() = default;
     ~Globals() = default;
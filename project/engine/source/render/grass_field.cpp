@@ -4,6 +4,9 @@ namespace
 {
 constexpr float MIN_GRASS_SIZE = 4.0f;
 constexpr float MAX_GRASS_SIZE = 10.0f;
+
+constexpr float GRASS_SPACING = 4.0f;
+constexpr float GRASS_TILE_SIZE = 64.0f;
 } // namespace 
 
 namespace engine
@@ -23,14 +26,42 @@ const std::vector<Grass> & GrassField::getGrass() const
 
 void GrassField::initGrass()
 {
-    std::vector<glm::vec2> positions = math::poissonDiscSampling(size.x,
-                                                                 size.y,
-                                                                 4.0f);
+    math::Random & random = math::getThreadRandom();
+    ThreadPool * thread_pool = ThreadPool::getInstance();
+
+    // tiles of one pass are sampled in parallel, so big fields take bounded time
+    math::PoissonDiscSampler sampler(size,
+                                     GRASS_SPACING,
+                                     GRASS_TILE_SIZE,
+                                     30,
+                                     random.next());
+
+    for (uint32_t pass = 0; pass != math::PoissonDiscSampler::PASSES_COUNT; ++pass)
+    {
+        const std::vector<uint32_t> & tiles = sampler.getPassTiles(pass);
+
+        thread_pool->parallelFor(uint32_t(tiles.size()),
+                                 1,
+                                 [&](uint32_t begin, uint32_t end)
+                                 {
+                                     for (uint32_t i = begin; i != end; ++i)
+                                         sampler.sampleTile(tiles[i]);
+                                 });
+    }
+
+    std::vector<glm::vec2> positions;
+    sampler.getSamples(positions);
     
-    for (auto & pos : positions)
+    std::vector<float> sizes(positions.size());
+    random.fill(sizes.data(),
+                uint32_t(sizes.size()),
+                MIN_GRASS_SIZE,
+                MAX_GRASS_SIZE);
+
+    for (uint32_t i = 0, count = positions.size(); i != count; ++i)
     {
-        glm::vec2 grass_size(math::randomFromRange(MIN_GRASS_SIZE,
-                                                   MAX_GRASS_SIZE));
+        const glm::vec2 & pos = positions[i];
+        glm::vec2 grass_size(sizes[i]);
 
         glm::vec3 grass_pos = glm::vec3(pos.x, grass_size.y / 2.0f, pos.y) +
                               position -
@@ -6,6 +6,7 @@
 
 #include "random.hpp"
 #include "grass.hpp"
+#include "thread_pool.hpp"
 
 namespace engine
 {
@@ -1,5 +1,18 @@
 #include "grass_system.hpp"
 
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr float GRASS_CHUNK_SIZE = 16.0f;
+
+// density falls linearly from 1 to MIN_GRASS_DENSITY between these distances
+constexpr float GRASS_LOD_START = 40.0f;
+constexpr float GRASS_LOD_END = 160.0f;
+constexpr float MIN_GRASS_DENSITY = 0.15f;
+} // namespace
+
 namespace engine
 {
 GrassSystem * GrassSystem::instance = nullptr;
@@ -28,38 +41,103 @@ void GrassSystem::del()
 void GrassSystem::addGrassField(const GrassField & grass_field)
 {
     grass_fields.push_back(grass_field);
+    is_changed = true;
 }
 
-void GrassSystem::updateInstanceBuffer()
+void GrassSystem::addChunks(const GrassField & grass_field, std::vector<GPUInstance> & instances)
 {
-    std::vector<Grass> instances;
+    auto & grass = grass_field.getGrass();
+    if (grass.empty()) return;
+
+    glm::vec2 field_min = glm::vec2(grass_field.position.x, grass_field.position.z) - grass_field.size / 2.0f;
+    uint32_t chunks_x = std::max(uint32_t(std::ceil(grass_field.size.x / GRASS_CHUNK_SIZE)), 1u);
+    uint32_t chunks_z = std::max(uint32_t(std::ceil(grass_field.size.y / GRASS_CHUNK_SIZE)), 1u);
 
-    for (auto & grass_field : grass_fields)
+    auto getChunk = [&](const glm::vec3 & position)
     {
-        auto & src = grass_field.getGrass();
-        instances.insert(instances.end(), src.begin(), src.end());
-    }
-    if (instances.size() == 0) return;
+        glm::vec2 cell = (glm::vec2(position.x, position.z) - field_min) / GRASS_CHUNK_SIZE;
+        uint32_t x = std::min(uint32_t(std::max(cell.x, 0.0f)), chunks_x - 1);
+        uint32_t z = std::min(uint32_t(std::max(cell.y, 0.0f)), chunks_z - 1);
+        return z * chunks_x + x;
+    };
+
+    // counting sort of the blades by chunks
+    std::vector<uint32_t> offsets(chunks_x * chunks_z + 1, 0);
+    for (const Grass & blade : grass) ++offsets[getChunk(blade.position) + 1];
+    for (uint32_t i = 1, size = offsets.size(); i != size; ++i) offsets[i] += offsets[i - 1];
+
+    struct Blade
+    {
+        uint64_t hash;
+        GPUInstance instance;
+    };
 
-    instance_buffer.init(instances.size());
-    D3D11_MAPPED_SUBRESOURCE mapped = instance_buffer.map();
-    GPUInstance * dst = static_cast<GPUInstance *>(mapped.pData);
+    std::vector<Blade> blades(grass.size(), {0, GPUInstance(glm::vec3(0.0f), glm::vec2(0.0f))});
+    std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+    for (const Grass & blade : grass)
+    {
+        uint64_t hash = hashBytes(&blade.position, sizeof(glm::vec3));
+        blades[next[getChunk(blade.position)]++] = {hash, GPUInstance(blade.position, blade.size)};
+    }
 
-    uint32_t copied_count = 0;
-    for (auto & grass : instances)
+    for (uint32_t c = 0, size = offsets.size() - 1; c != size; ++c)
     {
-        dst[copied_count++] = GPUInstance(grass.position,
-                                          grass.size);
-    }    
-    
-    instance_buffer.unmap();
+        if (offsets[c] == offsets[c + 1]) continue;
+
+        Blade * first = blades.data() + offsets[c];
+        Blade * last = blades.data() + offsets[c + 1];
+
+        // the order the blades are thinned in
+        std::sort(first, last, [](const Blade & a, const Blade & b) { return a.hash < b.hash; });
+
+        Chunk chunk = {uint32_t(instances.size()), uint32_t(last - first), 0};
+        math::BoundingBox box = math::BoundingBox::empty();
+
+        chunk.signature = hashBytes(&chunk.count, sizeof(chunk.count));
+        for (Blade * blade = first; blade != last; ++blade)
+        {
+            const GPUInstance & instance = blade->instance;
+            instances.push_back(instance);
+
+            // a blade is a quad around the position, any rotation fits into this box
+            glm::vec3 extent(glm::length(instance.size / 2.0f));
+            box.expand(math::BoundingBox{instance.position - extent, instance.position + extent});
+
+            chunk.signature = hashBytes(&blade->hash, sizeof(blade->hash), chunk.signature);
+            chunk.signature = hashBytes(&instance.size, sizeof(glm::vec2), chunk.signature);
+        }
+
+        chunks.push_back(chunk);
+        chunk_boxes.resize(uint32_t(chunks.size()));
+        chunk_boxes.set(uint32_t(chunks.size()) - 1, box);
+    }
 }
 
-void GrassSystem::render()
+void GrassSystem::updateChunks()
 {
-    updateInstanceBuffer();
+    if (!is_changed) return;
+    is_changed = false;
+
+    std::vector<GPUInstance> instances;
+    chunks.clear();
+    chunk_boxes.resize(0);
 
-    if (instance_buffer.get_size() == 0) return;
+    for (auto & grass_field : grass_fields) addChunks(grass_field, instances);
+
+    if (instances.empty()) return;
+
+    // never changes until the next field is added
+    instance_buffer.init(instances.data(), uint32_t(instances.size()));
+}
+
+void GrassSystem::render(const math::Frustum & frustum, const glm::vec3 & view_pos)
+{
+    updateChunks();
+
+    if (chunks.empty()) return;
+
+    chunk_visibility.resize(chunks.size());
+    math::cullBoxes(frustum, chunk_boxes, 0, chunk_boxes.size(), chunk_visibility.data());
 
     Globals * globals = Globals::getInstance();
     
@@ -79,17 +157,46 @@ void GrassSystem::render()
     ambient_occlusion->bind(4);
     translucency->bind(5);
 
-    globals->device_context4->DrawInstanced(18,
-                                            instance_buffer.get_size(),
-                                            0,
-                                            0);
+    for (uint32_t i = 0, size = chunks.size(); i != size; ++i)
+    {
+        if (!chunk_visibility[i]) continue;
+
+        // distance to the nearest point of the chunk, 0 inside of it
+        math::BoundingBox box = chunk_boxes.get(i);
+        float distance = glm::length(glm::clamp(view_pos, box.min, box.max) - view_pos);
+
+        float t = glm::clamp((distance - GRASS_LOD_START) / (GRASS_LOD_END - GRASS_LOD_START), 0.0f, 1.0f);
+        float density = 1.0f + (MIN_GRASS_DENSITY - 1.0f) * t;
+
+        uint32_t count = std::max(uint32_t(std::ceil(chunks[i].count * density)), 1u);
+
+        globals->device_context4->DrawInstanced(18,
+                                                count,
+                                                0,
+                                                chunks[i].begin);
+    }
 }
 
-void GrassSystem::renderWithoutMaterials(int cubemaps_count)
+void GrassSystem::updateShadowCasters(int cubemaps_count, ShadowCache & cache)
 {
-    updateInstanceBuffer();
+    updateChunks();
+
+    bucket_ranges.assign(1, {0, uint32_t(chunks.size())});
+    shadow_casters.update(LightSystem::getInstance()->getShadowCubemaps(),
+                          cubemaps_count,
+                          chunk_boxes,
+                          bucket_ranges);
+
+    const Chunk * chunks_data = chunks.data();
+    shadow_casters.addSignatures(cache, [chunks_data](uint32_t index)
+    {
+        return chunks_data[index].signature;
+    });
+}
 
-    if (instance_buffer.get_size() == 0) return;
+void GrassSystem::renderWithoutMaterials(const ShadowCache & cache)
+{
+    if (shadow_casters.getIndices().empty()) return;
 
     Globals * globals = Globals::getInstance();
     
@@ -107,15 +214,29 @@ void GrassSystem::renderWithoutMaterials(int cubemaps_count)
     globals->setPerShadowMeshBuffer();
     globals->updatePerShadowMeshBuffer();
 
-    for (int cubemap_index = 0; cubemap_index != cubemaps_count; ++cubemap_index)
+    for (uint32_t c = 0, size = shadow_casters.getCubemapsCount(); c != size; ++c)
     {
-        globals->setPerShadowCubemapBuffer(cubemap_index);
-        globals->updatePerShadowCubemapBuffer();
-                    
-        globals->device_context4->DrawInstanced(18,
-                                                instance_buffer.get_size(),
-                                                0,
-                                                0);
+        for (uint32_t face = 0; face != ShadowCasters::FACES_COUNT; ++face)
+        {
+            if (!cache.isFaceInvalid(c, face)) continue;
+
+            ShadowCasters::Range range = shadow_casters.getRange(c, face, 0);
+            if (range.count == 0) continue;
+
+            globals->setPerShadowCubemapBuffer(c, 1u << face);
+            globals->updatePerShadowCubemapBuffer();
+
+            // the casters are chunks, each one is a range of the instance buffer
+            for (uint32_t i = range.begin, end = range.begin + range.count; i != end; ++i)
+            {
+                const Chunk & chunk = chunks[shadow_casters.getIndices()[i]];
+
+                globals->device_context4->DrawInstanced(18,
+                                                        chunk.count,
+                                                        0,
+                                                        chunk.begin);
+            }
+        }
     }
 }
 } // namespace engine
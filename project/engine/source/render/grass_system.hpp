@@ -8,9 +8,16 @@
 #include "texture.hpp"
 #include "grass_field.hpp"
 #include "vertex_buffer.hpp"
+#include "frustum.hpp"
+#include "shadow_casters.hpp"
 
 namespace engine
 {
+// Blades of all the fields are split into square chunks and uploaded once,
+// the buffer is rebuilt only when a field is added.
+// Inside of a chunk blades are ordered by a stable hash of their position,
+// so a distant chunk draws a prefix of its range and the same blades
+// always remain, regardless of the camera movement.
 class GrassSystem
 {
 public:
@@ -26,9 +33,13 @@ public:
 
     void addGrassField(const GrassField & grass_field);
 
-    void updateInstanceBuffer();
-    void render();
-    void renderWithoutMaterials(int cubemaps_count);
+    // rebuilds the chunks if the fields were changed
+    void updateChunks();
+    void render(const math::Frustum & frustum, const glm::vec3 & view_pos);
+    // see MeshSystem::updateShadowCasters(),
+    // whole chunks are culled, shadows always use the full density
+    void updateShadowCasters(int cubemaps_count, ShadowCache & cache);
+    void renderWithoutMaterials(const ShadowCache & cache);
 
     // move them to GrassField class for different grass:
     std::shared_ptr<Shader> shader;
@@ -59,9 +70,27 @@ private:
         glm::vec2 size;
     };
 
+    struct Chunk
+    {
+        uint32_t begin; // in instance_buffer
+        uint32_t count;
+        uint64_t signature; // of the blades, for the shadow cache
+    };
+
+    void addChunks(const GrassField & grass_field, std::vector<GPUInstance> & instances);
+
     VertexBuffer<GPUInstance> instance_buffer;
+
+    std::vector<Chunk> chunks;
+    math::BoxBatch chunk_boxes;
+    std::vector<uint8_t> chunk_visibility;
+
+    // all the chunks are one bucket
+    ShadowCasters shadow_casters;
+    std::vector<InstanceRange> bucket_ranges;
     
     std::vector<GrassField> grass_fields;
+    bool is_changed = false;
 };
 } // namespace engine
 
@@ -0,0 +1,94 @@
+#ifndef INSTANCE_BUFFER_HPP
+#define INSTANCE_BUFFER_HPP
+
+#include <d3d11_4.h>
+#include <cassert>
+
+#include "dx_res_ptr.hpp"
+#include "globals.hpp"
+#include "instance_staging.hpp"
+
+namespace engine
+{
+// Persistent per-instance vertex buffer: it's recreated only when
+// InstanceStaging grows its capacity, otherwise just the dirty ranges
+// of the staging are copied with UpdateSubresource()
+template <class T>
+class InstanceBuffer
+{
+public:
+    InstanceBuffer() = default;
+
+    void update(InstanceStaging<T> & staging)
+    {
+        Globals * globals = Globals::getInstance();
+
+        if (staging.getCapacity() != capacity)
+        {
+            capacity = staging.getCapacity();
+
+            D3D11_BUFFER_DESC vbo_desc;
+            ZeroMemory(&vbo_desc, sizeof(vbo_desc));
+            vbo_desc.Usage = D3D11_USAGE_DEFAULT;
+            vbo_desc.ByteWidth = sizeof(T) * capacity;
+            vbo_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+            vbo_desc.CPUAccessFlags = 0;
+
+            HRESULT result = globals->device5->CreateBuffer(&vbo_desc,
+                                                            NULL,
+                                                            data.reset());
+            assert(result >= 0 && "CreateBuffer()");
+
+            // the new buffer is empty
+            staging.invalidate();
+        }
+
+        for (auto & range : staging.getDirtyRanges())
+        {
+            D3D11_BOX box;
+            box.left = range.begin * sizeof(T);
+            box.right = range.end * sizeof(T);
+            box.top = 0;
+            box.bottom = 1;
+            box.front = 0;
+            box.back = 1;
+
+            globals->device_context4->UpdateSubresource(data.ptr(),
+                                                        0,
+                                                        &box,
+                                                        staging.data() + range.begin,
+                                                        0,
+                                                        0);
+        }
+
+        staging.clearDirty();
+        size = staging.size();
+    }
+
+    void bind(uint32_t slot)
+    {
+        Globals * globals = Globals::getInstance();
+
+        if (!globals->state_cache.setVertexBuffer(slot, data.ptr(), stride, offset)) return;
+
+        globals->device_context4->IASetVertexBuffers(slot,
+                                                     1,
+                                                     data.get(),
+                                                     &stride,
+                                                     &offset);
+    }
+
+    DxResPtr<ID3D11Buffer> & get_data() { return data; }
+    uint32_t get_size() const { return size; }
+    uint32_t get_capacity() const { return capacity; }
+
+private:
+    DxResPtr<ID3D11Buffer> data;
+    uint32_t size = 0;
+    uint32_t capacity = 0;
+    uint32_t stride = sizeof(T);
+    uint32_t offset = 0;
+};
+} // namespace engine
+
+#endif
@@ -0,0 +1,469 @@
+#ifndef INSTANCE_GROUP_HPP
+#define INSTANCE_GROUP_HPP
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <algorithm>
+
+#include "model.hpp"
+#include "globals.hpp"
+#include "soa_solid_vector.hpp"
+#include "instance_staging.hpp"
+#include "frustum.hpp"
+#include "draw_queue.hpp"
+
+namespace engine
+{
+template <class T>
+void hashCombine(size_t & seed, const T & value)
+{
+    seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+// identifies an instance inside its InstanceGroup, generational:
+// the handle of a removed instance never matches an instance added later
+// (until the generation of the slot wraps around), so handles kept
+// by callbacks can be checked with contains()
+using InstanceHandle = uint32_t;
+constexpr InstanceHandle INVALID_INSTANCE_HANDLE = UINT32_MAX; // never returned by add()
+
+// Instances of one kind grouped for instanced draw calls:
+// model -> mesh -> material -> instances.
+// Models are found by pointer and materials by interned ID,
+// so adding an instance doesn't depend on the number of groups.
+// add() returns a handle which points straight to the instance slots,
+// so remove() is a swap-remove in each mesh bucket.
+// Buckets are never erased, empty ones are skipped by the renderers.
+// Every bucket reserves a range of the instance buffer with room to grow,
+// so add() and remove() change only a few slots of its range,
+// the slots after the last instance of a bucket are never drawn.
+// Material has to provide operator== and hash() consistent with it.
+template <class Material, class Instance>
+class InstanceGroup
+{
+public:
+    // reserved slots of a new bucket,
+    // after a relayout each bucket reserves twice its instances
+    static constexpr uint32_t MIN_BUCKET_CAPACITY = 8;
+
+    struct PerMaterial
+    {
+        uint32_t material_id;
+        Material material;
+        std::vector<Instance> instances;
+        std::vector<uint32_t> handles; // the same order as instances
+
+        // the reserved range of the instance buffer
+        uint32_t offset;
+        uint32_t capacity;
+    };
+
+    struct PerMesh
+    {
+        std::vector<PerMaterial> per_material;
+
+        // material ID -> index in per_material
+        std::unordered_map<uint32_t, uint32_t> material_index;
+    };
+
+    struct PerModel
+    {
+        std::shared_ptr<Model> model;
+        std::vector<PerMesh> per_mesh; // the same order as the model meshes
+    };
+
+    using Handle = InstanceHandle;
+
+    // materials[i] is used for the i-th mesh of the model
+    Handle add(const std::shared_ptr<Model> & model,
+               const std::vector<Material> & materials,
+               const Instance & instance)
+    {
+        auto found = model_index.find(model.get());
+
+        if (found == model_index.end())
+        {
+            found = model_index.emplace(model.get(), uint32_t(per_model.size())).first;
+
+            per_model.emplace_back();
+            per_model.back().model = model;
+        }
+
+        std::vector<PerMesh> & per_mesh = per_model[found->second].per_mesh;
+        if (per_mesh.size() < materials.size()) per_mesh.resize(materials.size());
+
+        Handle handle = records.insert({found->second, {}});
+        Record & record = getRecord(handle);
+        record.slots.resize(materials.size());
+
+        for (uint32_t i = 0, size = materials.size(); i != size; ++i)
+        {
+            uint32_t material_id = internMaterial(materials[i]);
+
+            auto index = per_mesh[i].material_index.find(material_id);
+            if (index == per_mesh[i].material_index.end())
+            {
+                index = per_mesh[i].material_index.emplace(
+                    material_id, uint32_t(per_mesh[i].per_material.size())).first;
+
+                // new buckets are placed after the others
+                per_mesh[i].per_material.push_back(
+                    {material_id, materials[i], {}, {}, buffer_size, MIN_BUCKET_CAPACITY});
+                buffer_size += MIN_BUCKET_CAPACITY;
+            }
+
+            PerMaterial & bucket = per_mesh[i].per_material[index->second];
+            record.slots[i] = {index->second, uint32_t(bucket.instances.size())};
+
+            bucket.instances.push_back(instance);
+            bucket.handles.push_back(handle);
+
+            if (bucket.instances.size() > bucket.capacity) is_layout_dirty = true;
+        }
+
+        transform_handles.emplace(instance.transform_id, handle);
+        if (!is_layout_dirty) dirty_handles.push_back(handle);
+
+        return handle;
+    }
+
+    // O(number of meshes), the last instance of each bucket takes the freed slot,
+    // a stale handle is ignored
+    void remove(Handle handle)
+    {
+        if (!contains(handle)) return;
+
+        eraseTransformHandle(getInstance(handle).transform_id, handle);
+
+        Record & record = getRecord(handle);
+        std::vector<PerMesh> & per_mesh = per_model[record.model].per_mesh;
+
+        for (uint32_t i = 0, size = record.slots.size(); i != size; ++i)
+        {
+            const Slot & slot = record.slots[i];
+            PerMaterial & bucket = per_mesh[i].per_material[slot.per_material];
+
+            uint32_t last = uint32_t(bucket.instances.size()) - 1;
+            if (slot.index != last)
+            {
+                Handle moved = bucket.handles[last];
+                bucket.instances[slot.index] = std::move(bucket.instances[last]);
+                bucket.handles[slot.index] = moved;
+
+                getRecord(moved).slots[i].index = slot.index;
+                if (!is_layout_dirty) dirty_handles.push_back(moved);
+            }
+
+            bucket.instances.pop_back();
+            bucket.handles.pop_back();
+        }
+
+        records.erase(handle);
+    }
+
+    void remove(const Handle * handles, uint32_t handles_count)
+    {
+        for (uint32_t i = 0; i != handles_count; ++i)
+            remove(handles[i]);
+    }
+
+    uint32_t size() const { return records.size(); }
+
+    // false for a removed instance even if its slot was reused
+    bool contains(Handle handle) const { return records.valid(handle); }
+
+    const std::shared_ptr<Model> & getModel(Handle handle) const
+    {
+        return per_model[getRecord(handle).model].model;
+    }
+
+    uint32_t getMeshCount(Handle handle) const
+    {
+        return uint32_t(getRecord(handle).slots.size());
+    }
+
+    const PerMaterial & getBucket(Handle handle, uint32_t mesh) const
+    {
+        const Record & record = getRecord(handle);
+        return per_model[record.model].per_mesh[mesh].per_material[record.slots[mesh].per_material];
+    }
+
+    // every mesh keeps its own copy of the instance
+    const Instance & getInstance(Handle handle, uint32_t mesh = 0) const
+    {
+        return getBucket(handle, mesh).instances[getRecord(handle).slots[mesh].index];
+    }
+
+    // f(Handle, const Instance &) is called once per instance
+    template <class F>
+    void forEach(F && f) const
+    {
+        // every instance has exactly one copy in the buckets of the first mesh
+        for (auto & model : per_model)
+        {
+            if (model.per_mesh.empty()) continue;
+
+            for (auto & per_material : model.per_mesh[0].per_material)
+            {
+                for (uint32_t i = 0, size = per_material.instances.size(); i != size; ++i)
+                    f(per_material.handles[i], per_material.instances[i]);
+            }
+        }
+    }
+
+    // the buckets are laid out again and the whole buffer is repacked
+    void invalidateInstanceBuffer() { is_layout_dirty = true; }
+
+    // only instances with this transform are repacked
+    void invalidateTransform(uint32_t transform_id)
+    {
+        if (!is_layout_dirty) dirty_transforms.push_back(transform_id);
+    }
+
+    bool isInstanceBufferDirty() const
+    {
+        return is_layout_dirty || !dirty_handles.empty() || !dirty_transforms.empty();
+    }
+
+    // writes the changed instances to the ranges of their buckets,
+    // the whole buffer is repacked only when a bucket outgrows its range,
+    // pack(const Instance &) returns the GPU instance
+    template <class GPUInstance, class Pack>
+    void updateStaging(InstanceStaging<GPUInstance> & staging, Pack && pack)
+    {
+        if (is_layout_dirty)
+        {
+            buffer_size = 0;
+
+            for (auto & model : per_model)
+                for (auto & per_mesh : model.per_mesh)
+                    for (auto & per_material : per_mesh.per_material)
+                    {
+                        per_material.offset = buffer_size;
+                        per_material.capacity = std::max(MIN_BUCKET_CAPACITY,
+                                                         uint32_t(per_material.instances.size()) * 2);
+                        buffer_size += per_material.capacity;
+                    }
+
+            staging.resize(buffer_size);
+
+            for (auto & model : per_model)
+                for (auto & per_mesh : model.per_mesh)
+                    for (auto & per_material : per_mesh.per_material)
+                        for (uint32_t i = 0, size = per_material.instances.size(); i != size; ++i)
+                            staging.set(per_material.offset + i, pack(per_material.instances[i]));
+        }
+        else
+        {
+            // the ranges of new buckets
+            if (staging.size() < buffer_size) staging.grow(buffer_size);
+
+            // added instances and the ones moved by remove(),
+            // removed handles are skipped
+            for (Handle handle : dirty_handles)
+            {
+                if (contains(handle)) packInstance(staging, handle, pack);
+            }
+
+            for (uint32_t transform_id : dirty_transforms)
+            {
+                auto range = transform_handles.equal_range(transform_id);
+                for (auto it = range.first; it != range.second; ++it)
+                    packInstance(staging, it->second, pack);
+            }
+        }
+
+        is_layout_dirty = false;
+        dirty_handles.clear();
+        dirty_transforms.clear();
+    }
+
+    // world boxes of the packed instances from the model boxes,
+    // GPUInstance::transform has to be the model to world matrix,
+    // the boxes of unused slots are left as they are
+    template <class GPUInstance>
+    void computeWorldBoxes(const InstanceStaging<GPUInstance> & staging,
+                           math::BoxBatch & boxes) const
+    {
+        boxes.resize(staging.size());
+        const GPUInstance * instances = staging.data();
+
+        for (auto & model : per_model)
+        {
+            math::BoundingBox box = model.model->getBox();
+
+            for (auto & per_mesh : model.per_mesh)
+                for (auto & per_material : per_mesh.per_material)
+                    for (uint32_t i = per_material.offset, end = i + per_material.instances.size(); i != end; ++i)
+                        boxes.set(i, math::transformBox(box, instances[i].transform));
+        }
+    }
+
+    // one packet per non-empty bucket, the depth of a packet is the depth
+    // of its nearest instance, boxes are from computeWorldBoxes()
+    void addDrawPackets(DrawQueue & queue, uint32_t shader, const math::BoxBatch & boxes) const
+    {
+        for (uint32_t m = 0, models_count = per_model.size(); m != models_count; ++m)
+        {
+            auto & meshes = per_model[m].per_mesh;
+
+            for (uint32_t mesh = 0, meshes_count = meshes.size(); mesh != meshes_count; ++mesh)
+            {
+                auto & per_materials = meshes[mesh].per_material;
+
+                for (uint32_t mat = 0, materials_count = per_materials.size(); mat != materials_count; ++mat)
+                {
+                    uint32_t index = per_materials[mat].offset;
+                    uint32_t instances_count = uint32_t(per_materials[mat].instances.size());
+                    if (instances_count == 0) continue;
+
+                    float depth = math::BoundingBox::inf;
+                    for (uint32_t i = index, end = index + instances_count; i != end; ++i)
+                        depth = std::min(depth, queue.getDepth(boxes.get(i)));
+
+                    uint64_t key = DrawQueue::makeOpaqueKey(DrawQueue::OPAQUE_PASS,
+                                                            shader,
+                                                            per_materials[mat].material_id,
+                                                            DrawQueue::getMeshID(m, mesh),
+                                                            depth);
+                    queue.add(key, {m, mesh, mat, index, instances_count});
+                }
+            }
+        }
+    }
+
+    // draws the sorted packets [begin, end) of the queue added by addDrawPackets()
+    // or by the owner of the group, the instance buffer has to be bound,
+    // the model is bound only when it changes,
+    // bind_mesh(Model::MeshRange &, const Material &, bool is_material_changed)
+    // is called when the mesh or the material differs from the previous packet
+    template <class BindMesh>
+    void renderPackets(const DrawQueue & queue, uint32_t begin, uint32_t end, BindMesh && bind_mesh) const
+    {
+        Globals * globals = Globals::getInstance();
+
+        uint32_t bound_model = UINT32_MAX;
+        uint32_t bound_mesh = UINT32_MAX;
+        uint32_t bound_material_id = UINT32_MAX;
+
+        for (uint32_t i = begin; i != end; ++i)
+        {
+            const DrawQueue::Packet & packet = queue.getPacket(i);
+
+            const PerModel & model = per_model[packet.model];
+            const PerMaterial & per_material = model.per_mesh[packet.mesh].per_material[packet.material];
+            Model::MeshRange & mesh_range = model.model->getMeshRange(packet.mesh);
+
+            bool is_model_changed = packet.model != bound_model;
+            bool is_material_changed = per_material.material_id != bound_material_id;
+
+            // bind vertex and index buffers
+            if (is_model_changed) model.model->bind();
+
+            if (is_model_changed || is_material_changed || packet.mesh != bound_mesh)
+                bind_mesh(mesh_range, per_material.material, is_material_changed);
+
+            bound_model = packet.model;
+            bound_mesh = packet.mesh;
+            bound_material_id = per_material.material_id;
+
+            globals->device_context4->DrawIndexedInstanced(mesh_range.index_count,
+                                                           packet.instances_count,
+                                                           mesh_range.index_offset,
+                                                           mesh_range.vertex_offset,
+                                                           packet.instances_offset);
+        }
+    }
+
+    // the used part of the range of each bucket in the draw order
+    void getBucketRanges(std::vector<InstanceRange> & ranges) const
+    {
+        ranges.clear();
+
+        for (auto & model : per_model)
+            for (auto & per_mesh : model.per_mesh)
+                for (auto & per_material : per_mesh.per_material)
+                    ranges.push_back({per_material.offset, uint32_t(per_material.instances.size())});
+    }
+
+    std::vector<PerModel> per_model;
+
+protected:
+    struct Slot
+    {
+        uint32_t per_material; // index in per_mesh[mesh].per_material
+        uint32_t index; // index in the instances of the bucket
+    };
+
+    struct Record
+    {
+        uint32_t model; // index in per_model
+        std::vector<Slot> slots; // one per mesh
+    };
+
+    // the handle has to be valid
+    Record & getRecord(Handle handle) { return records.template get<0>(handle); }
+    const Record & getRecord(Handle handle) const { return records.template get<0>(handle); }
+
+    template <class GPUInstance, class Pack>
+    void packInstance(InstanceStaging<GPUInstance> & staging, Handle handle, Pack && pack) const
+    {
+        const Record & record = getRecord(handle);
+
+        for (uint32_t i = 0, size = record.slots.size(); i != size; ++i)
+        {
+            const Slot & slot = record.slots[i];
+            const PerMaterial & bucket = per_model[record.model].per_mesh[i].per_material[slot.per_material];
+
+            staging.set(bucket.offset + slot.index, pack(bucket.instances[slot.index]));
+        }
+    }
+
+    void eraseTransformHandle(uint32_t transform_id, Handle handle)
+    {
+        auto range = transform_handles.equal_range(transform_id);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second != handle) continue;
+
+            transform_handles.erase(it);
+            return;
+        }
+    }
+
+    uint32_t internMaterial(const Material & material)
+    {
+        size_t hash = material.hash();
+
+        auto range = material_ids.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (materials[it->second] == material) return it->second;
+        }
+
+        uint32_t material_id = uint32_t(materials.size());
+        materials.push_back(material);
+        material_ids.emplace(hash, material_id);
+
+        return material_id;
+    }
+
+    std::unordered_map<const Model *, uint32_t> model_index; // index in per_model
+    math::SoASolidVector<Record> records; // handle -> instance slots
+
+    std::vector<Material> materials; // interned, index is the material ID
+    std::unordered_multimap<size_t, uint32_t> material_ids; // hash -> material ID
+
+    uint32_t buffer_size = 0; // the end of the last reserved range
+
+    bool is_layout_dirty = false;
+    std::vector<Handle> dirty_handles; // can contain removed handles
+    std::vector<uint32_t> dirty_transforms;
+
+    std::unordered_multimap<uint32_t, Handle> transform_handles; // transform ID -> instances
+};
+} // namespace engine
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef INSTANCE_STAGING_HPP
+#define INSTANCE_STAGING_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace engine
+{
+// consecutive instances of the buffer
+struct InstanceRange
+{
+    uint32_t begin;
+    uint32_t count;
+};
+
+// CPU copy of an instance buffer which remembers what was changed since
+// the last upload, so only these ranges are sent to GPU.
+// Doesn't depend on D3D, see InstanceBuffer for the GPU side.
+template <class T>
+class InstanceStaging
+{
+public:
+    static constexpr uint32_t MIN_CAPACITY = 64;
+
+    // dirty indices closer than this are uploaded as one range,
+    // it's cheaper than an additional UpdateSubresource() call
+    static constexpr uint32_t MERGE_GAP = 16;
+
+    struct Range
+    {
+        uint32_t begin;
+        uint32_t end; // exclusive
+    };
+
+    // capacity is doubled when exceeded, the whole buffer becomes dirty
+    void resize(uint32_t size)
+    {
+        if (size > capacity)
+            capacity = std::max({size, capacity * 2, MIN_CAPACITY});
+
+        instances.resize(size);
+        is_all_dirty = true;
+    }
+
+    // keeps the instances and what is dirty, the new ones become dirty when set()
+    void grow(uint32_t size)
+    {
+        assert(size >= instances.size());
+
+        if (size > capacity)
+            capacity = std::max({size, capacity * 2, MIN_CAPACITY});
+
+        instances.resize(size);
+    }
+
+    void set(uint32_t index, const T & instance)
+    {
+        assert(index < instances.size());
+
+        instances[index] = instance;
+        if (!is_all_dirty) dirty_indices.push_back(index);
+    }
+
+    uint32_t size() const { return uint32_t(instances.size()); }
+    uint32_t getCapacity() const { return capacity; }
+    const T * data() const { return instances.data(); }
+
+    // e.g. the GPU buffer was recreated
+    void invalidate() { is_all_dirty = true; }
+
+    bool isDirty() const { return is_all_dirty || !dirty_indices.empty(); }
+
+    // sorted ranges which have to be uploaded
+    const std::vector<Range> & getDirtyRanges()
+    {
+        ranges.clear();
+
+        if (is_all_dirty)
+        {
+            if (!instances.empty()) ranges.push_back({0, size()});
+            return ranges;
+        }
+
+        std::sort(dirty_indices.begin(), dirty_indices.end());
+
+        for (uint32_t index : dirty_indices)
+        {
+            if (!ranges.empty() && index <= ranges.back().end + MERGE_GAP)
+                ranges.back().end = std::max(ranges.back().end, index + 1);
+            else
+                ranges.push_back({index, index + 1});
+        }
+
+        return ranges;
+    }
+
+    void clearDirty()
+    {
+        dirty_indices.clear();
+        is_all_dirty = false;
+    }
+
+protected:
+    std::vector<T> instances;
+    uint32_t capacity = 0;
+
+    std::vector<uint32_t> dirty_indices; // can contain duplicates
+    bool is_all_dirty = false;
+
+    std::vector<Range> ranges;
+};
+} // namespace engine
+
+#endif
@@ -0,0 +1,193 @@
+#include "light_clusters.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include "thread_pool.hpp"
+
+namespace
+{
+// NDC -> tile, clamped to the grid
+uint32_t toTile(float ndc, uint32_t tiles_count)
+{
+    int tile = int(std::floor((ndc * 0.5f + 0.5f) * tiles_count));
+    return uint32_t(std::min(std::max(tile, 0), int(tiles_count) - 1));
+}
+
+bool isSphereIntersectsBox(const engine::LightClusters::Sphere & sphere,
+                           const math::BoundingBox & box)
+{
+    glm::vec3 offset = glm::clamp(sphere.center, box.min, box.max) - sphere.center;
+
+    return glm::dot(offset, offset) <= sphere.radius * sphere.radius;
+}
+} // namespace
+
+namespace engine
+{
+void LightClusters::update(const glm::mat4 & view,
+                           const glm::mat4 & proj,
+                           const Sphere * lights,
+                           uint32_t lights_count)
+{
+    // reversed depth: proj[2][2] = n / (n - f), proj[3][2] = -f * n / (n - f)
+    float depth_scale = proj[2][2];
+    float depth_offset = proj[3][2];
+    float z_far = -depth_offset / depth_scale;
+    float z_near = depth_scale * z_far / (depth_scale - 1.0f);
+
+    if (z_near != near_depth || z_far != far_depth ||
+        proj[0][0] != proj_x || proj[1][1] != proj_y || boxes.empty())
+    {
+        near_depth = z_near;
+        far_depth = z_far;
+        proj_x = proj[0][0];
+        proj_y = proj[1][1];
+
+        updateBoxes();
+    }
+
+    view_lights.resize(lights_count);
+    for (uint32_t i = 0; i != lights_count; ++i)
+    {
+        view_lights[i].center = glm::vec3(view * glm::vec4(lights[i].center, 1.0f));
+        view_lights[i].radius = lights[i].radius;
+    }
+
+    clusters.resize(CLUSTERS_COUNT);
+
+    ThreadPool::getInstance()->parallelFor(
+        SLICES,
+        1,
+        [this](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t slice = begin; slice != end; ++slice)
+                buildSlice(slice);
+        });
+
+    // the slices are merged in order, so the lists are ordered by cluster
+    uint32_t slice_offsets[SLICES];
+    uint32_t indices_count = 0;
+    for (uint32_t slice = 0; slice != SLICES; ++slice)
+    {
+        slice_offsets[slice] = indices_count;
+        indices_count += uint32_t(slice_indices[slice].size());
+    }
+
+    indices.resize(indices_count);
+
+    ThreadPool::getInstance()->parallelFor(
+        SLICES,
+        1,
+        [this, &slice_offsets](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t slice = begin; slice != end; ++slice)
+            {
+                std::copy(slice_indices[slice].begin(),
+                          slice_indices[slice].end(),
+                          indices.begin() + slice_offsets[slice]);
+
+                Cluster * slice_clusters = clusters.data() + getClusterIndex(0, 0, slice);
+                for (uint32_t i = 0; i != TILES_X * TILES_Y; ++i)
+                    slice_clusters[i].offset += slice_offsets[slice];
+            }
+        });
+}
+
+void LightClusters::updateBoxes()
+{
+    slice_scale = SLICES / std::log(far_depth / near_depth);
+
+    for (uint32_t slice = 0; slice <= SLICES; ++slice)
+        slice_depths[slice] = near_depth * std::pow(far_depth / near_depth, float(slice) / SLICES);
+
+    boxes.resize(CLUSTERS_COUNT);
+
+    for (uint32_t slice = 0; slice != SLICES; ++slice)
+    {
+        float z0 = slice_depths[slice];
+        float z1 = slice_depths[slice + 1];
+
+        for (uint32_t y = 0; y != TILES_Y; ++y)
+        {
+            // view space y = ndc * depth / proj_y
+            float ndc_y0 = -1.0f + 2.0f * y / TILES_Y;
+            float ndc_y1 = -1.0f + 2.0f * (y + 1) / TILES_Y;
+
+            for (uint32_t x = 0; x != TILES_X; ++x)
+            {
+                float ndc_x0 = -1.0f + 2.0f * x / TILES_X;
+                float ndc_x1 = -1.0f + 2.0f * (x + 1) / TILES_X;
+
+                math::BoundingBox & box = boxes[getClusterIndex(x, y, slice)];
+
+                box.min.x = std::min(ndc_x0 * z0, ndc_x0 * z1) / proj_x;
+                box.max.x = std::max(ndc_x1 * z0, ndc_x1 * z1) / proj_x;
+                box.min.y = std::min(ndc_y0 * z0, ndc_y0 * z1) / proj_y;
+                box.max.y = std::max(ndc_y1 * z0, ndc_y1 * z1) / proj_y;
+                box.min.z = z0;
+                box.max.z = z1;
+            }
+        }
+    }
+}
+
+void LightClusters::buildSlice(uint32_t slice)
+{
+    float z0 = slice_depths[slice];
+    float z1 = slice_depths[slice + 1];
+
+    // tiles covered by the part of each light inside of the slice
+    std::vector<Candidate> & candidates = slice_candidates[slice];
+    candidates.clear();
+
+    for (uint32_t i = 0, size = view_lights.size(); i != size; ++i)
+    {
+        const Sphere & light = view_lights[i];
+
+        float depth_min = std::max(z0, light.center.z - light.radius);
+        float depth_max = std::min(z1, light.center.z + light.radius);
+        if (depth_min > depth_max) continue;
+
+        // the projection of the light box is the widest at one of the depths
+        float x_min = light.center.x - light.radius;
+        float x_max = light.center.x + light.radius;
+        float y_min = light.center.y - light.radius;
+        float y_max = light.center.y + light.radius;
+
+        float ndc_x_min = proj_x * std::min(x_min / depth_min, x_min / depth_max);
+        float ndc_x_max = proj_x * std::max(x_max / depth_min, x_max / depth_max);
+        float ndc_y_min = proj_y * std::min(y_min / depth_min, y_min / depth_max);
+        float ndc_y_max = proj_y * std::max(y_max / depth_min, y_max / depth_max);
+
+        if (ndc_x_max < -1.0f || ndc_x_min > 1.0f ||
+            ndc_y_max < -1.0f || ndc_y_min > 1.0f) continue;
+
+        candidates.push_back({i,
+                              toTile(ndc_x_min, TILES_X), toTile(ndc_x_max, TILES_X),
+                              toTile(ndc_y_min, TILES_Y), toTile(ndc_y_max, TILES_Y)});
+    }
+
+    std::vector<uint32_t> & dst = slice_indices[slice];
+    dst.clear();
+
+    for (uint32_t y = 0; y != TILES_Y; ++y)
+    {
+        for (uint32_t x = 0; x != TILES_X; ++x)
+        {
+            uint32_t cluster = getClusterIndex(x, y, slice);
+            uint32_t offset = uint32_t(dst.size());
+
+            for (const Candidate & candidate : candidates)
+            {
+                if (x < candidate.min_x || x > candidate.max_x ||
+                    y < candidate.min_y || y > candidate.max_y) continue;
+
+                if (isSphereIntersectsBox(view_lights[candidate.light], boxes[cluster]))
+                    dst.push_back(candidate.light);
+            }
+
+            clusters[cluster] = {offset, uint32_t(dst.size()) - offset};
+        }
+    }
+}
+} // namespace engine
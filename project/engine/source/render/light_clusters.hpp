@@ -0,0 +1,91 @@
+#ifndef LIGHT_CLUSTERS_HPP
+#define LIGHT_CLUSTERS_HPP
+
+#include "glm.hpp"
+#include <vector>
+#include <cstdint>
+
+#include "box.hpp"
+
+namespace engine
+{
+// Clustered (froxel) light culling on CPU: the view frustum is split into
+// TILES_X * TILES_Y screen tiles and SLICES exponential depth slices,
+// every cluster gets a compact list of the point lights whose bounding spheres
+// intersect the view space box of the cluster.
+// getClusters()[cluster] is a range in getIndices(), both are uploaded as they are.
+// Slices are built in parallel. Doesn't depend on D3D.
+class LightClusters
+{
+public:
+    static constexpr uint32_t TILES_X = 16;
+    static constexpr uint32_t TILES_Y = 9;
+    static constexpr uint32_t SLICES = 24;
+    static constexpr uint32_t CLUSTERS_COUNT = TILES_X * TILES_Y * SLICES;
+
+    struct Cluster
+    {
+        uint32_t offset; // in getIndices()
+        uint32_t count;
+    };
+
+    // in world space
+    struct Sphere
+    {
+        glm::vec3 center;
+        float radius;
+    };
+
+    // view and reversed depth proj of the camera, see Camera::setPerspective()
+    void update(const glm::mat4 & view,
+                const glm::mat4 & proj,
+                const Sphere * lights,
+                uint32_t lights_count);
+
+    // tile (0, 0) is the bottom left corner of the screen
+    static uint32_t getClusterIndex(uint32_t tile_x, uint32_t tile_y, uint32_t slice)
+    {
+        return (slice * TILES_Y + tile_y) * TILES_X + tile_x;
+    }
+
+    // slice = floor(log(depth / near) * slice_scale)
+    float getNear() const { return near_depth; }
+    float getSliceScale() const { return slice_scale; }
+
+    const std::vector<Cluster> & getClusters() const { return clusters; }
+    const std::vector<uint32_t> & getIndices() const { return indices; }
+
+protected:
+    struct Candidate
+    {
+        uint32_t light;
+        uint32_t min_x, max_x;
+        uint32_t min_y, max_y;
+    };
+
+    // boxes depend only on the projection
+    void updateBoxes();
+
+    void buildSlice(uint32_t slice);
+
+    float near_depth = 0.0f;
+    float far_depth = 0.0f;
+    float slice_scale = 0.0f;
+    float proj_x = 0.0f; // proj[0][0]
+    float proj_y = 0.0f; // proj[1][1]
+
+    float slice_depths[SLICES + 1];
+    std::vector<math::BoundingBox> boxes; // view space, per cluster
+
+    std::vector<Sphere> view_lights; // view space
+
+    std::vector<Cluster> clusters;
+    std::vector<uint32_t> indices;
+
+    // per slice, the offsets of the clusters are local until merged
+    std::vector<Candidate> slice_candidates[SLICES];
+    std::vector<uint32_t> slice_indices[SLICES];
+};
+} // namespace engine
+
+#endif
@@ -1,9 +1,75 @@
 #include "light_system.hpp"
 
+#include <algorithm>
+#include "transform_system.hpp"
+#include "camera.hpp"
+
 namespace
 {
 constexpr int SHADOW_MAP_SIZE = 1024;
 constexpr uint32_t SHADOW_CUBEMAPS_COUNT = 4;
+
+// the point lights have no falloff radius, so the light range is
+// the distance where its irradiance drops below this
+constexpr float POINT_LIGHT_MIN_IRRADIANCE = 0.05f;
+
+// E = L * solid_angle, solid_angle ~ PI * r^2 / d^2 far from the light
+float calculatePointLightRange(const glm::vec3 & radiance, float radius)
+{
+    float max_radiance = std::max(radiance.x, std::max(radiance.y, radiance.z));
+
+    return radius * std::sqrt(3.14159265f * max_radiance / POINT_LIGHT_MIN_IRRADIANCE);
+}
+
+// reversed depth projection with 90 degrees fov and aspect 1 shared by all the faces,
+// the same as Camera::setPerspective(), x and y are not scaled
+constexpr float SHADOW_DEPTH_SCALE = engine::LightSystem::SHADOW_NEAR /
+                                     (engine::LightSystem::SHADOW_NEAR - engine::LightSystem::SHADOW_FAR);
+constexpr float SHADOW_DEPTH_OFFSET = -engine::LightSystem::SHADOW_FAR * engine::LightSystem::SHADOW_NEAR /
+                                      (engine::LightSystem::SHADOW_NEAR - engine::LightSystem::SHADOW_FAR);
+
+// basis of the face cameras, the same as Camera::generateCubemapCameras()
+struct CubemapFace
+{
+    float right[3];
+    float up[3];
+    float forward[3];
+};
+
+constexpr CubemapFace CUBEMAP_FACES[6] =
+{
+    {{ 0.0f, 0.0f, -1.0f}, {0.0f, 1.0f,  0.0f}, { 1.0f,  0.0f,  0.0f}}, // +x
+    {{ 0.0f, 0.0f,  1.0f}, {0.0f, 1.0f,  0.0f}, {-1.0f,  0.0f,  0.0f}}, // -x
+    {{ 1.0f, 0.0f,  0.0f}, {0.0f, 0.0f, -1.0f}, { 0.0f,  1.0f,  0.0f}}, // +y
+    {{ 1.0f, 0.0f,  0.0f}, {0.0f, 0.0f,  1.0f}, { 0.0f, -1.0f,  0.0f}}, // -y
+    {{ 1.0f, 0.0f,  0.0f}, {0.0f, 1.0f,  0.0f}, { 0.0f,  0.0f,  1.0f}}, // +z
+    {{-1.0f, 0.0f,  0.0f}, {0.0f, 1.0f,  0.0f}, { 0.0f,  0.0f, -1.0f}}, // -z
+};
+
+float dot(const float * a, const glm::vec3 & b)
+{
+    return a[0] * b.x + a[1] * b.y + a[2] * b.z;
+}
+
+// proj * view of the face camera, the view matrix is the inverse of the orthonormal basis
+void computeFaceViewProj(const CubemapFace & face,
+                         const glm::vec3 & position,
+                         glm::mat4 & view_proj)
+{
+    const float * r = face.right;
+    const float * u = face.up;
+    const float * f = face.forward;
+
+    view_proj[0] = glm::vec4(r[0], u[0], SHADOW_DEPTH_SCALE * f[0], f[0]);
+    view_proj[1] = glm::vec4(r[1], u[1], SHADOW_DEPTH_SCALE * f[1], f[1]);
+    view_proj[2] = glm::vec4(r[2], u[2], SHADOW_DEPTH_SCALE * f[2], f[2]);
+
+    float depth = -dot(f, position);
+    view_proj[3] = glm::vec4(-dot(r, position),
+                             -dot(u, position),
+                             SHADOW_DEPTH_SCALE * depth + SHADOW_DEPTH_OFFSET,
+                             depth);
+}
 } // namespace
 
 
@@ -52,6 +118,7 @@ void LightSystem::addPointLight(uint32_t transform_id,
                                 float radius)
 {
     PointLight point_light(transform_id, radiance, radius);
+    point_light.range = std::max(calculatePointLightRange(radiance, radius), radius);
 
     point_lights.push_back(point_light);
 }
@@ -123,6 +190,21 @@ void LightSystem::initShadowMap(int size)
                                                       shadow_map_dsv.reset());
     assert(result >= 0 && "CreateDepthStencilView");
 
+    shadow_face_dsvs.resize(6 * SHADOW_CUBEMAPS_COUNT);
+    for (uint32_t i = 0, size = shadow_face_dsvs.size(); i != size; ++i)
+    {
+        dsv_desc.Texture2DArray.ArraySize = 1;
+        dsv_desc.Texture2DArray.FirstArraySlice = i;
+
+        result = globals->device5->CreateDepthStencilView(shadow_map.ptr(),
+                                                          &dsv_desc,
+                                                          shadow_face_dsvs[i].reset());
+        assert(result >= 0 && "CreateDepthStencilView");
+    }
+
+    // the new shadow map is empty
+    shadow_cache.invalidate();
+
     D3D11_DEPTH_STENCIL_DESC dss_desc;
     ZeroMemory(&dss_desc, sizeof(dss_desc));
     dss_desc.DepthEnable = true;
@@ -151,22 +233,28 @@ void LightSystem::initShadowMap(int size)
 void LightSystem::clearShadowMap()
 {
     Globals * globals = Globals::getInstance();
-    
-    // fill depth buffer with 0
-    globals->device_context4->ClearDepthStencilView(shadow_map_dsv.ptr(),
-                                                    D3D11_CLEAR_DEPTH |
-                                                    D3D11_CLEAR_STENCIL,
-                                                    0.0f, // reversed depth
-                                                    0);
+
+    for (uint32_t c = 0, size = shadow_cache.getCubemapsCount(); c != size; ++c)
+    {
+        for (uint32_t face = 0; face != ShadowCache::FACES_COUNT; ++face)
+        {
+            if (!shadow_cache.isFaceInvalid(c, face)) continue;
+
+            // fill depth buffer with 0
+            globals->device_context4->ClearDepthStencilView(shadow_face_dsvs[6 * c + face].ptr(),
+                                                            D3D11_CLEAR_DEPTH |
+                                                            D3D11_CLEAR_STENCIL,
+                                                            0.0f, // reversed depth
+                                                            0);
+        }
+    }
 }
 
 void LightSystem::bindShadowMap()
 {
     Globals * globals = Globals::getInstance();
 
-    globals->device_context4->OMSetRenderTargets(0,
-                                                 nullptr,
-                                                 shadow_map_dsv.ptr());
+    globals->bindRenderTargets(0, nullptr, shadow_map_dsv.ptr());
     
     globals->device_context4->OMSetDepthStencilState(shadow_map_dss.ptr(),
                                                      0);
@@ -176,9 +264,7 @@ void LightSystem::bindShadowMapSRV(int slot)
 {
     Globals * globals = Globals::getInstance();
     
-    globals->device_context4->PSSetShaderResources(slot,
-                                                   1,
-                                                   shadow_map_srv.get());
+    globals->bindPSShaderResources(slot, 1, shadow_map_srv.get());
 }
 
 const std::vector<LightSystem::DirectionalLight> & LightSystem::getDirectionalLights() const
@@ -190,4 +276,154 @@ const std::vector<LightSystem::PointLight> & LightSystem::getPointLights() const
 {
     return point_lights;
 }
+
+void LightSystem::updateShadowCubemaps()
+{
+    TransformSystem * trans_system = TransformSystem::getInstance();
+
+    uint32_t cached_count = shadow_cubemaps.size();
+    shadow_cubemaps.resize(std::min(uint32_t(point_lights.size()), SHADOW_CUBEMAPS_COUNT));
+
+    for (uint32_t i = 0, size = shadow_cubemaps.size(); i != size; ++i)
+    {
+        ShadowCubemap & cubemap = shadow_cubemaps[i];
+        glm::vec3 position = trans_system->getWorld(point_lights[i].transform_id)[3];
+
+        // the matrices depend only on the light position
+        if (i < cached_count && position == cubemap.position) continue;
+
+        cubemap.position = position;
+
+        for (uint32_t face = 0; face != 6; ++face)
+        {
+            computeFaceViewProj(CUBEMAP_FACES[face], position, cubemap.view_proj[face]);
+            cubemap.faces[face] = math::Frustum::fromViewProj(cubemap.view_proj[face]);
+        }
+    }
+
+    glm::vec3 positions[SHADOW_CUBEMAPS_COUNT];
+    for (uint32_t i = 0, size = shadow_cubemaps.size(); i != size; ++i)
+        positions[i] = shadow_cubemaps[i].position;
+
+    shadow_cache.begin(positions, uint32_t(shadow_cubemaps.size()));
+}
+
+const std::vector<LightSystem::ShadowCubemap> & LightSystem::getShadowCubemaps() const
+{
+    return shadow_cubemaps;
+}
+
+ShadowCache & LightSystem::getShadowCache()
+{
+    return shadow_cache;
+}
+
+void LightSystem::updateLightClusters(const Camera & camera)
+{
+    TransformSystem * trans_system = TransformSystem::getInstance();
+
+    light_spheres.resize(point_lights.size());
+    gpu_point_lights.resize(point_lights.size());
+
+    for (uint32_t i = 0, size = point_lights.size(); i != size; ++i)
+    {
+        const PointLight & light = point_lights[i];
+        glm::vec3 position = trans_system->getWorld(light.transform_id)[3];
+
+        light_spheres[i] = {position, light.range};
+        gpu_point_lights[i] = {position, light.radius, light.radiance, light.range};
+    }
+
+    light_clusters.update(camera.getView(),
+                          camera.getProj(),
+                          light_spheres.data(),
+                          uint32_t(light_spheres.size()));
+
+    auto & clusters = light_clusters.getClusters();
+    auto & indices = light_clusters.getIndices();
+
+    uploadStructuredBuffer(point_lights_buffer,
+                           gpu_point_lights.data(),
+                           sizeof(GPUPointLight),
+                           uint32_t(gpu_point_lights.size()));
+
+    uploadStructuredBuffer(clusters_buffer,
+                           clusters.data(),
+                           sizeof(LightClusters::Cluster),
+                           uint32_t(clusters.size()));
+
+    uploadStructuredBuffer(light_indices_buffer,
+                           indices.data(),
+                           sizeof(uint32_t),
+                           uint32_t(indices.size()));
+}
+
+const LightClusters & LightSystem::getLightClusters() const
+{
+    return light_clusters;
+}
+
+void LightSystem::bindLightClustersSRV(int slot)
+{
+    Globals * globals = Globals::getInstance();
+
+    ID3D11ShaderResourceView * srvs[3] = {point_lights_buffer.srv.ptr(),
+                                          clusters_buffer.srv.ptr(),
+                                          light_indices_buffer.srv.ptr()};
+
+    globals->bindPSShaderResources(slot, 3, srvs);
+}
+
+void LightSystem::uploadStructuredBuffer(StructuredBuffer & dst,
+                                         const void * data,
+                                         uint32_t stride,
+                                         uint32_t count)
+{
+    HRESULT result;
+    Globals * globals = Globals::getInstance();
+
+    // empty buffers can't be created
+    if (std::max(count, 1u) > dst.capacity)
+    {
+        dst.capacity = std::max({count, dst.capacity * 2, 1u});
+
+        D3D11_BUFFER_DESC sb_desc;
+        ZeroMemory(&sb_desc, sizeof(sb_desc));
+        sb_desc.ByteWidth = dst.capacity * stride;
+        sb_desc.Usage = D3D11_USAGE_DYNAMIC;
+        sb_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        sb_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        sb_desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+        sb_desc.StructureByteStride = stride;
+
+        result = globals->device5->CreateBuffer(&sb_desc,
+                                                nullptr,
+                                                dst.buffer.reset());
+        assert(result >= 0 && "CreateBuffer");
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc;
+        ZeroMemory(&srv_desc, sizeof(srv_desc));
+        srv_desc.Format = DXGI_FORMAT_UNKNOWN;
+        srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        srv_desc.Buffer.FirstElement = 0;
+        srv_desc.Buffer.NumElements = dst.capacity;
+
+        result = globals->device5->CreateShaderResourceView(dst.buffer.ptr(),
+                                                            &srv_desc,
+                                                            dst.srv.reset());
+        assert(result >= 0 && "CreateShaderResourceView");
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    result = globals->device_context4->Map(dst.buffer.ptr(),
+                                           0,
+                                           D3D11_MAP_WRITE_DISCARD,
+                                           0,
+                                           &mapped);
+    assert(result >= 0 && "Map");
+
+    if (count != 0) memcpy(mapped.pData, data, size_t(count) * stride);
+
+    globals->device_context4->Unmap(dst.buffer.ptr(), 0);
+}
 } // namespace engine
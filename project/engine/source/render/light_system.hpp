@@ -10,6 +10,11 @@
 
 #include "constants.hpp"
 #include "globals.hpp"
+#include "frustum.hpp"
+#include "shadow_cache.hpp"
+#include "light_clusters.hpp"
+
+class Camera;
 
 namespace engine
 {
@@ -46,9 +51,23 @@ private:
         uint32_t transform_id;
         glm::vec3 radiance;
         float radius;
+        float range; // the light is ignored farther than this
     };
     
-public:    
+public:
+    // depth range of the point light shadow cubemaps
+    static constexpr float SHADOW_NEAR = 0.1f;
+    static constexpr float SHADOW_FAR = 1000.0f;
+
+    // faces are in the order of Camera::generateCubemapCameras(),
+    // recomputed only when the light is moved
+    struct ShadowCubemap
+    {
+        glm::vec3 position;
+        glm::mat4 view_proj[6];
+        math::Frustum faces[6];
+    };
+
     // deleted methods should be public for better error messages
     LightSystem(const LightSystem & other) = delete;
     void operator=(const LightSystem & other) = delete;
@@ -78,10 +97,26 @@ public:
     void bindSquareViewport();
 
     void initShadowMap(int size);
+    // only the faces invalidated in the shadow cache
     void clearShadowMap();
     void bindShadowMap();
 
     void bindShadowMapSRV(int slot);
+
+    // has to be called after the point lights were moved and before
+    // Globals::setPerFrameBuffer(), starts a frame of the shadow cache
+    void updateShadowCubemaps();
+    const std::vector<ShadowCubemap> & getShadowCubemaps() const;
+
+    ShadowCache & getShadowCache();
+
+    // point lights are assigned to the clusters of the camera frustum,
+    // the lights and the cluster lists are uploaded for the lighting shaders
+    void updateLightClusters(const Camera & camera);
+    const LightClusters & getLightClusters() const;
+
+    // lights, clusters and light indices at slot, slot + 1 and slot + 2
+    void bindLightClustersSRV(int slot);
     
     const std::vector<DirectionalLight> & getDirectionalLights() const;
     const std::vector<PointLight> & getPointLights() const;
@@ -94,13 +129,46 @@ private:
 
     std::vector<DirectionalLight> directional_lights;
     std::vector<PointLight> point_lights;
+    std::vector<ShadowCubemap> shadow_cubemaps; // one per point light with a shadow
+    ShadowCache shadow_cache;
 
     D3D11_VIEWPORT shadow_map_viewport;
 
     DxResPtr<ID3D11Texture2D> shadow_map;
     DxResPtr<ID3D11DepthStencilView> shadow_map_dsv;
+    std::vector<DxResPtr<ID3D11DepthStencilView>> shadow_face_dsvs; // for clearing a single face
     DxResPtr<ID3D11DepthStencilState> shadow_map_dss;
     DxResPtr<ID3D11ShaderResourceView> shadow_map_srv;
+
+    // the same layout as PointLight in lighting.hlsl
+    struct GPUPointLight
+    {
+        glm::vec3 position;
+        float radius;
+        glm::vec3 radiance;
+        float range;
+    };
+
+    struct StructuredBuffer
+    {
+        DxResPtr<ID3D11Buffer> buffer;
+        DxResPtr<ID3D11ShaderResourceView> srv;
+        uint32_t capacity = 0;
+    };
+
+    // recreates the buffer only when it's too small
+    void uploadStructuredBuffer(StructuredBuffer & dst,
+                                const void * data,
+                                uint32_t stride,
+                                uint32_t count);
+
+    LightClusters light_clusters;
+    std::vector<LightClusters::Sphere> light_spheres;
+    std::vector<GPUPointLight> gpu_point_lights;
+
+    StructuredBuffer point_lights_buffer;
+    StructuredBuffer clusters_buffer;
+    StructuredBuffer light_indices_buffer;
 };
 } // namespace engine
 
@@ -3,6 +3,49 @@
 namespace
 {
 constexpr uint32_t shadow_cubemaps_count = 4;
+
+// shader field of the draw keys
+constexpr uint32_t OPAQUE_SHADER = 0;
+constexpr uint32_t DISSOLUTION_SHADER = 1;
+constexpr uint32_t DISAPPEAR_SHADER = 2;
+
+constexpr uint32_t INSTANCE_TREE_LEAF_SIZE = 1;
+// the tree is built with INSTANCE_TREE_STACK_SIZE - 1 levels at most
+constexpr uint32_t INSTANCE_TREE_STACK_SIZE = 64;
+
+// intersects the lanes from the mask with one mesh of the instance,
+// returns mask of rays which found a nearer intersection
+uint32_t intersectMesh(const math::Ray * rays_ws,
+                       uint32_t rays_count,
+                       uint32_t mask,
+                       const math::TriangleBVH & bvh,
+                       const glm::mat4 & world_to_mesh,
+                       const glm::mat4 & mesh_to_world,
+                       math::MeshIntersection * nearest,
+                       glm::vec3 * pos_ws)
+{
+    // TriangleBVH stores vertices in mesh space
+    math::RayPacket packet;
+    packet.clear();
+    for (uint32_t r = 0; r != rays_count; ++r)
+    {
+        if (!(mask & (1u << r))) continue;
+
+        packet.set(r, math::Ray(
+            glm::vec3(world_to_mesh * glm::vec4(rays_ws[r].origin, 1.0f)),
+            glm::vec3(world_to_mesh * glm::vec4(rays_ws[r].direction, 0.0f))));
+    }
+
+    uint32_t found = bvh.intersect(packet, nearest);
+
+    for (uint32_t r = 0; r != rays_count; ++r)
+    {
+        if (found & (1u << r))
+            pos_ws[r] = mesh_to_world * glm::vec4(nearest[r].pos, 1.0f);
+    }
+
+    return found;
+}
 } // namespace
 
 
@@ -40,6 +83,15 @@ uint32_t MeshSystem::getModelID()
     return id;
 }
 
+InstanceHandle MeshSystem::findOpaqueInstance(uint32_t id) const
+{
+    auto found = opaque_handles.find(id);
+    if (found == opaque_handles.end() || !opaque_instances.group.contains(found->second))
+        return INVALID_INSTANCE_HANDLE;
+
+    return found->second;
+}
+
 void MeshSystem::setShaders(std::shared_ptr<Shader> opaque,
                             std::shared_ptr<Shader> disappear,
                             std::shared_ptr<Shader> emissive,
@@ -63,11 +115,47 @@ void MeshSystem::setTextures(std::shared_ptr<Texture> dissolve,
     instance->disappear_instances.noise = noise;
 }
 
-void MeshSystem::render()
+bool MeshSystem::hasPendingWork() const
 {
-    opaque_instances.render();
-    dissolution_instances.render();
-    disappear_instances.render();
+    return dissolution_instances.group.size() != 0 ||
+           disappear_instances.group.size() != 0;
+}
+
+void MeshSystem::render(const math::Frustum & frustum,
+                        const glm::vec3 & view_pos,
+                        const glm::vec3 & view_dir)
+{
+    draw_queue.clear(view_pos, view_dir);
+
+    opaque_instances.cull(frustum, draw_queue, OPAQUE_SHADER);
+    dissolution_instances.addDrawPackets(draw_queue, DISSOLUTION_SHADER);
+    disappear_instances.addDrawPackets(draw_queue, DISAPPEAR_SHADER);
+
+    draw_queue.sort();
+
+    // the packets of one shader are contiguous
+    for (uint32_t begin = 0, size = draw_queue.size(); begin != size;)
+    {
+        uint32_t shader = DrawQueue::getShader(draw_queue.getKey(begin));
+
+        uint32_t end = begin + 1;
+        while (end != size && DrawQueue::getShader(draw_queue.getKey(end)) == shader) ++end;
+
+        switch (shader)
+        {
+        case OPAQUE_SHADER:
+            opaque_instances.render(draw_queue, begin, end);
+            break;
+        case DISSOLUTION_SHADER:
+            dissolution_instances.render(draw_queue, begin, end);
+            break;
+        case DISAPPEAR_SHADER:
+            disappear_instances.render(draw_queue, begin, end);
+            break;
+        }
+
+        begin = end;
+    }
 }
 
 void MeshSystem::renderLights()
@@ -75,114 +163,322 @@ void MeshSystem::renderLights()
     emissive_instances.render();
 }
 
-void MeshSystem::renderShadowCubeMaps(int cubemaps_count)
+void MeshSystem::updateShadowCasters(int cubemaps_count, ShadowCache & cache)
+{
+    opaque_instances.updateShadowCasters(cubemaps_count, cache);
+    dissolution_instances.updateShadowCasters(cubemaps_count, cache);
+    disappear_instances.updateShadowCasters(cubemaps_count, cache);
+}
+
+void MeshSystem::renderShadowCubeMaps(const ShadowCache & cache)
 {
     Globals * globals = Globals::getInstance();
     
     shadow_shader->bind();
-    opaque_instances.renderWithoutMaterials(cubemaps_count);
-    dissolution_instances.renderWithoutMaterials(cubemaps_count);
-    disappear_instances.renderWithoutMaterials(cubemaps_count);
+    opaque_instances.renderWithoutMaterials(cache);
+    dissolution_instances.renderWithoutMaterials(cache);
+    disappear_instances.renderWithoutMaterials(cache);
 }
 
-bool MeshSystem::findIntersection(const math::Ray & ray_ws,
-                                  math::MeshIntersection & nearest)
+void MeshSystem::updateInstanceTree()
 {
+    if (!is_instance_tree_dirty) return;
+    is_instance_tree_dirty = false;
+
     TransformSystem * trans_system = TransformSystem::getInstance();
 
-    glm::vec3 pos_ws;
-    
-    for (auto & model: opaque_instances.per_model)
-    {
-        auto & octree = model.model->getOctree();
-        auto & mesh_ranges = model.model->getMeshRanges();
+    std::vector<InstanceTreeItem> items;
 
+    for (auto & model: opaque_instances.group.per_model)
+    {
         for (uint32_t i = 0, size = model.per_mesh.size(); i != size; ++i)
         {
-            auto & mesh = model.per_mesh[i];
-            
-            for (auto & material: mesh.per_material)
+            for (auto & material: model.per_mesh[i].per_material)
             {
                 for (auto & instance: material.instances)
                 {
-                    glm::mat4 mesh_to_model = mesh_ranges[i].mesh_to_model;
-                    glm::mat4 transform =
-                        trans_system->transforms[instance.transform_id].toMat4();
-
-                    glm::mat4 mesh_to_model_inv = glm::inverse(mesh_to_model);
-                    glm::mat4 transform_inv = glm::inverse(transform);
-                                        
-                    // TriangleOctree stores vertices in mesh space
-                    math::Ray ray_ms;
-                    ray_ms.origin = mesh_to_model_inv *
-                                    transform_inv *
-                                    glm::vec4(ray_ws.origin, 1.0f);
-                    ray_ms.direction = mesh_to_model_inv *
-                                       transform_inv *
-                                       glm::vec4(ray_ws.direction, 0.0f);
-
-                    if (octree[i].intersect(ray_ms, nearest))
-                    {
-                        nearest.transform_id = instance.transform_id;
-                        nearest.model_id = instance.model_id;
-                        nearest.box = instance.box;
+                    InstanceTreeItem item;
+                    item.model = model.model.get();
+                    item.mesh_index = i;
+                    item.transform_id = instance.transform_id;
+                    item.model_id = instance.model_id;
+                    item.model_box = instance.box;
+                    item.is_opaque = true;
+                    item.mesh_to_world =
+                        glm::mat4(trans_system->getWorld(instance.transform_id)) *
+                        model.model->getMeshRange(i).mesh_to_model;
+                    item.world_to_mesh = glm::inverse(item.mesh_to_world);
 
-                        pos_ws = transform *
-                                 mesh_to_model *
-                                 glm::vec4(nearest.pos, 1.0f);
-                    }
+                    items.push_back(item);
                 }
             }
-        } 
+        }
     }
 
-    for (auto & model: emissive_instances.per_model)
+    for (auto & model: emissive_instances.group.per_model)
     {
-        auto & octree = model.model->getOctree();
-        auto & mesh_ranges = model.model->getMeshRanges();
-
         for (uint32_t i = 0, size = model.per_mesh.size(); i != size; ++i)
         {
-            auto & mesh = model.per_mesh[i];
-            
-            for (auto & material: mesh.per_material)
+            for (auto & material: model.per_mesh[i].per_material)
             {
                 for (auto & instance: material.instances)
                 {
-                    glm::mat4 mesh_to_model = mesh_ranges[i].mesh_to_model;
-                    glm::mat4 transform =
-                        trans_system->transforms[instance.transform_id].toMat4();
-
-                    glm::mat4 mesh_to_model_inv = glm::inverse(mesh_to_model);
-                    glm::mat4 transform_inv = glm::inverse(transform);
-
-                    // TriangleOctree stores vertices in mesh space
-                    math::Ray ray_ms;
-                    ray_ms.origin = mesh_to_model_inv *
-                                    transform_inv *
-                                    glm::vec4(ray_ws.origin, 1.0f);
-                    ray_ms.direction = mesh_to_model_inv *
-                                       transform_inv *
-                                       glm::vec4(ray_ws.direction, 0.0f);
-
-                    if (octree[i].intersect(ray_ms, nearest))
-                    {
-                        nearest.transform_id = instance.transform_id;
+                    InstanceTreeItem item;
+                    item.model = model.model.get();
+                    item.mesh_index = i;
+                    item.transform_id = instance.transform_id;
+                    item.is_opaque = false;
+                    item.mesh_to_world =
+                        glm::mat4(trans_system->getWorld(instance.transform_id)) *
+                        model.model->getMeshRange(i).mesh_to_model;
+                    item.world_to_mesh = glm::inverse(item.mesh_to_world);
 
-                        pos_ws = transform *
-                                 mesh_to_model *
-                                 glm::vec4(nearest.pos, 1.0f);
-                    }
+                    items.push_back(item);
                 }
             }
-        } 
+        }
+    }
+
+    std::vector<math::BoundingBox> boxes(items.size());
+    std::vector<glm::vec3> centers(items.size());
+    for (uint32_t i = 0, size = items.size(); i != size; ++i)
+    {
+        boxes[i] = math::transformBox(items[i].model->getMeshRange(items[i].mesh_index).box,
+                                items[i].mesh_to_world);
+        centers[i] = boxes[i].center();
+    }
+
+    std::vector<uint32_t> indices;
+    math::buildBVH(boxes,
+                   centers,
+                   INSTANCE_TREE_LEAF_SIZE,
+                   instance_tree,
+                   indices,
+                   INSTANCE_TREE_STACK_SIZE - 1);
+
+    // store items in leaf order
+    instance_tree_items.resize(items.size());
+    for (uint32_t i = 0, size = items.size(); i != size; ++i)
+        instance_tree_items[i] = items[indices[i]];
+}
+
+bool MeshSystem::intersectInstance(const math::Ray & ray_ws,
+                                   const InstanceTreeItem & item,
+                                   math::MeshIntersection & nearest,
+                                   glm::vec3 & pos_ws)
+{
+    // TriangleBVH and TriangleOctree store vertices in mesh space
+    math::Ray ray_ms;
+    ray_ms.origin = item.world_to_mesh * glm::vec4(ray_ws.origin, 1.0f);
+    ray_ms.direction = item.world_to_mesh * glm::vec4(ray_ws.direction, 0.0f);
+
+    bool is_hit = use_octree ?
+        item.model->getOctree()[item.mesh_index].intersect(ray_ms, nearest) :
+        item.model->getBVH()[item.mesh_index].intersect(ray_ms, nearest);
+
+    if (!is_hit) return false;
+
+    nearest.transform_id = item.transform_id;
+    if (item.is_opaque)
+    {
+        nearest.model_id = item.model_id;
+        nearest.box = item.model_box;
     }
 
-    if (!nearest.valid()) return false;
+    pos_ws = item.mesh_to_world * glm::vec4(nearest.pos, 1.0f);
+
+    return true;
+}
+
+bool MeshSystem::findIntersection(const math::Ray & ray_ws,
+                                  math::MeshIntersection & nearest)
+{
+    updateInstanceTree();
+
+    if (instance_tree.empty()) return false;
+
+    // ray t is the same in world and mesh spaces,
+    // so nearest.t prunes the instance tree too
+    glm::vec3 direction_inv = 1.0f / ray_ws.direction;
+
+    if (!std::isfinite(math::intersectNode(ray_ws.origin,
+                                           direction_inv,
+                                           instance_tree[0],
+                                           nearest.t))) return false;
+
+    glm::vec3 pos_ws;
+    bool found = false;
+
+    uint32_t stack[INSTANCE_TREE_STACK_SIZE];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+
+    while (stack_size != 0)
+    {
+        const math::BVHNode & node = instance_tree[stack[--stack_size]];
+
+        if (node.isLeaf())
+        {
+            for (uint32_t i = node.left_first; i != node.left_first + node.count; ++i)
+            {
+                if (intersectInstance(ray_ws, instance_tree_items[i], nearest, pos_ws))
+                    found = true;
+            }
+            continue;
+        }
+
+        uint32_t near_index = node.left_first;
+        uint32_t far_index = node.left_first + 1;
+
+        float t_near = math::intersectNode(ray_ws.origin, direction_inv,
+                                           instance_tree[near_index], nearest.t);
+        float t_far = math::intersectNode(ray_ws.origin, direction_inv,
+                                          instance_tree[far_index], nearest.t);
+
+        if (t_far < t_near)
+        {
+            std::swap(near_index, far_index);
+            std::swap(t_near, t_far);
+        }
+
+        if (std::isfinite(t_far))
+        {
+            assert(stack_size < INSTANCE_TREE_STACK_SIZE);
+            stack[stack_size++] = far_index;
+        }
+        if (std::isfinite(t_near))
+        {
+            assert(stack_size < INSTANCE_TREE_STACK_SIZE);
+            stack[stack_size++] = near_index;
+        }
+    }
+
+    if (!found) return false;
 
     nearest.t = glm::length(pos_ws - ray_ws.origin) / glm::length(ray_ws.direction);
     nearest.pos = pos_ws;
 
     return true;
 }
+
+void MeshSystem::findIntersections(const math::Ray * rays_ws,
+                                   uint32_t rays_count,
+                                   math::MeshIntersection * nearest)
+{
+    constexpr uint32_t PACKET_SIZE = math::RayPacket::SIZE;
+
+    if (use_octree)
+    {
+        for (uint32_t r = 0; r != rays_count; ++r)
+            findIntersection(rays_ws[r], nearest[r]);
+        return;
+    }
+
+    updateInstanceTree();
+
+    if (instance_tree.empty()) return;
+
+    for (uint32_t first = 0; first < rays_count; first += PACKET_SIZE)
+    {
+        const math::Ray * packet_rays = rays_ws + first;
+        math::MeshIntersection * packet_nearest = nearest + first;
+        uint32_t packet_size = std::min(PACKET_SIZE, rays_count - first);
+
+        math::RayPacket packet;
+        packet.clear();
+        for (uint32_t r = 0; r != packet_size; ++r) packet.set(r, packet_rays[r]);
+
+        // unused lanes can't hit anything
+        alignas(32) float t_max[PACKET_SIZE];
+        for (uint32_t r = 0; r != PACKET_SIZE; ++r)
+        {
+            t_max[r] = r < packet_size ?
+                packet_nearest[r].t : -std::numeric_limits<float>::infinity();
+        }
+
+        glm::vec3 pos_ws[PACKET_SIZE];
+        uint32_t found = 0;
+
+        float t_nearest;
+        if (!math::intersectNode(packet, t_max, instance_tree[0], t_nearest)) continue;
+
+        uint32_t stack[INSTANCE_TREE_STACK_SIZE];
+        uint32_t stack_size = 0;
+        stack[stack_size++] = 0;
+
+        while (stack_size != 0)
+        {
+            const math::BVHNode & node = instance_tree[stack[--stack_size]];
+
+            if (node.isLeaf())
+            {
+                float t_node;
+                uint32_t mask = math::intersectNode(packet, t_max, node, t_node);
+
+                for (uint32_t i = node.left_first; i != node.left_first + node.count; ++i)
+                {
+                    const InstanceTreeItem & item = instance_tree_items[i];
+
+                    uint32_t item_found = intersectMesh(packet_rays,
+                                                        packet_size,
+                                                        mask,
+                                                        item.model->getBVH()[item.mesh_index],
+                                                        item.world_to_mesh,
+                                                        item.mesh_to_world,
+                                                        packet_nearest,
+                                                        pos_ws);
+
+                    for (uint32_t r = 0; r != packet_size; ++r)
+                    {
+                        if (!(item_found & (1u << r))) continue;
+
+                        packet_nearest[r].transform_id = item.transform_id;
+                        if (item.is_opaque)
+                        {
+                            packet_nearest[r].model_id = item.model_id;
+                            packet_nearest[r].box = item.model_box;
+                        }
+                        t_max[r] = packet_nearest[r].t;
+                    }
+
+                    found |= item_found;
+                }
+                continue;
+            }
+
+            uint32_t near_index = node.left_first;
+            uint32_t far_index = node.left_first + 1;
+
+            float t_near, t_far;
+            uint32_t near_mask = math::intersectNode(packet, t_max, instance_tree[near_index], t_near);
+            uint32_t far_mask = math::intersectNode(packet, t_max, instance_tree[far_index], t_far);
+
+            if (t_far < t_near)
+            {
+                std::swap(near_index, far_index);
+                std::swap(near_mask, far_mask);
+            }
+
+            if (far_mask)
+            {
+                assert(stack_size < INSTANCE_TREE_STACK_SIZE);
+                stack[stack_size++] = far_index;
+            }
+            if (near_mask)
+            {
+                assert(stack_size < INSTANCE_TREE_STACK_SIZE);
+                stack[stack_size++] = near_index;
+            }
+        }
+
+        for (uint32_t r = 0; r != packet_size; ++r)
+        {
+            if (!(found & (1u << r))) continue;
+
+            packet_nearest[r].t = glm::length(pos_ws[r] - packet_rays[r].origin) /
+                                  glm::length(packet_rays[r].direction);
+            packet_nearest[r].pos = pos_ws[r];
+        }
+    }
+}
 } // namespace engine
@@ -3,6 +3,8 @@
 
 #include "spdlog.h"
 #include <memory>
+#include <type_traits>
+#include <unordered_map>
 
 #include "opaque_instances.hpp"
 #include "emissive_instances.hpp"
@@ -10,7 +12,10 @@
 #include "disappear_instances.hpp"
 #include "model.hpp"
 #include "matrices.hpp"
+#include "bvh.hpp"
+#include "frustum.hpp"
 #include "transform_system.hpp"
+#include "draw_queue.hpp"
 
 namespace engine
 {
@@ -38,40 +43,55 @@ public:
     void setTextures(std::shared_ptr<Texture> dissolve,
                      std::shared_ptr<Texture> noise);
     
-    void render();
+    // opaque instances outside of the frustum are skipped,
+    // draws of all kinds are sorted by state and depth along view_dir
+    void render(const math::Frustum & frustum,
+                const glm::vec3 & view_pos,
+                const glm::vec3 & view_dir);
     void renderLights();
 
-    // for shadows from point lights
-    void renderShadowCubeMaps(int cubemaps_count);
+    // dissolution and disappear animations depend on time
+    bool hasPendingWork() const;
+
+    // for shadows from point lights,
+    // the casters of all kinds are added to the cache before rendering
+    void updateShadowCasters(int cubemaps_count, ShadowCache & cache);
+    void renderShadowCubeMaps(const ShadowCache & cache);
 
     bool findIntersection(const math::Ray & ray_ws,
                           math::MeshIntersection & nearest);
+
+    // for many coherent rays, traced in packets of math::RayPacket::SIZE
+    void findIntersections(const math::Ray * rays_ws,
+                           uint32_t rays_count,
+                           math::MeshIntersection * nearest);
+
+    // has to be called after opaque or emissive instances were moved,
+    // the instance tree is rebuilt on the next intersection query
+    void invalidateInstanceTree() { is_instance_tree_dirty = true; }
     
+    // T is one of OpaqueInstances, EmissiveInstances,
+    // DissolutionInstances or DisappearInstances,
+    // returns the handle of the instance in T::group
     template <class T>
-    void addInstance(std::shared_ptr<Model> model,
-                     const std::vector<struct T::Material> & materials,
-                     const struct T::Instance & instance);
-
-    template <>
-    void addInstance<OpaqueInstances>(std::shared_ptr<Model> model,
-                                      const std::vector<OpaqueInstances::Material> & materials,
-                                      const OpaqueInstances::Instance & instance);
-
-    template <>
-    void addInstance<DisappearInstances>(std::shared_ptr<Model> model,
-                                         const std::vector<DisappearInstances::Material> & materials,
-                                         const DisappearInstances::Instance & instance);
-    
-    template <>
-    void addInstance<EmissiveInstances>(std::shared_ptr<Model> model,
-                                        const std::vector<EmissiveInstances::Material> & materials,
-                                        const EmissiveInstances::Instance & instance);
-
-    template <>
-    void addInstance<DissolutionInstances>(
-        std::shared_ptr<Model> model,
-        const std::vector<DissolutionInstances::Material> & materials,
-        const DissolutionInstances::Instance & instance);
+    InstanceHandle addInstance(const std::shared_ptr<Model> & model,
+                               const std::vector<typename T::Material> & materials,
+                               const typename T::Instance & instance);
+
+    // O(number of meshes) per instance, the instances keep their meshes:
+    // make_instance(Model &, const From::Instance &) returns To::Instance,
+    // convert(const From::Material &) returns To::Material,
+    // new handles in To::group are written to moved_handles if it's not nullptr,
+    // stale handles are skipped and get INVALID_INSTANCE_HANDLE
+    template <class From, class To, class MakeInstance, class Convert>
+    void moveInstances(const InstanceHandle * handles,
+                       uint32_t handles_count,
+                       MakeInstance && make_instance,
+                       Convert && convert,
+                       InstanceHandle * moved_handles = nullptr);
+
+    // INVALID_INSTANCE_HANDLE if there is no opaque instance with this model ID
+    InstanceHandle findOpaqueInstance(uint32_t id) const;
 
     OpaqueInstances opaque_instances;
     EmissiveInstances emissive_instances;
@@ -80,249 +100,127 @@ public:
 
     std::shared_ptr<Shader> shadow_shader;
 
+    DrawQueue draw_queue;
+
+    // use the old TriangleOctree instead of TriangleBVH for ray queries,
+    // kept to compare the speed of both
+    bool use_octree = false;
+
 private:
     MeshSystem() = default;
     ~MeshSystem() = default;
-    
-    static MeshSystem * instance;
-    static uint32_t model_id;
-};
 
-template <>
-void MeshSystem::addInstance<OpaqueInstances>(std::shared_ptr<Model> model,
-                                              const std::vector<OpaqueInstances::Material> & materials,
-                                              const OpaqueInstances::Instance & instance)
-{    
-    // try to find the same model
-    for (auto & per_model : opaque_instances.per_model)
-    {
-        if (per_model.model == model)
-        {
-            // meshes and is materials are in the same order!
-            for (uint32_t i = 0, size = materials.size(); i != size; ++i)
-            {
-                // try to find the same material
-                for (auto & per_material: per_model.per_mesh[i].per_material)
-                {
-                    if (per_material.material == materials[i])
-                    {
-                        per_material.instances.push_back(instance);
-                        goto next_material;
-                    }
-                }
-                // if not found same materials in the mesh -> add new
-                {
-                OpaqueInstances::PerMaterial per_material;
-                per_material.material = materials[i];
-                per_material.instances.push_back(instance);
-                per_model.per_mesh[i].per_material.push_back(per_material);
-                } // block
-                next_material:
-                    continue;
-            }
-            goto end;
-        }
-    }
-    // if not found same model -> add new
+    // one mesh of an opaque or emissive instance
+    struct InstanceTreeItem
     {
-    OpaqueInstances::PerModel per_model;
-    per_model.model = model;
-        
-    for (auto & material : materials)
-    {
-        OpaqueInstances::PerMaterial per_material;
-        per_material.material = material;
-        per_material.instances.push_back(instance);    
+        Model * model;
+        uint32_t mesh_index;
+        uint32_t transform_id;
+        uint16_t model_id;
+        math::BoundingBox model_box;
+        bool is_opaque;
 
-        OpaqueInstances::PerMesh per_mesh;
-        per_mesh.per_material.push_back(per_material);
+        glm::mat4 mesh_to_world;
+        glm::mat4 world_to_mesh;
+    };
 
-        per_model.per_mesh.push_back(per_mesh);
-    }
-    
-    opaque_instances.per_model.push_back(per_model);
-    } // block
-    
- end:
-    opaque_instances.updateInstanceBuffers();
-}
+    template <class T>
+    T & getInstances();
 
-template <>
-void MeshSystem::addInstance<DisappearInstances>(std::shared_ptr<Model> model,
-                                                 const std::vector<DisappearInstances::Material> & materials,
-                                                 const DisappearInstances::Instance & instance)
-{
-    // try to find the same model
-    for (auto & per_model : disappear_instances.per_model)
+    // only opaque and emissive instances are ray traced
+    template <class T>
+    static constexpr bool isRayTraced()
     {
-        if (per_model.model == model)
-        {
-            // meshes and is materials are in the same order!
-            for (uint32_t i = 0, size = materials.size(); i != size; ++i)
-            {
-                // try to find the same material
-                for (auto & per_material: per_model.per_mesh[i].per_material)
-                {
-                    if (per_material.material == materials[i])
-                    {
-                        per_material.instances.push_back(instance);
-                        goto next_material;
-                    }
-                }
-                // if not found same materials in the mesh -> add new
-                {
-                DisappearInstances::PerMaterial per_material;
-                per_material.material = materials[i];
-                per_material.instances.push_back(instance);
-                per_model.per_mesh[i].per_material.push_back(per_material);
-                } // block
-                next_material:
-                    continue;
-            }
-            goto end;
-        }
+        return std::is_same<T, OpaqueInstances>::value ||
+            std::is_same<T, EmissiveInstances>::value;
     }
-    // if not found same model -> add new
-    {
-    DisappearInstances::PerModel per_model;
-    per_model.model = model;
-        
-    for (auto & material : materials)
-    {
-        DisappearInstances::PerMaterial per_material;
-        per_material.material = material;
-        per_material.instances.push_back(instance);    
 
-        DisappearInstances::PerMesh per_mesh;
-        per_mesh.per_material.push_back(per_material);
+    void updateInstanceTree();
 
-        per_model.per_mesh.push_back(per_mesh);
-    }
-    
-    disappear_instances.per_model.push_back(per_model);
-    } // block
+    bool intersectInstance(const math::Ray & ray_ws,
+                           const InstanceTreeItem & item,
+                           math::MeshIntersection & nearest,
+                           glm::vec3 & pos_ws);
+
+    // top level BVH over world boxes of the instance meshes
+    std::vector<math::BVHNode> instance_tree;
+    std::vector<InstanceTreeItem> instance_tree_items; // in leaf order
+    bool is_instance_tree_dirty = true;
+
+    // model ID -> handle in opaque_instances.group
+    std::unordered_map<uint32_t, InstanceHandle> opaque_handles;
     
- end:
-    disappear_instances.updateInstanceBuffers();
-}
+    static MeshSystem * instance;
+    static uint32_t model_id;
+};
 
-template <>
-void MeshSystem::addInstance<EmissiveInstances>(std::shared_ptr<Model> model,
-                                                const std::vector<EmissiveInstances::Material> & materials,
-                                                const EmissiveInstances::Instance & instance)
+template <class T>
+InstanceHandle MeshSystem::addInstance(const std::shared_ptr<Model> & model,
+                                       const std::vector<typename T::Material> & materials,
+                                       const typename T::Instance & instance)
 {
-    // try to find the same model
-    for (auto & per_model : emissive_instances.per_model)
-    {
-        if (per_model.model == model)
-        {
-            // meshes and is materials are in the same order!
-            for (uint32_t i = 0, size = materials.size(); i != size; ++i)
-            {
-                // try to find the same material
-                for (auto & per_material: per_model.per_mesh[i].per_material)
-                {
-                    if (per_material.material == materials[i])
-                    {
-                        per_material.instances.push_back(instance);
-                        goto next_material;
-                    }
-                }
-                // if not found same materials in the mesh -> add new
-                {
-                EmissiveInstances::PerMaterial per_material;
-                per_material.material = materials[i];
-                per_material.instances.push_back(instance);
-                per_model.per_mesh[i].per_material.push_back(per_material);
-                } // block
-                next_material:
-                    continue;
-            }
-            goto end;
-        }
-    }
-    // if not found same model -> add new
-    {
-    EmissiveInstances::PerModel per_model;
-    per_model.model = model;
-        
-    for (auto & material : materials)
-    {
-        EmissiveInstances::PerMaterial per_material;
-        per_material.material = material;
-        per_material.instances.push_back(instance);    
+    InstanceHandle handle = getInstances<T>().group.add(model, materials, instance);
 
-        EmissiveInstances::PerMesh per_mesh;
-        per_mesh.per_material.push_back(per_material);
+    if constexpr (std::is_same<T, OpaqueInstances>::value)
+        opaque_handles[instance.model_id] = handle;
 
-        per_model.per_mesh.push_back(per_mesh);
-    }
-    
-    emissive_instances.per_model.push_back(per_model);
-    } // block
-    
- end:
-    emissive_instances.updateInstanceBuffers();
+    if (isRayTraced<T>()) is_instance_tree_dirty = true;
+
+    return handle;
 }
 
-template <>
-void MeshSystem::addInstance<DissolutionInstances>(
-    std::shared_ptr<Model> model,
-    const std::vector<DissolutionInstances::Material> & materials,
-    const DissolutionInstances::Instance & instance)
+template <class From, class To, class MakeInstance, class Convert>
+void MeshSystem::moveInstances(const InstanceHandle * handles,
+                               uint32_t handles_count,
+                               MakeInstance && make_instance,
+                               Convert && convert,
+                               InstanceHandle * moved_handles)
 {
-    // try to find the same model
-    for (auto & per_model : dissolution_instances.per_model)
+    static_assert(!std::is_same<From, To>::value, "instances are moved to the same group");
+
+    auto & from = getInstances<From>().group;
+    std::vector<typename To::Material> materials;
+
+    for (uint32_t i = 0; i != handles_count; ++i)
     {
-        if (per_model.model == model)
+        InstanceHandle handle = handles[i];
+
+        // e.g. the instance was removed before the expiry which moves it
+        if (!from.contains(handle))
         {
-            // meshes and is materials are in the same order!
-            for (uint32_t i = 0, size = materials.size(); i != size; ++i)
-            {
-                // try to find the same material
-                for (auto & per_material: per_model.per_mesh[i].per_material)
-                {
-                    if (per_material.material == materials[i])
-                    {                                              
-                        per_material.instances.push_back(instance);
-                        goto next_material;
-                    }
-                }
-                // if not found same materials in the mesh -> add new
-                {
-                DissolutionInstances::PerMaterial per_material;
-                per_material.material = materials[i];
-                per_material.instances.push_back(instance);
-                per_model.per_mesh[i].per_material.push_back(per_material);
-                } // block
-                next_material:
-                    continue;
-            }
-            goto end;
+            if (moved_handles) moved_handles[i] = INVALID_INSTANCE_HANDLE;
+            continue;
         }
+
+        materials.clear();
+        for (uint32_t mesh = 0, size = from.getMeshCount(handle); mesh != size; ++mesh)
+            materials.push_back(convert(from.getBucket(handle, mesh).material));
+
+        const typename From::Instance & instance = from.getInstance(handle);
+        const std::shared_ptr<Model> & model = from.getModel(handle);
+        InstanceHandle moved = addInstance<To>(model, materials, make_instance(*model, instance));
+        if (moved_handles) moved_handles[i] = moved;
+
+        if constexpr (std::is_same<From, OpaqueInstances>::value)
+            opaque_handles.erase(instance.model_id);
+
+        from.remove(handle);
     }
-    // if not found same model -> add new
-    {
-    DissolutionInstances::PerModel per_model;
-    per_model.model = model;
-        
-    for (auto & material : materials)
-    {
-        DissolutionInstances::PerMaterial per_material;
-        per_material.material = material;
-        per_material.instances.push_back(instance);
 
-        DissolutionInstances::PerMesh per_mesh;
-        per_mesh.per_material.push_back(per_material);
+    if (isRayTraced<From>()) is_instance_tree_dirty = true;
+}
 
-        per_model.per_mesh.push_back(per_mesh);
+template <class T>
+T & MeshSystem::getInstances()
+{
+    if constexpr (std::is_same<T, OpaqueInstances>::value) return opaque_instances;
+    else if constexpr (std::is_same<T, EmissiveInstances>::value) return emissive_instances;
+    else if constexpr (std::is_same<T, DissolutionInstances>::value) return dissolution_instances;
+    else
+    {
+        static_assert(std::is_same<T, DisappearInstances>::value, "unknown instances type");
+        return disappear_instances;
     }
-    
-    dissolution_instances.per_model.push_back(per_model);
-    } // block
-    
- end:
-    dissolution_instances.updateInstanceBuffers();
 }
 } // namespace engine
 
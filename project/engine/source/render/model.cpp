@@ -23,6 +23,7 @@ Model::Model(const std::string & model_filename)
    
     meshes.resize(ai_scene->mNumMeshes);
     octrees.resize(ai_scene->mNumMeshes);
+    bvhs.resize(ai_scene->mNumMeshes);
     
     std::vector<Vertex> vertices;
     std::vector<int> indices;
@@ -56,6 +57,7 @@ Model::Model(const std::string & model_filename)
         math::Mesh mesh;
         mesh.box.min = reinterpret_cast<glm::vec3 &>(src_mesh->mAABB.mMin);
         mesh.box.max = reinterpret_cast<glm::vec3 &>(src_mesh->mAABB.mMax);
+        dst_mesh.box = mesh.box;
 
         if (mesh.box.min.x < box.min.x) box.min.x = mesh.box.min.x;
         if (mesh.box.min.y < box.min.y) box.min.y = mesh.box.min.y;
@@ -100,7 +102,10 @@ Model::Model(const std::string & model_filename)
                 mesh.triangles[f].indices[i] = face.mIndices[i];
             }
         }
-        octrees[m].initialize(std::make_shared<math::Mesh>(mesh));
+
+        auto shared_mesh = std::make_shared<math::Mesh>(mesh);
+        octrees[m].initialize(shared_mesh);
+        bvhs[m].initialize(shared_mesh);
     }
     
     vertex_buffer.init(vertices.data(), vertices.size());
@@ -122,11 +127,15 @@ Model::Model(std::vector<Vertex> & vertices,
                             0.0f, 0.0f, 1.0f, 0.0f,
                             0.0f, 0.0f, 0.0f, 1.0f);
     
+    math::BoundingBox mesh_box = math::BoundingBox::empty();
+    for (auto & vertex : vertices) mesh_box.expand(vertex.position);
+
     MeshRange mesh_range {vertices_size,
                           indices_size,
                           0,
                           0,
-                          mesh_to_model};
+                          mesh_to_model,
+                          mesh_box};
 
     meshes.push_back(mesh_range);
 
@@ -144,8 +153,13 @@ Model::Model(std::vector<Vertex> & vertices,
         mesh.triangles.push_back(triangle);
     }
     
+    auto shared_mesh = std::make_shared<math::Mesh>(mesh);
+
     octrees.resize(1);
-    octrees[0].initialize(std::make_shared<math::Mesh>(mesh));
+    octrees[0].initialize(shared_mesh);
+
+    bvhs.resize(1);
+    bvhs[0].initialize(shared_mesh);
 }
 
 void Model::bind()
@@ -169,6 +183,11 @@ std::vector<math::TriangleOctree> & Model::getOctree()
     return octrees;
 }
 
+std::vector<math::TriangleBVH> & Model::getBVH()
+{
+    return bvhs;
+}
+
 math::BoundingBox Model::getBox()
 {
     return box;
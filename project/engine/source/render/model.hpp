@@ -13,6 +13,7 @@
 #include "vertex_buffer.hpp"
 #include "index_buffer.hpp"
 #include "triangle_octree.hpp"
+#include "triangle_bvh.hpp"
 #include "vertex.hpp"
 
 namespace engine
@@ -28,6 +29,7 @@ public:
         uint32_t index_offset;
 
         glm::mat4 mesh_to_model;
+        math::BoundingBox box; // in mesh space
     };
     
     Model(const std::string & model_filename);
@@ -39,6 +41,7 @@ public:
     std::vector<MeshRange> & getMeshRanges();
     MeshRange & getMeshRange(uint32_t index);
     std::vector<math::TriangleOctree> & getOctree();
+    std::vector<math::TriangleBVH> & getBVH();
     math::BoundingBox getBox();
     
 protected:
@@ -46,6 +49,7 @@ protected:
     VertexBuffer<Vertex> vertex_buffer;
     IndexBuffer index_buffer;
     std::vector<math::TriangleOctree> octrees;
+    std::vector<math::TriangleBVH> bvhs;
     math::BoundingBox box;
 };
 } // namespace engine
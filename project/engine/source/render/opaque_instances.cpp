@@ -1,115 +1,131 @@
 #include "opaque_instances.hpp"
 
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+// smaller loops aren't worth waking up the worker threads
+constexpr uint32_t CULLING_CHUNK_SIZE = 4096;
+} // namespace
+
 namespace engine
 {
 void OpaqueInstances::updateInstanceBuffers()
 {
     TransformSystem * trans_system = TransformSystem::getInstance();
-    
-    uint32_t total_instances = 0;
-    
-    for (auto & per_model : per_model)
-        for (auto & per_mesh : per_model.per_mesh)
-            for (auto & per_material : per_mesh.per_material)
-                total_instances += uint32_t(per_material.instances.size());
-
-    if (total_instances == 0) return;
 
-    instance_buffer.init(total_instances);
-    D3D11_MAPPED_SUBRESOURCE mapped = instance_buffer.map();
-    GPUInstance * dst = static_cast<GPUInstance *>(mapped.pData);
-    
-    uint32_t copied_count = 0;
-    for (auto & per_model : per_model)
-    {
-        for (auto & per_mesh : per_model.per_mesh)
+    // repacks everything only if a bucket outgrew its range,
+    // otherwise just the added, moved and transformed instances
+    group.updateStaging(staging, [trans_system](const Instance & instance)
         {
-            for (auto & per_material : per_mesh.per_material)
-            {
-                uint32_t instances_size = per_material.instances.size();
-                for (uint32_t i = 0; i != instances_size; ++i)
-                {
-                    dst[copied_count++] = GPUInstance(
-                        trans_system->
-                            transforms[per_material.instances[i].transform_id].toMat4(),
-                        per_material.instances[i].model_id);
-                }
-            }
-        }
-    }
+            return GPUInstance(
+                glm::mat4(trans_system->getWorld(instance.transform_id)),
+                instance.model_id);
+        });
+
+    // there is no persistent GPU copy to upload the dirty ranges to
+    staging.clearDirty();
+    is_world_boxes_dirty = true;
+}
 
-    instance_buffer.unmap();
+void OpaqueInstances::updateWorldBoxes()
+{
+    if (group.isInstanceBufferDirty()) updateInstanceBuffers();
+    if (!is_world_boxes_dirty) return;
+
+    is_world_boxes_dirty = false;
+    group.computeWorldBoxes(staging, world_boxes);
 }
 
-void OpaqueInstances::render()
+void OpaqueInstances::cull(const math::Frustum & frustum, DrawQueue & queue, uint32_t shader)
 {
-    if (instance_buffer.get_size() == 0) return;
+    updateWorldBoxes();
 
-    Globals * globals = Globals::getInstance();
-    LightSystem * light_sys = LightSystem::getInstance();
+    ThreadPool * thread_pool = ThreadPool::getInstance();
 
-    globals->bindDefaultBlendState();
-    
-    globals->device_context4->
-        IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    uint32_t instances_count = staging.size();
+    const GPUInstance * instances = staging.data();
 
-    shader->bind();
-    instance_buffer.bind(1);
-    
-    uint32_t rendered_instances = 0;
-    
-    for (auto & per_model: per_model)
-    {
-        if (per_model.model == nullptr) continue;
+    visibility.resize(instances_count);
+    thread_pool->parallelFor(instances_count,
+                             CULLING_CHUNK_SIZE,
+                             [&](uint32_t begin, uint32_t end)
+                             {
+                                 math::cullBoxes(frustum, world_boxes, begin, end, visibility.data());
+                             });
+
+    visible_count = 0;
+    if (instances_count == 0) return;
 
-        // bind vertex and index buffers
-        per_model.model->bind();
+    // the buffer grows with the staging, so it's rarely recreated
+    if (visible_buffer.get_size() < staging.getCapacity())
+        visible_buffer.init(staging.getCapacity());
+
+    D3D11_MAPPED_SUBRESOURCE mapped = visible_buffer.map();
+    GPUInstance * dst = static_cast<GPUInstance *>(mapped.pData);
+
+    // visible instances of each bucket are packed into a contiguous range per depth layer,
+    // so near instances are drawn before the far ones of the same bucket
+    for (uint32_t m = 0, models_count = group.per_model.size(); m != models_count; ++m)
+    {
+        auto & per_model = group.per_model[m];
 
-        uint32_t per_mesh_size = per_model.per_mesh.size();
-        for (uint32_t i = 0; i < per_mesh_size; ++i)
+        for (uint32_t mesh = 0, meshes_count = per_model.per_mesh.size(); mesh != meshes_count; ++mesh)
         {
-            Model::MeshRange & mesh_range = per_model.model->getMeshRange(i);
+            auto & per_materials = per_model.per_mesh[mesh].per_material;
 
-            for (auto & per_material : per_model.per_mesh[i].per_material)
+            for (uint32_t mat = 0, materials_count = per_materials.size(); mat != materials_count; ++mat)
             {
-                if (per_material.instances.empty()) continue;
-
-                Material & material = per_material.material;
-
-                globals->bindRasterizer(material.is_double_sided);
-
-                globals->setPerMeshBuffer(mesh_range.mesh_to_model,
-                                          static_cast<bool>(material.albedo),
-                                          static_cast<bool>(material.roughness),
-                                          static_cast<bool>(material.metalness),
-                                          static_cast<bool>(material.normal),
-                                          material.is_directx_style_normal_map,
-                                          material.albedo_default,
-                                          material.roughness_default,
-                                          material.metalness_default);
-                globals->updatePerMeshBuffer();
-                
-                if (static_cast<bool>(material.albedo)) material.albedo->bind(0);
-                if (static_cast<bool>(material.roughness)) material.roughness->bind(1);
-                if (static_cast<bool>(material.metalness)) material.metalness->bind(2);
-                if (static_cast<bool>(material.normal)) material.normal->bind(3);
-
-                uint32_t instances_count = uint32_t(per_material.instances.size());
-
-                globals->device_context4->DrawIndexedInstanced(mesh_range.index_count,
-                                                               instances_count,
-                                                               mesh_range.index_offset,
-                                                               mesh_range.vertex_offset,
-                                                               rendered_instances);
-                rendered_instances += instances_count;
+                uint32_t bucket_begin = per_materials[mat].offset;
+                uint32_t bucket_end = bucket_begin + uint32_t(per_materials[mat].instances.size());
+
+                uint32_t layer_counts[DrawQueue::DEPTH_LAYERS_COUNT] = {};
+                float layer_depths[DrawQueue::DEPTH_LAYERS_COUNT];
+                std::fill(std::begin(layer_depths), std::end(layer_depths), math::BoundingBox::inf);
+
+                for (uint32_t i = bucket_begin; i != bucket_end; ++i)
+                {
+                    if (!visibility[i]) continue;
+
+                    float depth = queue.getDepth(world_boxes.get(i));
+                    uint32_t layer = DrawQueue::getDepthLayer(depth);
+
+                    visibility[i] = uint8_t(layer + 1);
+                    ++layer_counts[layer];
+                    layer_depths[layer] = std::min(layer_depths[layer], depth);
+                }
+
+                uint32_t layer_offsets[DrawQueue::DEPTH_LAYERS_COUNT];
+                for (uint32_t layer = 0; layer != DrawQueue::DEPTH_LAYERS_COUNT; ++layer)
+                {
+                    layer_offsets[layer] = visible_count;
+                    visible_count += layer_counts[layer];
+
+                    if (layer_counts[layer] == 0) continue;
+
+                    uint64_t key = DrawQueue::makeOpaqueKey(DrawQueue::OPAQUE_PASS,
+                                                            shader,
+                                                            per_materials[mat].material_id,
+                                                            DrawQueue::getMeshID(m, mesh),
+                                                            layer_depths[layer]);
+                    queue.add(key, {m, mesh, mat, layer_offsets[layer], layer_counts[layer]});
+                }
+
+                for (uint32_t i = bucket_begin; i != bucket_end; ++i)
+                {
+                    if (visibility[i]) dst[layer_offsets[visibility[i] - 1]++] = instances[i];
+                }
             }
         }
     }
+
+    visible_buffer.unmap();
 }
 
-void OpaqueInstances::renderWithoutMaterials(int cubemaps_count)
+void OpaqueInstances::render(const DrawQueue & queue, uint32_t begin, uint32_t end)
 {
-    if (instance_buffer.get_size() == 0) return;
+    if (begin == end) return;
 
     Globals * globals = Globals::getInstance();
 
@@ -118,49 +134,46 @@ void OpaqueInstances::renderWithoutMaterials(int cubemaps_count)
     globals->device_context4->
         IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-    instance_buffer.bind(1);
-    
-    uint32_t rendered_instances = 0;
-    
-    for (auto & per_model: per_model)
-    {
-        if (per_model.model == nullptr) continue;
-
-        // bind vertex and index buffers
-        per_model.model->bind();
-
-        uint32_t per_mesh_size = per_model.per_mesh.size();
-        for (uint32_t i = 0; i < per_mesh_size; ++i)
-        {
-            Model::MeshRange & mesh_range = per_model.model->getMeshRange(i);
+    shader->bind();
+    visible_buffer.bind(1);
 
-            for (auto & per_material : per_model.per_mesh[i].per_material)
-            {
-                if (per_material.instances.empty()) continue;
+    group.renderPackets(queue, begin, end, [globals](Model::MeshRange & mesh_range,
+                                                     const Material & material,
+                                                     bool is_material_changed)
+    {
+        if (is_material_changed) globals->bindRasterizer(material.is_double_sided);
+
+        globals->setPerMeshBuffer(mesh_range.mesh_to_model,
+                                  static_cast<bool>(material.albedo),
+                                  static_cast<bool>(material.roughness),
+                                  static_cast<bool>(material.metalness),
+                                  static_cast<bool>(material.normal),
+                                  material.is_directx_style_normal_map,
+                                  material.albedo_default,
+                                  material.roughness_default,
+                                  material.metalness_default);
+        globals->updatePerMeshBuffer();
+
+        if (!is_material_changed) return;
+
+        if (static_cast<bool>(material.albedo)) material.albedo->bind(0);
+        if (static_cast<bool>(material.roughness)) material.roughness->bind(1);
+        if (static_cast<bool>(material.metalness)) material.metalness->bind(2);
+        if (static_cast<bool>(material.normal)) material.normal->bind(3);
+    });
+}
 
-                Material & material = per_material.material;
+void OpaqueInstances::updateShadowCasters(int cubemaps_count, ShadowCache & cache)
+{
+    updateWorldBoxes();
 
-                globals->bindRasterizer(material.is_double_sided);
+    shadow_casters.updateGroup(group, staging, world_boxes, cubemaps_count, cache);
+}
 
-                globals->setPerShadowMeshBuffer(mesh_range.mesh_to_model);
-                globals->updatePerShadowMeshBuffer();
-                
-                uint32_t instances_count = uint32_t(per_material.instances.size());
+void OpaqueInstances::renderWithoutMaterials(const ShadowCache & cache)
+{
+    Globals::getInstance()->bindDefaultBlendState();
 
-                for (int cubemap_index = 0; cubemap_index != cubemaps_count; ++cubemap_index)
-                {
-                    globals->setPerShadowCubemapBuffer(cubemap_index);
-                    globals->updatePerShadowCubemapBuffer();
-                    
-                    globals->device_context4->DrawIndexedInstanced(mesh_range.index_count,
-                                                                   instances_count,
-                                                                   mesh_range.index_offset,
-                                                                   mesh_range.vertex_offset,
-                                                                   rendered_instances);
-                }                
-                rendered_instances += instances_count;
-            }
-        }
-    }
+    shadow_casters.renderGroup(group, cache, staging, caster_buffer);
 }
 } // namespace engine
@@ -0,0 +1,226 @@
+#include "particle_pool.hpp"
+
+namespace
+{
+// per frame increments, the kernels only add them,
+// so every level rounds the same way
+struct Step
+{
+    float lifetime;
+    float movement;
+    float resize;
+    float appear;
+    float disappear;
+    float appear_lifetime_value;
+};
+
+// the arrays updated by the kernels
+struct Streams
+{
+    explicit Streams(engine::ParticlePool & pool) :
+                     position_y(pool.position_y.data()),
+                     size(pool.particle_size.data()),
+                     thickness(pool.thickness.data()),
+                     alpha(pool.alpha.data()),
+                     lifetime(pool.lifetime.data())
+    {}
+
+    float * position_y;
+    float * size;
+    float * thickness;
+    float * alpha;
+    float * lifetime;
+};
+
+void updateScalar(Streams s, const Step & step, uint32_t begin, uint32_t end)
+{
+    for (uint32_t i = begin; i != end; ++i)
+    {
+        float lifetime = s.lifetime[i] + step.lifetime;
+        bool is_faded = s.alpha[i] < 0.0f;
+
+        s.position_y[i] += step.movement;
+        s.size[i] += step.resize;
+        s.thickness[i] += step.resize;
+        s.alpha[i] += lifetime < step.appear_lifetime_value ? step.appear : -step.disappear;
+
+        // compact() removes particles with lifetime >= 1
+        s.lifetime[i] = is_faded ? 1.0f : lifetime;
+    }
+}
+
+uint32_t updateSSE(Streams s, const Step & step, uint32_t count)
+{
+    __m128 d_lifetime = _mm_set1_ps(step.lifetime);
+    __m128 d_movement = _mm_set1_ps(step.movement);
+    __m128 d_resize = _mm_set1_ps(step.resize);
+    __m128 d_appear = _mm_set1_ps(step.appear);
+    __m128 d_disappear = _mm_set1_ps(-step.disappear);
+    __m128 appear_lifetime = _mm_set1_ps(step.appear_lifetime_value);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+
+    uint32_t end = count & ~3u;
+    for (uint32_t i = 0; i != end; i += 4)
+    {
+        __m128 alpha = _mm_loadu_ps(s.alpha + i);
+        __m128 lifetime = _mm_add_ps(_mm_loadu_ps(s.lifetime + i), d_lifetime);
+
+        __m128 is_faded = _mm_cmplt_ps(alpha, zero);
+        __m128 is_appearing = _mm_cmplt_ps(lifetime, appear_lifetime);
+
+        __m128 d_alpha = _mm_or_ps(_mm_and_ps(is_appearing, d_appear),
+                                   _mm_andnot_ps(is_appearing, d_disappear));
+        _mm_storeu_ps(s.alpha + i, _mm_add_ps(alpha, d_alpha));
+
+        _mm_storeu_ps(s.lifetime + i, _mm_or_ps(_mm_and_ps(is_faded, one),
+                                                _mm_andnot_ps(is_faded, lifetime)));
+
+        _mm_storeu_ps(s.position_y + i, _mm_add_ps(_mm_loadu_ps(s.position_y + i), d_movement));
+        _mm_storeu_ps(s.size + i, _mm_add_ps(_mm_loadu_ps(s.size + i), d_resize));
+        _mm_storeu_ps(s.thickness + i, _mm_add_ps(_mm_loadu_ps(s.thickness + i), d_resize));
+    }
+
+    return end;
+}
+
+MATH_TARGET_AVX2
+uint32_t updateAVX2(Streams s, const Step & step, uint32_t count)
+{
+    __m256 d_lifetime = _mm256_set1_ps(step.lifetime);
+    __m256 d_movement = _mm256_set1_ps(step.movement);
+    __m256 d_resize = _mm256_set1_ps(step.resize);
+    __m256 d_appear = _mm256_set1_ps(step.appear);
+    __m256 d_disappear = _mm256_set1_ps(-step.disappear);
+    __m256 appear_lifetime = _mm256_set1_ps(step.appear_lifetime_value);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.0f);
+
+    uint32_t end = count & ~7u;
+    for (uint32_t i = 0; i != end; i += 8)
+    {
+        __m256 alpha = _mm256_loadu_ps(s.alpha + i);
+        __m256 lifetime = _mm256_add_ps(_mm256_loadu_ps(s.lifetime + i), d_lifetime);
+
+        __m256 is_faded = _mm256_cmp_ps(alpha, zero, _CMP_LT_OQ);
+        __m256 is_appearing = _mm256_cmp_ps(lifetime, appear_lifetime, _CMP_LT_OQ);
+
+        __m256 d_alpha = _mm256_blendv_ps(d_disappear, d_appear, is_appearing);
+        _mm256_storeu_ps(s.alpha + i, _mm256_add_ps(alpha, d_alpha));
+
+        _mm256_storeu_ps(s.lifetime + i, _mm256_blendv_ps(lifetime, one, is_faded));
+
+        _mm256_storeu_ps(s.position_y + i, _mm256_add_ps(_mm256_loadu_ps(s.position_y + i), d_movement));
+        _mm256_storeu_ps(s.size + i, _mm256_add_ps(_mm256_loadu_ps(s.size + i), d_resize));
+        _mm256_storeu_ps(s.thickness + i, _mm256_add_ps(_mm256_loadu_ps(s.thickness + i), d_resize));
+    }
+
+    return end;
+}
+} // namespace
+
+namespace engine
+{
+ParticlePool::ParticlePool(uint32_t capacity) :
+                           position_x(capacity),
+                           position_y(capacity),
+                           position_z(capacity),
+                           particle_size(capacity),
+                           thickness(capacity),
+                           angle(capacity),
+                           tint_r(capacity),
+                           tint_g(capacity),
+                           tint_b(capacity),
+                           alpha(capacity),
+                           lifetime(capacity),
+                           remap(capacity)
+{}
+
+bool ParticlePool::spawn(const glm::vec3 & position,
+                         float size,
+                         float thickness,
+                         float angle,
+                         const glm::vec4 & tint)
+{
+    if (count == capacity()) return false;
+
+    position_x[count] = position.x;
+    position_y[count] = position.y;
+    position_z[count] = position.z;
+    particle_size[count] = size;
+    this->thickness[count] = thickness;
+    this->angle[count] = angle;
+    tint_r[count] = tint.x;
+    tint_g[count] = tint.y;
+    tint_b[count] = tint.z;
+    alpha[count] = tint.w;
+    lifetime[count] = 0.0f;
+
+    ++count;
+    return true;
+}
+
+void ParticlePool::update(const Motion & motion,
+                          float delta_time,
+                          math::SIMDLevel level)
+{
+    Step step = {motion.life_speed * delta_time,
+                 motion.movement_speed * delta_time,
+                 motion.resize_speed * delta_time,
+                 motion.appear_speed * delta_time,
+                 motion.disappear_speed * delta_time,
+                 motion.appear_lifetime_value};
+
+    Streams streams(*this);
+
+    uint32_t tail = 0;
+    switch (level)
+    {
+    case math::SIMDLevel::AVX2:
+        tail = updateAVX2(streams, step, count);
+        break;
+    case math::SIMDLevel::SSE:
+        tail = updateSSE(streams, step, count);
+        break;
+    default:
+        break;
+    }
+    updateScalar(streams, step, tail, count);
+
+    compact();
+}
+
+void ParticlePool::compact()
+{
+    uint32_t live_count = 0;
+
+    for (uint32_t i = 0; i != count; ++i)
+    {
+        if (lifetime[i] >= 1.0f)
+        {
+            remap[i] = DEAD_INDEX;
+            continue;
+        }
+        remap[i] = live_count;
+
+        if (live_count != i)
+        {
+            position_x[live_count] = position_x[i];
+            position_y[live_count] = position_y[i];
+            position_z[live_count] = position_z[i];
+            particle_size[live_count] = particle_size[i];
+            thickness[live_count] = thickness[i];
+            angle[live_count] = angle[i];
+            tint_r[live_count] = tint_r[i];
+            tint_g[live_count] = tint_g[i];
+            tint_b[live_count] = tint_b[i];
+            alpha[live_count] = alpha[i];
+            lifetime[live_count] = lifetime[i];
+        }
+        ++live_count;
+    }
+
+    updated_count = count;
+    count = live_count;
+}
+} // namespace engine
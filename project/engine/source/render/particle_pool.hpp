@@ -0,0 +1,86 @@
+#ifndef PARTICLE_POOL_HPP
+#define PARTICLE_POOL_HPP
+
+#include "glm.hpp"
+#include <vector>
+#include <cstdint>
+
+#include "simd.hpp"
+
+namespace engine
+{
+// Particles of one emitter in SoA arrays of a fixed capacity,
+// the live ones are [0; size()) in the order they were spawned.
+// update() advances 4/8 particles at once and compacts the dead ones out,
+// all the SIMD levels give the same bits as the scalar code.
+class ParticlePool
+{
+public:
+    static constexpr uint32_t DEAD_INDEX = UINT32_MAX;
+
+    // per second, lifetime is [0; 1]
+    struct Motion
+    {
+        float life_speed;
+        float movement_speed; // along Y
+        float resize_speed; // of the size and the thickness
+        float appear_lifetime_value; // alpha grows before it and falls after it
+        float appear_speed;
+        float disappear_speed;
+    };
+
+    explicit ParticlePool(uint32_t capacity = 0);
+
+    uint32_t size() const { return count; }
+    uint32_t capacity() const { return uint32_t(lifetime.size()); }
+
+    // returns false if the pool is full
+    bool spawn(const glm::vec3 & position,
+               float size,
+               float thickness,
+               float angle,
+               const glm::vec4 & tint);
+
+    // a particle dies when its lifetime reaches 1 or its alpha was below 0
+    void update(const Motion & motion,
+                float delta_time,
+                math::SIMDLevel level = math::getSIMDLevel());
+
+    // what the last update() did to the particles alive before it:
+    // index before -> index after, or DEAD_INDEX
+    uint32_t getUpdatedCount() const { return updated_count; }
+    uint32_t getRemap(uint32_t index) const { return remap[index]; }
+
+    glm::vec3 getPosition(uint32_t index) const
+    {
+        return glm::vec3(position_x[index], position_y[index], position_z[index]);
+    }
+    glm::vec4 getTint(uint32_t index) const
+    {
+        return glm::vec4(tint_r[index], tint_g[index], tint_b[index], alpha[index]);
+    }
+
+    std::vector<float> position_x;
+    std::vector<float> position_y;
+    std::vector<float> position_z;
+    std::vector<float> particle_size; // width and height
+    std::vector<float> thickness; // contact fading range
+    std::vector<float> angle;
+    std::vector<float> tint_r;
+    std::vector<float> tint_g;
+    std::vector<float> tint_b;
+    std::vector<float> alpha;
+    std::vector<float> lifetime;
+
+private:
+    // moves the live particles to the front keeping their order
+    void compact();
+
+    uint32_t count = 0;
+
+    std::vector<uint32_t> remap;
+    uint32_t updated_count = 0;
+};
+} // namespace engine
+
+#endif
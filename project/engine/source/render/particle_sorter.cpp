@@ -0,0 +1,162 @@
+#include "particle_sorter.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+constexpr uint32_t RADIX_BITS = 8;
+constexpr uint32_t RADIX = 1 << RADIX_BITS;
+constexpr uint32_t DIGITS_COUNT = 32 / RADIX_BITS;
+
+// the incremental sort gives up if the particles moved more on average
+constexpr uint32_t MAX_AVERAGE_SHIFT = 8;
+} // namespace
+
+namespace engine
+{
+void ParticleSorter::sort(const std::vector<const ParticlePool *> & pools,
+                          const glm::vec3 & camera_pos)
+{
+    bool is_incremental = sort_mode == SortMode::INCREMENTAL && is_order_valid;
+
+    if (is_incremental) remapEntries(pools);
+    addEntries(pools, is_incremental);
+
+    is_order_valid = true;
+
+    updateKeys(pools, camera_pos);
+
+    was_incremental = is_incremental && insertionSort();
+    if (!was_incremental) radixSort();
+}
+
+void ParticleSorter::remapEntries(const std::vector<const ParticlePool *> & pools)
+{
+    uint32_t live_count = 0;
+    for (const Entry & entry : entries)
+    {
+        uint32_t index = pools[entry.emitter]->getRemap(entry.index);
+        if (index == ParticlePool::DEAD_INDEX) continue;
+
+        entries[live_count++] = {entry.key, entry.emitter, index};
+    }
+    entries.resize(live_count);
+}
+
+void ParticleSorter::addEntries(const std::vector<const ParticlePool *> & pools,
+                                bool is_incremental)
+{
+    if (!is_incremental)
+    {
+        entries.clear();
+        sorted_counts.assign(pools.size(), 0);
+    }
+
+    for (uint32_t e = 0, size = pools.size(); e != size; ++e)
+    {
+        const ParticlePool & pool = *pools[e];
+
+        if (is_incremental)
+        {
+            // spawned since the last frame, they are the last ones before the update
+            for (uint32_t i = sorted_counts[e], end = pool.getUpdatedCount(); i != end; ++i)
+            {
+                uint32_t index = pool.getRemap(i);
+                if (index != ParticlePool::DEAD_INDEX) entries.push_back({0, e, index});
+            }
+        }
+        else
+        {
+            for (uint32_t i = 0, end = pool.size(); i != end; ++i)
+                entries.push_back({0, e, i});
+        }
+
+        sorted_counts[e] = pool.size();
+    }
+}
+
+void ParticleSorter::updateKeys(const std::vector<const ParticlePool *> & pools,
+                                const glm::vec3 & camera_pos)
+{
+    for (Entry & entry : entries)
+    {
+        glm::vec3 offset = pools[entry.emitter]->getPosition(entry.index) - camera_pos;
+        float distance_2 = glm::dot(offset, offset);
+
+        // bits of non-negative floats are ordered as the floats
+        uint32_t bits;
+        std::memcpy(&bits, &distance_2, sizeof(bits));
+
+        entry.key = ~bits;
+    }
+}
+
+void ParticleSorter::radixSort()
+{
+    uint32_t size = entries.size();
+    if (size < 2) return;
+
+    // histograms of all the digits in one pass
+    uint32_t counts[DIGITS_COUNT][RADIX] = {};
+    for (const Entry & entry : entries)
+    {
+        for (uint32_t digit = 0; digit != DIGITS_COUNT; ++digit)
+            ++counts[digit][(entry.key >> (digit * RADIX_BITS)) & (RADIX - 1)];
+    }
+
+    sorted_entries.resize(size);
+    Entry * src = entries.data();
+    Entry * dst = sorted_entries.data();
+
+    // LSD, each pass is stable
+    for (uint32_t digit = 0; digit != DIGITS_COUNT; ++digit)
+    {
+        uint32_t shift = digit * RADIX_BITS;
+
+        // e.g. the exponent of close distances
+        if (counts[digit][(src[0].key >> shift) & (RADIX - 1)] == size) continue;
+
+        uint32_t offsets[RADIX];
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i != RADIX; ++i)
+        {
+            offsets[i] = offset;
+            offset += counts[digit][i];
+        }
+
+        for (uint32_t i = 0; i != size; ++i)
+            dst[offsets[(src[i].key >> shift) & (RADIX - 1)]++] = src[i];
+
+        std::swap(src, dst);
+    }
+
+    if (src != entries.data()) entries.swap(sorted_entries);
+}
+
+bool ParticleSorter::insertionSort()
+{
+    uint32_t size = entries.size();
+    uint32_t max_shifts = size * MAX_AVERAGE_SHIFT;
+    uint32_t shifts = 0;
+
+    Entry * data = entries.data();
+
+    for (uint32_t i = 1; i < size; ++i)
+    {
+        Entry entry = data[i];
+
+        uint32_t j = i;
+        for (; j != 0 && data[j - 1].key > entry.key; --j)
+            data[j] = data[j - 1];
+
+        data[j] = entry;
+
+        // the order is valid, just not sorted yet
+        shifts += i - j;
+        if (shifts > max_shifts) return false;
+    }
+
+    return true;
+}
+} // namespace engine
@@ -0,0 +1,74 @@
+#ifndef PARTICLE_SORTER_HPP
+#define PARTICLE_SORTER_HPP
+
+#include "glm.hpp"
+#include <vector>
+#include <cstdint>
+
+#include "particle_pool.hpp"
+
+namespace engine
+{
+// The particles of all the emitters sorted back to front by the distance to the camera.
+// The incremental mode keeps the last frame's order of the particles which are still alive
+// and fixes it up by insertion sort, it falls back to the radix sort
+// if the particles moved too much.
+class ParticleSorter
+{
+public:
+    enum class SortMode
+    {
+        RADIX, // from scratch every frame
+        INCREMENTAL // the last frame's order fixed up by insertion sort
+    };
+
+    struct Entry
+    {
+        uint32_t key; // inverted squared distance to the camera, the farthest first
+        uint32_t emitter; // index in pools
+        uint32_t index; // in the pool of the emitter
+    };
+
+    void setSortMode(SortMode sort_mode)
+    {
+        this->sort_mode = sort_mode;
+        is_order_valid = false;
+    }
+
+    // the next sort() starts from scratch, e.g. after an emitter is added
+    void invalidate() { is_order_valid = false; }
+
+    // pools[e] - the particles of the emitter e,
+    // every pool is updated once between two sorts, so its remap is valid
+    void sort(const std::vector<const ParticlePool *> & pools, const glm::vec3 & camera_pos);
+
+    // false if the last sort() started from scratch
+    bool wasIncremental() const { return was_incremental; }
+
+    uint32_t size() const { return uint32_t(entries.size()); }
+
+    // back to front
+    const Entry & getEntry(uint32_t index) const { return entries[index]; }
+
+protected:
+    // keeps the last frame's order of the particles which are still alive
+    void remapEntries(const std::vector<const ParticlePool *> & pools);
+    // adds the particles which aren't in entries, all of them if !is_incremental
+    void addEntries(const std::vector<const ParticlePool *> & pools, bool is_incremental);
+    void updateKeys(const std::vector<const ParticlePool *> & pools, const glm::vec3 & camera_pos);
+
+    void radixSort();
+    // returns false if the order changed too much and the sort was stopped
+    bool insertionSort();
+
+    SortMode sort_mode = SortMode::INCREMENTAL;
+    bool is_order_valid = false;
+    bool was_incremental = false;
+
+    std::vector<Entry> entries; // in the order of the last frame
+    std::vector<Entry> sorted_entries; // radix sort ping-pong
+    std::vector<uint32_t> sorted_counts; // per emitter, particles in entries
+};
+} // namespace engine
+
+#endif
@@ -40,43 +40,52 @@ void ParticleSystem::del()
 void ParticleSystem::addSmokeEmitter(const SmokeEmitter & smoke_emitter)
 {
     smoke_emitters.push_back(smoke_emitter);
+    sorter.invalidate();
+}
+
+void ParticleSystem::setSortMode(SortMode sort_mode)
+{
+    sorter.setSortMode(sort_mode);
+}
+
+bool ParticleSystem::hasPendingWork() const
+{
+    return !smoke_emitters.empty() ||
+           TimeSystem::getTimePoint() - last_sparks_spawn_time < SPARK_MAX_LIFETIME;
 }
 
 void ParticleSystem::updateInstanceBuffer(const Camera & camera)
 {
-    std::vector<Particle> instances;
+    // SmokeEmitter::update() updates the pool once per frame
+    pools.clear();
+    for (const SmokeEmitter & smoke_emitter : smoke_emitters)
+        pools.push_back(&smoke_emitter.getParticles());
 
-    for (auto & smoke_emitter : smoke_emitters)
-    {
-        auto & src = smoke_emitter.getParticles();
-        instances.insert(instances.end(), src.begin(), src.end());
-    }
-    if (instances.size() == 0) return;
+    sorter.sort(pools, camera.getPosition());
 
-    std::sort(instances.begin(),
-              instances.end(),
-              [camera](const Particle & a, const Particle & b)
-              {
-                  float dist_1 = glm::length(a.position - camera.getPosition());
-                  float dist_2 = glm::length(b.position - camera.getPosition());
+    instances_count = sorter.size();
+    if (instances_count == 0) return;
 
-                  return dist_1 > dist_2;
-              });
+    if (instance_buffer.get_size() < instances_count)
+        instance_buffer.init(instances_count * 2);
 
-    instance_buffer.init(instances.size());
     D3D11_MAPPED_SUBRESOURCE mapped = instance_buffer.map();
     GPUInstance * dst = static_cast<GPUInstance *>(mapped.pData);
 
-    uint32_t copied_count = 0;
-    for (auto & particle : instances)
+    for (uint32_t i = 0; i != instances_count; ++i)
     {
-        dst[copied_count++] = GPUInstance(particle.position,
-                                          glm::vec3(particle.size,
-                                                    particle.thickness),
-                                          particle.angle,
-                                          particle.tint,
-                                          particle.lifetime);
-    }    
+        const ParticleSorter::Entry & entry = sorter.getEntry(i);
+        const ParticlePool & pool = *pools[entry.emitter];
+        uint32_t index = entry.index;
+
+        dst[i] = GPUInstance(pool.getPosition(index),
+                             glm::vec3(pool.particle_size[index],
+                                       pool.particle_size[index],
+                                       pool.thickness[index]),
+                             pool.angle[index],
+                             pool.getTint(index),
+                             pool.lifetime[index]);
+    }
     
     instance_buffer.unmap();
 }
@@ -90,7 +99,7 @@ void ParticleSystem::renderParticles(float delta_time,
     
     updateInstanceBuffer(camera);
 
-    if (instance_buffer.get_size() == 0) return;
+    if (instances_count == 0) return;
 
     Globals * globals = Globals::getInstance();
 
@@ -106,12 +115,10 @@ void ParticleSystem::renderParticles(float delta_time,
     lightmap_BotBF->bind(9);
     motion_vectors->bind(10);
 
-    globals->device_context4->PSSetShaderResources(11,
-                                                   1,
-                                                   depth_copy_srv.get());
+    globals->bindPSShaderResources(11, 1, depth_copy_srv.get());
     
     globals->device_context4->DrawInstanced(6,
-                                            instance_buffer.get_size(),
+                                            instances_count,
                                             0,
                                             0);
 }
@@ -267,6 +274,9 @@ void ParticleSystem::bindSparksBuffers(bool to_compute_shader)
                                           sparks_range_view.ptr(),
                                           sparks_indirect_args_view.ptr()};
 
+    // D3D unbinds the SRVs of the buffers bound as UAVs
+    globals->state_cache.invalidatePixelSRVs();
+
     if (to_compute_shader)
     {
         globals->device_context4->CSSetUnorderedAccessViews(1,
@@ -312,11 +322,14 @@ void ParticleSystem::unbindSparksBuffers()
 void ParticleSystem::spawnSparks()
 {
     MeshSystem * mesh_sys = MeshSystem::getInstance();
+
+    if (!mesh_sys->disappear_instances.group.per_model.empty())
+        last_sparks_spawn_time = TimeSystem::getTimePoint();
     
     bindSparksBuffers();
     spawn_sparks->bind();
 
-    mesh_sys->disappear_instances.renderWithoutMaterials();
+    mesh_sys->disappear_instances.renderAllWithoutMaterials();
     
     unbindSparksBuffers();
 }
@@ -8,6 +8,7 @@
 #include "vertex_buffer.hpp"
 #include "camera.hpp"
 #include "mesh_system.hpp"
+#include "particle_sorter.hpp"
 
 namespace engine
 {
@@ -45,6 +46,14 @@ public:
     
     void addSmokeEmitter(const SmokeEmitter & smoke_emitter);
 
+    // smoke is always animated, sparks live for some time after spawn
+    bool hasPendingWork() const;
+
+    // how the particles are sorted back to front
+    using SortMode = ParticleSorter::SortMode;
+
+    void setSortMode(SortMode sort_mode);
+
     void updateInstanceBuffer(const Camera & camera);
 
     // move them to Emitter class for different textures:
@@ -70,6 +79,8 @@ private:
 
     void copySparksIndirectBuffer();
 
+    static constexpr float SPARK_MAX_LIFETIME = 3.0f; // g_MAX_LIFETIME in update_sparks.hlsl
+
     void spawnSparks();
     void updateSparks(DxResPtr<ID3D11ShaderResourceView> depth_copy_srv,
                       DxResPtr<ID3D11ShaderResourceView> normals_copy_srv);
@@ -98,10 +109,16 @@ private:
         float lifetime;
     };
 
-    VertexBuffer<GPUInstance> instance_buffer;
+    VertexBuffer<GPUInstance> instance_buffer; // recreated only when it's too small
+    uint32_t instances_count = 0;
+
+    ParticleSorter sorter;
+    std::vector<const ParticlePool *> pools; // of smoke_emitters
     
     std::vector<SmokeEmitter> smoke_emitters;
 
+    float last_sparks_spawn_time = -SPARK_MAX_LIFETIME;
+
     DxResPtr<ID3D11Buffer> sparks_data;
     DxResPtr<ID3D11UnorderedAccessView> sparks_data_view;
     
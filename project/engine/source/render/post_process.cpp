@@ -14,13 +14,9 @@ void Postprocess::resolve(DxResPtr<ID3D11ShaderResourceView> source_hdr,
 {
     Globals * globals = Globals::getInstance();
 
-    globals->device_context4->OMSetRenderTargets(1,
-                                                 target_ldr.get(),
-                                                 NULL);
+    globals->bindRenderTargets(1, target_ldr.get(), NULL);
 
-    globals->device_context4->PSSetShaderResources(0,
-                                                   1,
-                                                   source_hdr.get());
+    globals->bindPSShaderResources(0, 1, source_hdr.get());
     
     shader->bind();
 
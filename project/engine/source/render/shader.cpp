@@ -159,11 +159,18 @@ void Shader::bind()
 {
     Globals * globals = Globals::getInstance();
 
-    // bind shaders and input layout
-    globals->device_context4->VSSetShader(vert_shader.ptr(), 0, 0);
-    globals->device_context4->PSSetShader(frag_shader.ptr(), 0, 0);
-    globals->device_context4->GSSetShader(geom_shader.ptr(), 0, 0);
-    globals->device_context4->CSSetShader(comp_shader.ptr(), 0, 0);
-    globals->device_context4->IASetInputLayout(input_layout);
+    StateCache & cache = globals->state_cache;
+
+    // bind shaders and input layout, the ones already bound are skipped
+    if (cache.set(StateCache::State::VERTEX_SHADER, vert_shader.ptr()))
+        globals->device_context4->VSSetShader(vert_shader.ptr(), 0, 0);
+    if (cache.set(StateCache::State::PIXEL_SHADER, frag_shader.ptr()))
+        globals->device_context4->PSSetShader(frag_shader.ptr(), 0, 0);
+    if (cache.set(StateCache::State::GEOMETRY_SHADER, geom_shader.ptr()))
+        globals->device_context4->GSSetShader(geom_shader.ptr(), 0, 0);
+    if (cache.set(StateCache::State::COMPUTE_SHADER, comp_shader.ptr()))
+        globals->device_context4->CSSetShader(comp_shader.ptr(), 0, 0);
+    if (cache.set(StateCache::State::INPUT_LAYOUT, input_layout.ptr()))
+        globals->device_context4->IASetInputLayout(input_layout);
 }
 } // namespace engine
@@ -0,0 +1,49 @@
+#include "shadow_cache.hpp"
+
+namespace engine
+{
+void ShadowCache::begin(const glm::vec3 * positions, uint32_t cubemaps_count)
+{
+    this->cubemaps_count = cubemaps_count;
+
+    signatures.resize(cubemaps_count * FACES_COUNT);
+    face_masks.assign(cubemaps_count, 0);
+
+    for (uint32_t c = 0; c != cubemaps_count; ++c)
+    {
+        uint64_t signature = hashBytes(&positions[c], sizeof(glm::vec3));
+
+        for (uint32_t face = 0; face != FACES_COUNT; ++face)
+            signatures[c * FACES_COUNT + face] = signature;
+    }
+}
+
+void ShadowCache::addCasters(uint32_t cubemap, uint32_t face, uint64_t signature)
+{
+    uint64_t & dst = signatures[cubemap * FACES_COUNT + face];
+    dst = hashBytes(&signature, sizeof(signature), dst);
+}
+
+void ShadowCache::end()
+{
+    invalid_faces_count = 0;
+
+    for (uint32_t c = 0; c != cubemaps_count; ++c)
+    {
+        for (uint32_t face = 0; face != FACES_COUNT; ++face)
+        {
+            uint32_t index = c * FACES_COUNT + face;
+
+            // new cubemaps were never rendered
+            if (c < rendered_count && signatures[index] == rendered_signatures[index])
+                continue;
+
+            face_masks[c] |= 1u << face;
+            ++invalid_faces_count;
+        }
+    }
+
+    rendered_signatures = signatures;
+    rendered_count = cubemaps_count;
+}
+} // namespace engine
@@ -0,0 +1,71 @@
+#ifndef SHADOW_CACHE_HPP
+#define SHADOW_CACHE_HPP
+
+#include "glm.hpp"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace engine
+{
+// 64-bit FNV-1a, seed is the hash of the previous data
+inline uint64_t hashBytes(const void * data, size_t size, uint64_t seed = 14695981039346656037ull)
+{
+    const uint8_t * bytes = static_cast<const uint8_t *>(data);
+
+    for (size_t i = 0; i != size; ++i)
+        seed = (seed ^ bytes[i]) * 1099511628211ull;
+
+    return seed;
+}
+
+// Remembers what every face of the shadow cubemaps was rendered from.
+// The signature of a face is the position of its light and the casters
+// which were drawn into it, so a face is invalidated when the light moves
+// or when its casters are moved, spawned or despawned.
+// Other faces keep their depth from the previous frames.
+// Doesn't depend on D3D, the renderer clears and draws only getFaceMask() faces.
+class ShadowCache
+{
+public:
+    static constexpr uint32_t FACES_COUNT = 6;
+
+    // starts a frame, one position per cubemap
+    void begin(const glm::vec3 * positions, uint32_t cubemaps_count);
+
+    // combines the signature of the casters of one source with the face signature,
+    // the sources have to be added in the same order every frame
+    void addCasters(uint32_t cubemap, uint32_t face, uint64_t signature);
+
+    // compares the signatures with the rendered ones,
+    // the invalid faces are considered rendered after this call
+    void end();
+
+    // bit i - the i-th face of the cubemap has to be rendered
+    uint8_t getFaceMask(uint32_t cubemap) const { return face_masks[cubemap]; }
+    bool isFaceInvalid(uint32_t cubemap, uint32_t face) const
+    {
+        return face_masks[cubemap] & (1u << face);
+    }
+
+    uint32_t getCubemapsCount() const { return cubemaps_count; }
+
+    // for the last frame
+    uint32_t getInvalidFacesCount() const { return invalid_faces_count; }
+    uint32_t getSavedFacesCount() const { return cubemaps_count * FACES_COUNT - invalid_faces_count; }
+
+    // e.g. the shadow map was recreated
+    void invalidate() { rendered_count = 0; }
+
+protected:
+    uint32_t cubemaps_count = 0;
+    uint32_t rendered_count = 0; // cubemaps with valid rendered signatures
+    uint32_t invalid_faces_count = 0;
+
+    std::vector<uint64_t> signatures; // per face of the current frame
+    std::vector<uint64_t> rendered_signatures; // per face
+    std::vector<uint8_t> face_masks; // per cubemap
+};
+} // namespace engine
+
+#endif
@@ -0,0 +1,85 @@
+#include "shadow_casters.hpp"
+
+#include <algorithm>
+#include "thread_pool.hpp"
+
+namespace
+{
+// closer than the far plane of the cubemap
+bool isBoxNear(const math::BoxBatch & boxes, uint32_t index, const glm::vec3 & position)
+{
+    glm::vec3 min(boxes.min_x[index], boxes.min_y[index], boxes.min_z[index]);
+    glm::vec3 max(boxes.max_x[index], boxes.max_y[index], boxes.max_z[index]);
+
+    glm::vec3 offset = glm::clamp(position, min, max) - position;
+    float distance_2 = glm::dot(offset, offset);
+
+    return distance_2 <= engine::LightSystem::SHADOW_FAR * engine::LightSystem::SHADOW_FAR;
+}
+} // namespace
+
+namespace engine
+{
+void ShadowCasters::update(const std::vector<LightSystem::ShadowCubemap> & cubemaps,
+                           uint32_t cubemaps_count,
+                           const math::BoxBatch & boxes,
+                           const std::vector<InstanceRange> & bucket_ranges)
+{
+    this->cubemaps_count = std::min(cubemaps_count, uint32_t(cubemaps.size()));
+    buckets_count = uint32_t(bucket_ranges.size());
+
+    uint32_t instances_count = boxes.size();
+    uint32_t lists_count = this->cubemaps_count * FACES_COUNT * buckets_count;
+
+    is_near.resize(this->cubemaps_count * instances_count);
+    visibility.resize(this->cubemaps_count * FACES_COUNT * instances_count);
+
+    // one task per cubemap, the faces of a light share the distance test
+    ThreadPool::getInstance()->parallelFor(
+        this->cubemaps_count,
+        1,
+        [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t c = begin; c != end; ++c)
+            {
+                uint8_t * near_mask = is_near.data() + c * instances_count;
+                for (uint32_t i = 0; i != instances_count; ++i)
+                    near_mask[i] = isBoxNear(boxes, i, cubemaps[c].position);
+
+                for (uint32_t face = 0; face != FACES_COUNT; ++face)
+                {
+                    uint8_t * visible = visibility.data() + (c * FACES_COUNT + face) * instances_count;
+
+                    math::cullBoxes(cubemaps[c].faces[face], boxes, 0, instances_count, visible);
+
+                    for (uint32_t i = 0; i != instances_count; ++i)
+                        visible[i] &= near_mask[i];
+                }
+            }
+        });
+
+    indices.clear();
+    offsets.resize(lists_count + 1);
+
+    uint32_t list = 0;
+    for (uint32_t c = 0; c != this->cubemaps_count; ++c)
+    {
+        for (uint32_t face = 0; face != FACES_COUNT; ++face)
+        {
+            const uint8_t * visible = visibility.data() + (c * FACES_COUNT + face) * instances_count;
+
+            for (uint32_t bucket = 0; bucket != buckets_count; ++bucket)
+            {
+                offsets[list++] = uint32_t(indices.size());
+
+                const InstanceRange & range = bucket_ranges[bucket];
+                for (uint32_t i = range.begin, end = range.begin + range.count; i != end; ++i)
+                {
+                    if (visible[i]) indices.push_back(i);
+                }
+            }
+        }
+    }
+    offsets[list] = uint32_t(indices.size());
+}
+} // namespace engine
@@ -0,0 +1,220 @@
+#ifndef SHADOW_CASTERS_HPP
+#define SHADOW_CASTERS_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include "frustum.hpp"
+#include "light_system.hpp"
+#include "vertex_buffer.hpp"
+#include "globals.hpp"
+#include "model.hpp"
+#include "shadow_cache.hpp"
+#include "instance_staging.hpp"
+
+namespace engine
+{
+// Lists of the instances which can cast a shadow into each face
+// of each point light cubemap. Instances are culled by the shadow distance
+// of the light and then by the frustum of the face.
+// The lists are ordered as cubemap -> face -> bucket,
+// so the casters of one bucket can be drawn by one instanced draw per face.
+class ShadowCasters
+{
+public:
+    static constexpr uint32_t FACES_COUNT = 6;
+
+    struct Range
+    {
+        uint32_t begin; // index in getIndices()
+        uint32_t count;
+    };
+
+    // boxes are the world boxes of the packed instances,
+    // bucket_ranges - which of them belong to each bucket,
+    // the boxes out of the ranges aren't used
+    void update(const std::vector<LightSystem::ShadowCubemap> & cubemaps,
+                uint32_t cubemaps_count,
+                const math::BoxBatch & boxes,
+                const std::vector<InstanceRange> & bucket_ranges);
+
+    Range getRange(uint32_t cubemap, uint32_t face, uint32_t bucket) const
+    {
+        uint32_t list = (cubemap * FACES_COUNT + face) * buckets_count + bucket;
+        return {offsets[list], offsets[list + 1] - offsets[list]};
+    }
+
+    uint32_t getCubemapsCount() const { return cubemaps_count; }
+
+    // packed indices of the casters
+    const std::vector<uint32_t> & getIndices() const { return indices; }
+
+    // adds the signature of the casters of each face to the cache,
+    // hash(uint32_t index) has to cover everything which changes the shadow of the packed instance
+    template <class Hash>
+    void addSignatures(ShadowCache & cache, Hash && hash) const
+    {
+        for (uint32_t c = 0; c != cubemaps_count; ++c)
+        {
+            for (uint32_t face = 0; face != FACES_COUNT; ++face)
+            {
+                uint64_t signature = hashBytes(&buckets_count, sizeof(buckets_count));
+
+                for (uint32_t bucket = 0; bucket != buckets_count; ++bucket)
+                {
+                    Range range = getRange(c, face, bucket);
+                    signature = hashBytes(&range.count, sizeof(range.count), signature);
+
+                    for (uint32_t i = range.begin, end = range.begin + range.count; i != end; ++i)
+                    {
+                        uint64_t caster = hash(indices[i]);
+                        signature = hashBytes(&caster, sizeof(caster), signature);
+                    }
+                }
+
+                cache.addCasters(c, face, signature);
+            }
+        }
+    }
+
+    // copies the casters in the order of getIndices(),
+    // the buffer is recreated only when it's too small
+    template <class GPUInstance>
+    void fillBuffer(const GPUInstance * instances, VertexBuffer<GPUInstance> & buffer) const
+    {
+        if (indices.empty()) return;
+
+        if (buffer.get_size() < indices.size())
+            buffer.init(uint32_t(indices.size()) * 2);
+
+        D3D11_MAPPED_SUBRESOURCE mapped = buffer.map();
+        GPUInstance * dst = static_cast<GPUInstance *>(mapped.pData);
+
+        for (uint32_t i = 0, size = indices.size(); i != size; ++i)
+            dst[i] = instances[indices[i]];
+
+        buffer.unmap();
+    }
+
+    // update() from all the instances of the InstanceGroup, boxes are from
+    // InstanceGroup::computeWorldBoxes(), the shadow of an instance
+    // depends only on its mesh and GPUInstance::transform
+    template <class Group, class GPUInstance>
+    void updateGroup(const Group & group,
+                     const InstanceStaging<GPUInstance> & staging,
+                     const math::BoxBatch & boxes,
+                     uint32_t cubemaps_count,
+                     ShadowCache & cache)
+    {
+        group.getBucketRanges(bucket_ranges);
+        update(LightSystem::getInstance()->getShadowCubemaps(), cubemaps_count, boxes, bucket_ranges);
+
+        const GPUInstance * instances = staging.data();
+        addSignatures(cache, [instances](uint32_t index)
+        {
+            return hashBytes(&instances[index].transform, sizeof(glm::mat4));
+        });
+    }
+
+    // draws the casters found by updateGroup() without the material textures,
+    // the blend state has to be bound
+    template <class Group, class GPUInstance>
+    void renderGroup(const Group & group,
+                     const ShadowCache & cache,
+                     const InstanceStaging<GPUInstance> & staging,
+                     VertexBuffer<GPUInstance> & buffer) const
+    {
+        if (indices.empty()) return;
+        fillBuffer(staging.data(), buffer);
+
+        Globals * globals = Globals::getInstance();
+
+        globals->device_context4->
+            IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+        buffer.bind(1);
+
+        render(group, cache, [globals](Model::MeshRange & mesh_range,
+                                       const auto & material)
+        {
+            globals->bindRasterizer(material.is_double_sided);
+
+            globals->setPerShadowMeshBuffer(mesh_range.mesh_to_model);
+            globals->updatePerShadowMeshBuffer();
+        });
+    }
+
+    // draws the casters of each bucket of the InstanceGroup into the faces they intersect,
+    // only the faces invalidated in the cache are drawn, the caster buffer has to be bound,
+    // bind_mesh(Model::MeshRange &, const Material &) is called before the draws of a bucket
+    template <class Group, class BindMesh>
+    void render(const Group & group, const ShadowCache & cache, BindMesh && bind_mesh) const
+    {
+        Globals * globals = Globals::getInstance();
+
+        uint32_t bucket = 0;
+        for (auto & per_model : group.per_model)
+        {
+            bool is_model_bound = false;
+
+            for (uint32_t i = 0, size = per_model.per_mesh.size(); i != size; ++i)
+            {
+                Model::MeshRange & mesh_range = per_model.model->getMeshRange(i);
+
+                for (auto & per_material : per_model.per_mesh[i].per_material)
+                {
+                    bool is_mesh_bound = false;
+
+                    for (uint32_t c = 0; c != cubemaps_count; ++c)
+                    {
+                        for (uint32_t face = 0; face != FACES_COUNT; ++face)
+                        {
+                            if (!cache.isFaceInvalid(c, face)) continue;
+
+                            Range range = getRange(c, face, bucket);
+                            if (range.count == 0) continue;
+
+                            // models and meshes without casters aren't bound at all
+                            if (!is_model_bound)
+                            {
+                                per_model.model->bind();
+                                is_model_bound = true;
+                            }
+                            if (!is_mesh_bound)
+                            {
+                                bind_mesh(mesh_range, per_material.material);
+                                is_mesh_bound = true;
+                            }
+
+                            globals->setPerShadowCubemapBuffer(c, 1u << face);
+                            globals->updatePerShadowCubemapBuffer();
+
+                            globals->device_context4->DrawIndexedInstanced(mesh_range.index_count,
+                                                                           range.count,
+                                                                           mesh_range.index_offset,
+                                                                           mesh_range.vertex_offset,
+                                                                           range.begin);
+                        }
+                    }
+
+                    ++bucket;
+                }
+            }
+        }
+    }
+
+protected:
+    uint32_t cubemaps_count = 0;
+    uint32_t buckets_count = 0;
+
+    std::vector<uint8_t> is_near; // per cubemap and instance
+    std::vector<uint8_t> visibility; // per cubemap face and instance
+
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> offsets; // list -> begin in indices, the last one is the end
+
+    std::vector<InstanceRange> bucket_ranges; // reused by updateGroup()
+};
+} // namespace engine
+
+#endif
@@ -1,14 +1,21 @@
 #include "smoke_emitter.hpp"
 
+#include <cmath>
+#include <algorithm>
+#include "spdlog.h"
+
 namespace
 {
 constexpr float PARTICLE_INIT_SIZE = 1.0f;
 constexpr float PARTICLE_INIT_THICKNESS = 1.0f; // contact fading range
+
+// spawn_rate 0 spawns a particle every update()
+constexpr uint32_t MAX_PARTICLES_COUNT = 4096;
 } // namespace
 
 namespace engine
 {
-SmokeEmitter::SmokeEmitter(const glm::vec3 & position,
+SmokeEmitter::SmokeEmitter(uint32_t transform_id,
                            float radius,
                            const glm::vec3 & tint,
                            float spawn_rate,
@@ -16,7 +23,7 @@ SmokeEmitter::SmokeEmitter(const glm::vec3 & position,
                            float resize_speed,
                            float life_speed,
                            float appear_lifetime_value) :
-                           position(position),
+                           transform_id(transform_id),
                            radius(radius),
                            tint(tint),
                            spawn_rate(spawn_rate),
@@ -27,6 +34,13 @@ SmokeEmitter::SmokeEmitter(const glm::vec3 & position,
 {
     this->appear_speed = life_speed / appear_lifetime_value;
     this->disappear_speed = life_speed / (1.0f - appear_lifetime_value);
+
+    // a particle lives 1 / life_speed seconds, at most one is spawned per update(),
+    // the product is clamped, so zero rates don't overflow the capacity
+    float spawns_per_lifetime = 1.0f / std::max(life_speed * spawn_rate,
+                                                1.0f / MAX_PARTICLES_COUNT);
+    uint32_t capacity = uint32_t(std::ceil(spawns_per_lifetime)) + 1;
+    particles = ParticlePool(capacity);
 }
 
 bool SmokeEmitter::spawnTimeElapsed()
@@ -41,47 +55,44 @@ bool SmokeEmitter::spawnTimeElapsed()
 
 void SmokeEmitter::spawnParticle()
 {
-    glm::vec3 pos = glm::vec3(math::randomFromRange(position.x - radius, position.x + radius),
-                              position.y,
-                              math::randomFromRange(position.z - radius, position.z + radius));
+    // the emitter stops when its transform is erased
+    const glm::mat4x3 * world = TransformSystem::getInstance()->findWorld(transform_id);
+    if (!world) return;
+
+    glm::vec3 position = (*world)[3];
+
+    math::Random & random = math::getThreadRandom();
 
-    float angle = math::randomFromRange(0.0f, 2.0f * math::PI);
+    glm::vec3 pos = random.range(position - glm::vec3(radius, 0.0f, radius),
+                                 position + glm::vec3(radius, 0.0f, radius));
+
+    float angle = random.angle();
     
-    particles.push_back(Particle(pos,
-                                 glm::vec2(PARTICLE_INIT_SIZE),
-                                 PARTICLE_INIT_THICKNESS,
-                                 angle,
-                                 glm::vec4(tint, 0.0f)));
+    bool is_spawned = particles.spawn(pos,
+                                      PARTICLE_INIT_SIZE,
+                                      PARTICLE_INIT_THICKNESS,
+                                      angle,
+                                      glm::vec4(tint, 0.0f));
+
+    if (!is_spawned)
+        spdlog::warn("SmokeEmitter: the pool of {} particles is full, a particle was dropped",
+                     particles.capacity());
 }
 
 void SmokeEmitter::update(float delta_time)
 {
     if (spawnTimeElapsed()) spawnParticle();
 
-    for (uint32_t i = 0; i != particles.size(); ++i)
-    {
-        particles[i].lifetime += life_speed * delta_time;
-
-        if (particles[i].lifetime >= 1.0f ||
-            particles[i].tint.w < 0.0f)
-        {
-            particles.erase(particles.begin() + i);
-            --i;
-            continue;
-        }
-
-        particles[i].position.y += movement_speed * delta_time;
-        particles[i].size += glm::vec2(resize_speed * delta_time);
-        particles[i].thickness += resize_speed * delta_time;
-        
-        if (particles[i].lifetime < appear_lifetime_value)
-            particles[i].tint.w += appear_speed * delta_time;
-        else
-            particles[i].tint.w -= disappear_speed * delta_time;
-    }
+    particles.update({life_speed,
+                      movement_speed,
+                      resize_speed,
+                      appear_lifetime_value,
+                      appear_speed,
+                      disappear_speed},
+                     delta_time);
 }
 
-const std::vector<Particle> & SmokeEmitter::getParticles() const
+const ParticlePool & SmokeEmitter::getParticles() const
 {
     return particles;
 }
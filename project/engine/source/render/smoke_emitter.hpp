@@ -4,19 +4,20 @@
 #include "glm.hpp"
 #include <vector>
 
-#include "particle.hpp"
+#include "particle_pool.hpp"
 #include "texture_manager.hpp"
 #include "shader_manager.hpp"
 #include "constants.hpp"
 #include "random.hpp"
 #include "timer.hpp"
+#include "transform_system.hpp"
 
 namespace engine
 {
 class SmokeEmitter
 {
 public:
-    SmokeEmitter(const glm::vec3 & position,
+    SmokeEmitter(uint32_t transform_id,
                  float radius,
                  const glm::vec3 & tint,
                  float spawn_rate,
@@ -27,15 +28,15 @@ public:
 
     void update(float delta_time);
     
-    glm::vec3 position;
+    uint32_t transform_id; // particles are spawned around its world position
     float radius;
-    glm::vec3 tint; // this value copied to Particle::tint
+    glm::vec3 tint; // this value is copied to the tint of the spawned particles
     
     float spawn_rate; // in seconds
     float movement_speed;
     float resize_speed;
 
-    const std::vector<Particle> & getParticles() const;
+    const ParticlePool & getParticles() const;
     
 private:
     float life_speed;
@@ -48,7 +49,8 @@ private:
 
     void spawnParticle();
     
-    std::vector<Particle> particles;
+    // enough for all the particles which can be alive at once
+    ParticlePool particles;
 
     Timer timer;
 };
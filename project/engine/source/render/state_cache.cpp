@@ -0,0 +1,46 @@
+#include "state_cache.hpp"
+
+namespace engine
+{
+bool StateCache::set(State state, const void * value)
+{
+    const void *& bound = states[uint32_t(state)];
+
+    bool is_changed = bound != value;
+    bound = value;
+
+    return countCall(is_changed);
+}
+
+bool StateCache::setVertexBuffer(uint32_t slot, const void * buffer, uint32_t stride, uint32_t offset)
+{
+    VertexBuffer & bound = vertex_buffers[slot];
+
+    bool is_changed = bound.buffer != buffer || bound.stride != stride || bound.offset != offset;
+    bound = {buffer, stride, offset};
+
+    return countCall(is_changed);
+}
+
+void StateCache::invalidate()
+{
+    for (const void *& state : states) state = unknown();
+    for (VertexBuffer & vertex_buffer : vertex_buffers) vertex_buffer = {unknown(), 0, 0};
+
+    invalidatePixelSRVs();
+}
+
+void StateCache::invalidatePixelSRVs()
+{
+    for (const void *& srv : pixel_srvs) srv = unknown();
+}
+
+void StateCache::beginFrame()
+{
+    last_issued_count = issued_count;
+    last_skipped_count = skipped_count;
+
+    issued_count = 0;
+    skipped_count = 0;
+}
+} // namespace engine
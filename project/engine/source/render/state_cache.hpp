@@ -0,0 +1,97 @@
+#ifndef STATE_CACHE_HPP
+#define STATE_CACHE_HPP
+
+#include <cstdint>
+
+namespace engine
+{
+// Shadow copy of the pipeline state bound through Globals, Shader, Texture and vertex buffers.
+// set*() returns true if the value differs from the bound one and the D3D call has to be issued,
+// otherwise the call is counted as skipped.
+// Only pointers are compared, so it doesn't depend on D3D. A bound object can't be
+// replaced by a new one at the same address, because D3D keeps a reference to it.
+class StateCache
+{
+public:
+    enum class State : uint32_t
+    {
+        RASTERIZER,
+        BLEND_STATE,
+        VERTEX_SHADER,
+        PIXEL_SHADER,
+        GEOMETRY_SHADER,
+        COMPUTE_SHADER,
+        INPUT_LAYOUT,
+        COUNT
+    };
+
+    static constexpr uint32_t SRV_SLOTS_COUNT = 128; // D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT
+    static constexpr uint32_t VERTEX_BUFFER_SLOTS_COUNT = 32; // D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT
+
+    StateCache() { invalidate(); }
+
+    bool set(State state, const void * value);
+
+    bool setVertexBuffer(uint32_t slot, const void * buffer, uint32_t stride, uint32_t offset);
+
+    // one call for the range, issued if at least one slot differs
+    template <class T>
+    bool setPixelSRVs(uint32_t first_slot, uint32_t count, T * const * srvs)
+    {
+        bool is_changed = false;
+
+        for (uint32_t i = 0; i != count; ++i)
+        {
+            if (pixel_srvs[first_slot + i] == srvs[i]) continue;
+
+            pixel_srvs[first_slot + i] = srvs[i];
+            is_changed = true;
+        }
+
+        return countCall(is_changed);
+    }
+
+    // the next calls are issued, e.g. the state was changed bypassing the cache
+    void invalidate();
+
+    // D3D unbinds the SRVs of the resources bound as render targets or UAVs
+    void invalidatePixelSRVs();
+
+    // starts counting the calls of a new frame
+    void beginFrame();
+
+    // of the last frame
+    uint32_t getIssuedCount() const { return last_issued_count; }
+    uint32_t getSkippedCount() const { return last_skipped_count; }
+
+protected:
+    struct VertexBuffer
+    {
+        const void * buffer;
+        uint32_t stride;
+        uint32_t offset;
+    };
+
+    // never equal to a bound pointer, including nullptr
+    static const void * unknown() { return reinterpret_cast<const void *>(UINTPTR_MAX); }
+
+    bool countCall(bool is_issued)
+    {
+        if (is_issued) ++issued_count;
+        else ++skipped_count;
+
+        return is_issued;
+    }
+
+    const void * states[uint32_t(State::COUNT)];
+    const void * pixel_srvs[SRV_SLOTS_COUNT];
+    VertexBuffer vertex_buffers[VERTEX_BUFFER_SLOTS_COUNT];
+
+    uint32_t issued_count = 0;
+    uint32_t skipped_count = 0;
+    uint32_t last_issued_count = 0;
+    uint32_t last_skipped_count = 0;
+};
+} // namespace engine
+
+#endif
@@ -21,8 +21,6 @@ void Texture::bind(uint32_t slot)
 {
     Globals * globals = Globals::getInstance();
 
-    globals->device_context4->PSSetShaderResources(slot,
-                                                   1,
-                                                   texture_view.get());
+    globals->bindPSShaderResources(slot, 1, texture_view.get());
 }
 } // namespace engine
@@ -89,6 +89,8 @@ public:
     {
         Globals * globals = Globals::getInstance();
 
+        if (!globals->state_cache.setVertexBuffer(slot, data.ptr(), stride, offset)) return;
+
         globals->device_context4->IASetVertexBuffers(slot,
                                                      1,
                                                      data.get(),
@@ -158,9 +158,7 @@ void Window::bindRenderTarget()
 {
     Globals * globals = Globals::getInstance();
 
-    globals->device_context4->OMSetRenderTargets(1,
-                                                 LDR_RTV.get(),
-                                                 NULL);
+    globals->bindRenderTargets(1, LDR_RTV.get(), NULL);
 }
 
 void Window::bindViewport()
@@ -30,10 +30,16 @@ void Renderer::renderFrame(windows::Window & window,
 {
     Globals * globals = Globals::getInstance();
     MeshSystem * mesh_sys = MeshSystem::getInstance();
+    LightSystem * light_sys = LightSystem::getInstance();
+
+    globals->state_cache.beginFrame();
 
     RECT client_size = window.getClientSize();
     int width = client_size.right - client_size.left;
     int height = client_size.bottom - client_size.top;
+
+    // the per frame buffer takes the light matrices from the shadow cubemaps
+    light_sys->updateShadowCubemaps();
     
     globals->setPerFrameBuffer(REFLECTION_MIPS_COUNT,
                                SHADOW_MAP_SIZE,
@@ -43,6 +49,10 @@ void Renderer::renderFrame(windows::Window & window,
                                g_SPARKS_DATA_BUFFER_SIZE);
     globals->updatePerFrameBuffer();
 
+    // the per view buffer takes the cluster depth slicing
+    light_sys->updateLightClusters(camera);
+    light_sys->bindLightClustersSRV(15);
+
     globals->setPerViewBuffer(camera,
                               post_process.EV_100);
     globals->updatePerViewBuffer();
@@ -58,8 +68,8 @@ void Renderer::renderFrame(windows::Window & window,
     bindGBufferRTV();
     clearGBuffer();
     
-    renderSceneObjects(window);
-    renderGrass();
+    renderSceneObjects(window, camera);
+    renderGrass(camera);
     renderDecals();
 
     unbindRTVs();
@@ -251,15 +261,11 @@ void Renderer::bindRenderTarget(bool bind_depth_buffer)
 
     if (bind_depth_buffer)
     {
-        globals->device_context4->OMSetRenderTargets(1,
-                                                     hdr_rtv.get(),
-                                                     depth_dsv.ptr());
+        globals->bindRenderTargets(1, hdr_rtv.get(), depth_dsv.ptr());
     }
     else
     {
-        globals->device_context4->OMSetRenderTargets(1,
-                                                     hdr_rtv.get(),
-                                                     NULL);   
+        globals->bindRenderTargets(1, hdr_rtv.get(), NULL);   
     }
 }
 
@@ -279,25 +285,15 @@ void Renderer::bindGBufferSRV()
 {
     Globals * globals = Globals::getInstance();
 
-    globals->device_context4->PSSetShaderResources(0,
-                                                   1,
-                                                   normals_srv.get());
+    globals->bindPSShaderResources(0, 1, normals_srv.get());
 
-    globals->device_context4->PSSetShaderResources(1,
-                                                   1,
-                                                   albedo_srv.get());
+    globals->bindPSShaderResources(1, 1, albedo_srv.get());
 
-    globals->device_context4->PSSetShaderResources(2,
-                                                   1,
-                                                   roughness_metalness_srv.get());
+    globals->bindPSShaderResources(2, 1, roughness_metalness_srv.get());
 
-    globals->device_context4->PSSetShaderResources(3,
-                                                   1,
-                                                   emissive_ao_srv.get());
+    globals->bindPSShaderResources(3, 1, emissive_ao_srv.get());
 
-    globals->device_context4->PSSetShaderResources(4,
-                                                   1,
-                                                   model_id_srv.get());
+    globals->bindPSShaderResources(4, 1, model_id_srv.get());
 }
 
 void Renderer::bindGBufferRTV(bool bind_depth_buffer,
@@ -315,15 +311,15 @@ void Renderer::bindGBufferRTV(bool bind_depth_buffer,
 
     if (bind_depth_buffer)
     {
-        globals->device_context4->OMSetRenderTargets(render_targets.size(),
-                                                     render_targets.data(),
-                                                     depth_dsv.ptr());
+        globals->bindRenderTargets(render_targets.size(),
+                                   render_targets.data(),
+                                   depth_dsv.ptr());
     }
     else
     {
-        globals->device_context4->OMSetRenderTargets(render_targets.size(),
-                                                     render_targets.data(),
-                                                     NULL);
+        globals->bindRenderTargets(render_targets.size(),
+                                   render_targets.data(),
+                                   NULL);
     }
 }
 
@@ -361,9 +357,7 @@ void Renderer::unbindSRV(int slot)
                                                    1,
                                                    &null_resource);
 
-    globals->device_context4->PSSetShaderResources(slot,
-                                                   1,
-                                                   &null_resource);
+    globals->bindPSShaderResources(slot, 1, &null_resource);
 }
 
 void Renderer::unbindSRVs()
@@ -382,18 +376,19 @@ void Renderer::unbindRTVs()
     Globals * globals = Globals::getInstance();
 
     // unbind all render targets
-    globals->device_context4->OMSetRenderTargets(0,
-                                                 nullptr,
-                                                 nullptr);
+    globals->bindRenderTargets(0, nullptr, nullptr);
 }
 
-void Renderer::renderSceneObjects(windows::Window & window)
+void Renderer::renderSceneObjects(windows::Window & window,
+                                  const Camera & camera)
 {
     MeshSystem * mesh_system = MeshSystem::getInstance();
     
     window.bindViewport();
         
-    mesh_system->render();
+    mesh_system->render(math::Frustum::fromViewProj(camera.getViewProj()),
+                        camera.getPosition(),
+                        camera.getForward());
 }
 
 void Renderer::renderShadows()
@@ -402,6 +397,14 @@ void Renderer::renderShadows()
     LightSystem * light_system = LightSystem::getInstance();
     MeshSystem * mesh_system = MeshSystem::getInstance();
     GrassSystem * grass_system = GrassSystem::getInstance();
+
+    // faces whose light and casters weren't changed keep their depth
+    ShadowCache & shadow_cache = light_system->getShadowCache();
+    mesh_system->updateShadowCasters(SHADOW_CUBEMAPS_COUNT, shadow_cache);
+    grass_system->updateShadowCasters(SHADOW_CUBEMAPS_COUNT, shadow_cache);
+    shadow_cache.end();
+
+    if (shadow_cache.getInvalidFacesCount() == 0) return;
     
     globals->bindDefaultBlendState();
     
@@ -410,8 +413,8 @@ void Renderer::renderShadows()
     light_system->bindShadowMap();
     light_system->clearShadowMap();
 
-    mesh_system->renderShadowCubeMaps(SHADOW_CUBEMAPS_COUNT);
-    grass_system->renderWithoutMaterials(SHADOW_CUBEMAPS_COUNT);
+    mesh_system->renderShadowCubeMaps(shadow_cache);
+    grass_system->renderWithoutMaterials(shadow_cache);
 }
 
 void Renderer::renderParticles(float delta_time,
@@ -433,11 +436,12 @@ void Renderer::renderParticles(float delta_time,
     changeDepthBufferAccess(false);
 }
 
-void Renderer::renderGrass()
+void Renderer::renderGrass(const Camera & camera)
 {
     engine::GrassSystem * grass_system = engine::GrassSystem::getInstance();
 
-    grass_system->render();
+    grass_system->render(math::Frustum::fromViewProj(camera.getViewProj()),
+                         camera.getPosition());
 }
 
 void Renderer::renderDecals()
@@ -829,9 +833,7 @@ void Renderer::deferredShading()
     bindGBufferSRV();
 
     copyDepthBuffer();
-    globals->device_context4->PSSetShaderResources(5,
-                                                   1,
-                                                   depth_copy_srv.get());
+    globals->bindPSShaderResources(5, 1, depth_copy_srv.get());
     
     deferred_shader->bind();
     reflectance->bind(6);
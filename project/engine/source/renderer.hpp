@@ -99,11 +99,12 @@ private:
     DxResPtr<ID3D11RenderTargetView> hdr_rtv;
     DxResPtr<ID3D11ShaderResourceView> hdr_srv;
     
-    void renderSceneObjects(windows::Window & window);
+    void renderSceneObjects(windows::Window & window,
+                            const Camera & camera);
     void renderShadows();
     void renderParticles(float delta_time,
                          const Camera & camera);
-    void renderGrass();
+    void renderGrass(const Camera & camera);
     void renderDecals();
 
     void initDepthBufferMain(int width, int height);
@@ -0,0 +1,125 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include "spdlog.h"
+
+namespace engine
+{
+ThreadPool * ThreadPool::instance = nullptr;
+
+void ThreadPool::init()
+{
+    if (!instance) instance = new ThreadPool();
+    else spdlog::error("ThreadPool::init() was called twice!");
+}
+
+ThreadPool * ThreadPool::getInstance()
+{
+    return instance;
+}
+
+void ThreadPool::del()
+{
+    if (instance)
+    {
+        delete instance;
+        instance = nullptr;
+    }
+    else spdlog::error("ThreadPool::del() was called twice!");
+}
+
+ThreadPool::ThreadPool()
+{
+    // the main thread works too
+    uint32_t workers_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    for (uint32_t i = 0; i != workers_count; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        is_stopped = true;
+    }
+    job_cv.notify_all();
+
+    for (auto & worker : workers)
+        worker.join();
+}
+
+void ThreadPool::parallelFor(uint32_t count, uint32_t min_chunk, const Task & task)
+{
+    if (count == 0) return;
+
+    uint32_t threads_count = getThreadsCount();
+    uint32_t chunk = std::max(min_chunk, (count + threads_count - 1) / threads_count);
+
+    if (chunk >= count)
+    {
+        task(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> call_lock(call_mutex);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->count = count;
+        this->chunk = chunk;
+        next_begin = 0;
+        ++job_index;
+    }
+    job_cv.notify_all();
+
+    runChunks();
+
+    // workers can still execute their last chunks
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this]() { return active_workers == 0; });
+    this->task = nullptr;
+}
+
+void ThreadPool::workerLoop()
+{
+    uint32_t last_job_index = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_cv.wait(lock, [&]() { return is_stopped || job_index != last_job_index; });
+
+            if (is_stopped) return;
+
+            last_job_index = job_index;
+
+            // the job was already finished by the others
+            if (!task) continue;
+
+            ++active_workers;
+        }
+
+        runChunks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --active_workers;
+        }
+        done_cv.notify_one();
+    }
+}
+
+void ThreadPool::runChunks()
+{
+    while (true)
+    {
+        uint32_t begin = next_begin.fetch_add(chunk);
+        if (begin >= count) return;
+
+        (*task)(begin, std::min(begin + chunk, count));
+    }
+}
+} // namespace engine
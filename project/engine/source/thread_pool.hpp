@@ -0,0 +1,69 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+namespace engine
+{
+// Worker threads which are kept alive between frames,
+// so splitting a loop doesn't pay for the thread creation.
+class ThreadPool final
+{
+public:
+    using Task = std::function<void(uint32_t begin, uint32_t end)>;
+
+    // deleted methods should be public for better error messages
+    ThreadPool(const ThreadPool & other) = delete;
+    void operator=(const ThreadPool & other) = delete;
+
+    static void init();
+
+    static ThreadPool * getInstance();
+
+    static void del();
+
+    // workers + the calling thread
+    uint32_t getThreadsCount() const { return uint32_t(workers.size()) + 1; }
+
+    // splits [0, count) into chunks of at least min_chunk elements,
+    // the calling thread also takes chunks and returns when all of them are done,
+    // small loops are executed by the calling thread only
+    void parallelFor(uint32_t count, uint32_t min_chunk, const Task & task);
+
+private:
+    ThreadPool();
+    ~ThreadPool();
+
+    void workerLoop();
+
+    // takes chunks until none are left
+    void runChunks();
+
+    std::vector<std::thread> workers;
+
+    std::mutex call_mutex; // one parallelFor() at a time
+    std::mutex mutex;
+    std::condition_variable job_cv;
+    std::condition_variable done_cv;
+
+    // the current job, protected by mutex
+    const Task * task = nullptr;
+    uint32_t job_index = 0;
+    uint32_t active_workers = 0;
+    bool is_stopped = false;
+
+    uint32_t count = 0;
+    uint32_t chunk = 0;
+    std::atomic<uint32_t> next_begin{0};
+
+    static ThreadPool * instance;
+};
+} // namespace engine
+
+#endif
@@ -1,5 +1,21 @@
 #include "transform_system.hpp"
 
+namespace
+{
+// a * b for affine matrices, the last row (0, 0, 0, 1) is implied
+glm::mat4x3 combine(const glm::mat4x3 & a, const glm::mat4x3 & b)
+{
+    glm::mat4x3 result;
+
+    for (uint32_t i = 0; i != 4; ++i)
+        result[i] = a[0] * b[i].x + a[1] * b[i].y + a[2] * b[i].z;
+
+    result[3] += a[3];
+
+    return result;
+}
+} // namespace
+
 namespace engine
 {
 TransformSystem * TransformSystem::instance = nullptr;
@@ -24,4 +40,254 @@ void TransformSystem::del()
     }
     else spdlog::error("TransformSystem::del() was called twice!");
 }
+
+uint32_t TransformSystem::insert(const math::Transform & transform,
+                                 uint32_t parent_id)
+{
+    Hierarchy hierarchy;
+    hierarchy.parent_id = NO_PARENT;
+    hierarchy.first_child_id = NO_PARENT;
+    hierarchy.prev_sibling_id = NO_PARENT;
+    hierarchy.next_sibling_id = NO_PARENT;
+    hierarchy.is_dirty = false;
+
+    glm::mat4x3 identity(1.0f);
+
+    uint32_t transform_id = nodes.insert(transform,
+                                         hierarchy,
+                                         identity,
+                                         identity,
+                                         identity,
+                                         identity);
+    link(transform_id, parent_id);
+    markDirty(transform_id);
+
+    return transform_id;
+}
+
+void TransformSystem::erase(uint32_t transform_id)
+{
+    uint32_t parent_id = nodes.get<HIERARCHY>(transform_id).parent_id;
+
+    // children keep their local transforms relative to the new parent
+    while (nodes.get<HIERARCHY>(transform_id).first_child_id != NO_PARENT)
+    {
+        uint32_t child_id = nodes.get<HIERARCHY>(transform_id).first_child_id;
+
+        unlink(child_id);
+        link(child_id, parent_id);
+        markDirty(child_id);
+    }
+
+    unlink(transform_id);
+
+    // the last node is moved in place of the erased one,
+    // links are ids, so they stay valid
+    nodes.erase(transform_id);
+}
+
+void TransformSystem::setParent(uint32_t transform_id, uint32_t parent_id)
+{
+    if (nodes.get<HIERARCHY>(transform_id).parent_id == parent_id) return;
+
+    // the transform can't become a child of its own subtree
+    for (uint32_t id = parent_id; id != NO_PARENT; id = nodes.get<HIERARCHY>(id).parent_id)
+        assert(id != transform_id && "TransformSystem::setParent()");
+
+    unlink(transform_id);
+    link(transform_id, parent_id);
+
+    markDirty(transform_id);
+}
+
+uint32_t TransformSystem::getParent(uint32_t transform_id) const
+{
+    return nodes.get<HIERARCHY>(transform_id).parent_id;
+}
+
+const math::Transform & TransformSystem::getTransform(uint32_t transform_id) const
+{
+    return nodes.get<TRANSFORM>(transform_id);
+}
+
+math::Transform & TransformSystem::modifyTransform(uint32_t transform_id)
+{
+    markDirty(transform_id);
+
+    return nodes.get<TRANSFORM>(transform_id);
+}
+
+math::Transform * TransformSystem::tryModifyTransform(uint32_t transform_id)
+{
+    if (!nodes.valid(transform_id)) return nullptr;
+
+    return &modifyTransform(transform_id);
+}
+
+const glm::mat4x3 & TransformSystem::getWorld(uint32_t transform_id)
+{
+    if (!dirty_ids.empty()) updateMatrices();
+
+    return nodes.get<WORLD>(transform_id);
+}
+
+const glm::mat4x3 & TransformSystem::getWorldInv(uint32_t transform_id)
+{
+    if (!dirty_ids.empty()) updateMatrices();
+
+    return nodes.get<WORLD_INV>(transform_id);
+}
+
+const glm::mat4x3 * TransformSystem::findWorld(uint32_t transform_id)
+{
+    if (!dirty_ids.empty()) updateMatrices();
+
+    return nodes.find<WORLD>(transform_id);
+}
+
+void TransformSystem::updateMatrices()
+{
+    if (dirty_ids.empty()) return;
+
+    batch_ids.clear();
+    batch.clear();
+
+    // ids of erased transforms are skipped, the rest are unique
+    // because markDirty() doesn't add a dirty transform twice
+    for (uint32_t transform_id : dirty_ids)
+    {
+        if (!nodes.valid(transform_id)) continue;
+
+        uint32_t index = nodes.indexOf(transform_id);
+        if (!nodes.at<HIERARCHY>(index).is_dirty) continue;
+
+        batch_ids.push_back(index);
+        batch.push_back(nodes.at<TRANSFORM>(index));
+    }
+
+    // local matrices of the modified transforms
+    batch_local.resize(batch.size());
+    batch_local_inv.resize(batch.size());
+
+    math::computeAffineMatrices(batch, batch_local.data(), batch_local_inv.data());
+
+    std::vector<glm::mat4x3> & local = nodes.column<LOCAL>();
+    std::vector<glm::mat4x3> & local_inv = nodes.column<LOCAL_INV>();
+
+    for (uint32_t i = 0, size = batch_ids.size(); i != size; ++i)
+    {
+        local[batch_ids[i]] = batch_local[i];
+        local_inv[batch_ids[i]] = batch_local_inv[i];
+    }
+
+    // world matrices of the modified subtrees, a subtree inside
+    // another modified one is updated together with it
+    for (uint32_t index : batch_ids)
+    {
+        uint32_t transform_id = nodes.handleAt(index);
+        if (!hasDirtyAncestor(transform_id)) updateSubtree(transform_id);
+    }
+
+    for (uint32_t index : batch_ids)
+        nodes.at<HIERARCHY>(index).is_dirty = false;
+
+    dirty_ids.clear();
+}
+
+void TransformSystem::markDirty(uint32_t transform_id)
+{
+    Hierarchy & hierarchy = nodes.get<HIERARCHY>(transform_id);
+    if (hierarchy.is_dirty) return;
+
+    hierarchy.is_dirty = true;
+    dirty_ids.push_back(transform_id);
+}
+
+// the transform becomes the first child of the parent
+void TransformSystem::link(uint32_t transform_id, uint32_t parent_id)
+{
+    Hierarchy & hierarchy = nodes.get<HIERARCHY>(transform_id);
+    hierarchy.parent_id = parent_id;
+
+    if (parent_id == NO_PARENT) return;
+
+    Hierarchy & parent = nodes.get<HIERARCHY>(parent_id);
+    hierarchy.next_sibling_id = parent.first_child_id;
+
+    if (parent.first_child_id != NO_PARENT)
+        nodes.get<HIERARCHY>(parent.first_child_id).prev_sibling_id = transform_id;
+
+    parent.first_child_id = transform_id;
+}
+
+void TransformSystem::unlink(uint32_t transform_id)
+{
+    Hierarchy & hierarchy = nodes.get<HIERARCHY>(transform_id);
+    if (hierarchy.parent_id == NO_PARENT) return;
+
+    if (hierarchy.prev_sibling_id != NO_PARENT)
+        nodes.get<HIERARCHY>(hierarchy.prev_sibling_id).next_sibling_id = hierarchy.next_sibling_id;
+    else
+        nodes.get<HIERARCHY>(hierarchy.parent_id).first_child_id = hierarchy.next_sibling_id;
+
+    if (hierarchy.next_sibling_id != NO_PARENT)
+        nodes.get<HIERARCHY>(hierarchy.next_sibling_id).prev_sibling_id = hierarchy.prev_sibling_id;
+
+    hierarchy.parent_id = NO_PARENT;
+    hierarchy.prev_sibling_id = NO_PARENT;
+    hierarchy.next_sibling_id = NO_PARENT;
+}
+
+bool TransformSystem::hasDirtyAncestor(uint32_t transform_id) const
+{
+    for (uint32_t id = nodes.get<HIERARCHY>(transform_id).parent_id;
+         id != NO_PARENT;
+         id = nodes.get<HIERARCHY>(id).parent_id)
+    {
+        if (nodes.get<HIERARCHY>(id).is_dirty) return true;
+    }
+
+    return false;
+}
+
+// parents are popped from the stack before their children
+void TransformSystem::updateSubtree(uint32_t transform_id)
+{
+    std::vector<glm::mat4x3> & local = nodes.column<LOCAL>();
+    std::vector<glm::mat4x3> & local_inv = nodes.column<LOCAL_INV>();
+    std::vector<glm::mat4x3> & world = nodes.column<WORLD>();
+    std::vector<glm::mat4x3> & world_inv = nodes.column<WORLD_INV>();
+
+    subtree_stack.clear();
+    subtree_stack.push_back(transform_id);
+
+    while (!subtree_stack.empty())
+    {
+        uint32_t id = subtree_stack.back();
+        subtree_stack.pop_back();
+
+        uint32_t i = nodes.indexOf(id);
+        const Hierarchy & hierarchy = nodes.at<HIERARCHY>(i);
+
+        if (hierarchy.parent_id == NO_PARENT)
+        {
+            world[i] = local[i];
+            world_inv[i] = local_inv[i];
+        }
+        else
+        {
+            uint32_t p = nodes.indexOf(hierarchy.parent_id);
+
+            world[i] = combine(world[p], local[i]);
+            world_inv[i] = combine(local_inv[i], world_inv[p]);
+        }
+
+        for (uint32_t child_id = hierarchy.first_child_id;
+             child_id != NO_PARENT;
+             child_id = nodes.get<HIERARCHY>(child_id).next_sibling_id)
+        {
+            subtree_stack.push_back(child_id);
+        }
+    }
+}
 } // namespace engine
@@ -3,15 +3,25 @@
 
 #include "spdlog.h"
 #include "glm.hpp"
+#include <limits>
 
-#include "solid_vector.hpp"
+#include "soa_solid_vector.hpp"
 #include "matrices.hpp"
+#include "transform_batch.hpp"
 
 namespace engine
 {
+// Transforms form a hierarchy: world = parent world * local.
+// Children are linked to their parents, so world matrices are updated
+// only in the subtrees of modified transforms, and the storage order
+// doesn't matter: erase() just moves the last node in place of the erased one.
 class TransformSystem
 {
 public:
+    // transform ids are generational handles, a stale id fails the assert,
+    // the find/try methods return nullptr for it instead
+    static constexpr uint32_t NO_PARENT = std::numeric_limits<uint32_t>::max();
+
     // deleted methods should be public for better error messages
     TransformSystem(const TransformSystem & other) = delete;
     void operator=(const TransformSystem & other) = delete;
@@ -21,13 +31,88 @@ public:
     static TransformSystem * getInstance();
 
     static void del();
-    
-    math::SolidVector<math::Transform> transforms;
-    
-private:    
+
+    bool isValid(uint32_t transform_id) const { return nodes.valid(transform_id); }
+
+    // the transform is relative to the parent
+    uint32_t insert(const math::Transform & transform,
+                    uint32_t parent_id = NO_PARENT);
+
+    // children of the transform are moved to its parent
+    void erase(uint32_t transform_id);
+
+    // the local transform is kept, so the world one follows the new parent
+    void setParent(uint32_t transform_id, uint32_t parent_id);
+    uint32_t getParent(uint32_t transform_id) const;
+
+    // local transform
+    const math::Transform & getTransform(uint32_t transform_id) const;
+
+    // matrices of the transform and its children will be recomputed
+    math::Transform & modifyTransform(uint32_t transform_id);
+    math::Transform * tryModifyTransform(uint32_t transform_id);
+
+    // cached affine matrices (model -> world and world -> model),
+    // use glm::mat4() to get the full matrix for GPU
+    const glm::mat4x3 & getWorld(uint32_t transform_id);
+    const glm::mat4x3 & getWorldInv(uint32_t transform_id);
+    const glm::mat4x3 * findWorld(uint32_t transform_id);
+
+    // recompute matrices of all modified transforms and their children,
+    // should be called once per frame before rendering
+    void updateMatrices();
+
+private:
     TransformSystem() = default;
     ~TransformSystem() = default;
-    
+
+    // links are transform ids, NO_PARENT if there is no such node
+    struct Hierarchy
+    {
+        uint32_t parent_id;
+        uint32_t first_child_id;
+        uint32_t prev_sibling_id;
+        uint32_t next_sibling_id;
+
+        bool is_dirty;
+    };
+
+    // columns of nodes
+    enum : uint32_t
+    {
+        TRANSFORM,
+        HIERARCHY,
+        LOCAL,
+        LOCAL_INV,
+        WORLD,
+        WORLD_INV
+    };
+
+    void markDirty(uint32_t transform_id);
+
+    void link(uint32_t transform_id, uint32_t parent_id);
+    void unlink(uint32_t transform_id);
+
+    bool hasDirtyAncestor(uint32_t transform_id) const;
+    void updateSubtree(uint32_t transform_id);
+
+    math::SoASolidVector<math::Transform,
+                         Hierarchy,
+                         glm::mat4x3, // local
+                         glm::mat4x3, // local inverse
+                         glm::mat4x3, // world
+                         glm::mat4x3> nodes; // world inverse
+
+    // can contain erased or already updated ids, they are skipped
+    std::vector<uint32_t> dirty_ids;
+
+    // reused between updateMatrices() calls to avoid allocations
+    std::vector<uint32_t> batch_ids; // indices in the columns
+    std::vector<uint32_t> subtree_stack; // transform ids
+    math::TransformBatch batch;
+    std::vector<glm::mat4x3> batch_local;
+    std::vector<glm::mat4x3> batch_local_inv;
+
     static TransformSystem * instance;
 };
 } // namespace engine
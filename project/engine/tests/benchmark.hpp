@@ -0,0 +1,58 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+#include "simd.hpp"
+
+// benchmarks are executables which print the timings,
+// they aren't run by ctest
+
+namespace test
+{
+// the best of the runs in nanoseconds per item, the first run warms up caches
+template <class Function>
+double measure(uint32_t items_count, uint32_t runs_count, Function && function)
+{
+    function();
+
+    double best = 1e30;
+    for (uint32_t run = 0; run != runs_count; ++run)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        auto end = std::chrono::steady_clock::now();
+
+        best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count());
+    }
+
+    return best / items_count;
+}
+
+inline const char * getLevelName(math::SIMDLevel level)
+{
+    switch (level)
+    {
+    case math::SIMDLevel::AVX2: return "AVX2";
+    case math::SIMDLevel::SSE: return "SSE";
+    default: return "scalar";
+    }
+}
+
+// the levels the CPU can run, from the scalar one
+template <class Function>
+void forEachLevel(Function && function)
+{
+    math::SIMDLevel supported = math::getSupportedSIMDLevel();
+
+    for (math::SIMDLevel level : {math::SIMDLevel::SCALAR, math::SIMDLevel::SSE, math::SIMDLevel::AVX2})
+    {
+        if (level <= supported) function(level);
+    }
+}
+} // namespace test
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+#include <cstdio>
+#include <cmath>
+
+// minimal test helpers, every test is a separate executable:
+// main() runs the test functions and returns checkResult()
+
+namespace test
+{
+inline int & getFailedCount()
+{
+    static int failed_count = 0;
+    return failed_count;
+}
+
+inline void reportFailure(const char * file, int line, const char * expression)
+{
+    std::printf("%s:%d: CHECK(%s) failed\n", file, line, expression);
+    ++getFailedCount();
+}
+
+inline bool areClose(float a, float b, float epsilon = 1e-5f)
+{
+    return std::fabs(a - b) <= epsilon;
+}
+
+inline int checkResult()
+{
+    if (getFailedCount() == 0) std::printf("all checks passed\n");
+    else std::printf("%d checks failed\n", getFailedCount());
+
+    return getFailedCount() == 0 ? 0 : 1;
+}
+} // namespace test
+
+#define CHECK(expression) \
+    do { if (!(expression)) test::reportFailure(__FILE__, __LINE__, #expression); } while (false)
+
+#endif
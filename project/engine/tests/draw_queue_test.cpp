@@ -0,0 +1,153 @@
+#include "check.hpp"
+#include "draw_queue.hpp"
+
+#include <algorithm>
+#include <random>
+
+namespace
+{
+using engine::DrawQueue;
+
+// instances_offset keeps the index the packet was added with
+DrawQueue makeQueue(const std::vector<uint64_t> & keys)
+{
+    DrawQueue queue;
+    queue.clear(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+    for (uint32_t i = 0, size = keys.size(); i != size; ++i)
+        queue.add(keys[i], { 0, 0, 0, i, 1 });
+
+    return queue;
+}
+
+// the queue order has to be the stable sort of the keys
+void checkSorted(const std::vector<uint64_t> & keys)
+{
+    DrawQueue queue = makeQueue(keys);
+    queue.sort();
+
+    std::vector<uint32_t> expected(keys.size());
+    for (uint32_t i = 0, size = keys.size(); i != size; ++i) expected[i] = i;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+    CHECK(queue.size() == keys.size());
+    for (uint32_t i = 0, size = queue.size(); i != size; ++i)
+    {
+        CHECK(queue.getPacket(i).instances_offset == expected[i]);
+        CHECK(queue.getKey(i) == keys[expected[i]]);
+    }
+}
+
+void testRandomKeys()
+{
+    std::mt19937_64 generator(7);
+
+    for (uint32_t size : { 0u, 1u, 2u, 3u, 100u, 1000u, 10000u })
+    {
+        std::vector<uint64_t> keys(size);
+        for (uint64_t & key : keys) key = generator();
+
+        checkSorted(keys);
+    }
+}
+
+void testDuplicateKeys()
+{
+    std::mt19937_64 generator(11);
+
+    // a few distinct keys, so the order of equal keys is checked
+    std::vector<uint64_t> keys(5000);
+    for (uint64_t & key : keys) key = generator() % 8 * 0x0101010101010101ull;
+
+    checkSorted(keys);
+
+    // all the same, every digit is skipped
+    checkSorted(std::vector<uint64_t>(1000, 0x1234567890ABCDEFull));
+}
+
+void testHighDigits()
+{
+    std::mt19937_64 generator(13);
+
+    // only the pass and the shader differ, the low digits are skipped
+    std::vector<uint64_t> keys(2000);
+    for (uint64_t & key : keys) key = (generator() & 0xFF) << 56 | 0xABCDEF;
+
+    checkSorted(keys);
+
+    // only the lowest and the highest digits differ
+    for (uint64_t & key : keys) key = (generator() & 0xFF) << 56 | (generator() & 0xFF);
+
+    checkSorted(keys);
+}
+
+void testKeyFields()
+{
+    std::mt19937 generator(17);
+    std::uniform_int_distribution<uint32_t> random_pass(0, 15);
+    std::uniform_int_distribution<uint32_t> random_id(0, 65535);
+    std::uniform_real_distribution<float> random_depth(0.0f, 1000.0f);
+
+    for (uint32_t i = 0; i != 1000; ++i)
+    {
+        uint32_t pass = random_pass(generator);
+        uint32_t shader = random_pass(generator);
+        uint32_t material_id = random_id(generator);
+        uint32_t mesh_id = random_id(generator);
+        float depth = random_depth(generator);
+
+        uint64_t key = DrawQueue::makeOpaqueKey(pass, shader, material_id, mesh_id, depth);
+
+        CHECK(DrawQueue::getPass(key) == pass);
+        CHECK(DrawQueue::getShader(key) == shader);
+        CHECK(DrawQueue::getLayer(key) == DrawQueue::getDepthLayer(depth));
+        CHECK(DrawQueue::getMaterial(key) == material_id);
+        CHECK(DrawQueue::getMesh(key) == mesh_id);
+
+        // rounded down to 11 bits of the mantissa
+        float quantized = DrawQueue::getQuantizedDepth(key);
+        CHECK(quantized <= depth);
+        CHECK(depth - quantized <= depth / 2048.0f);
+    }
+
+    // behind the camera is clamped to 0
+    uint64_t key = DrawQueue::makeOpaqueKey(0, 0, 0, 0, -5.0f);
+    CHECK(DrawQueue::getQuantizedDepth(key) == 0.0f);
+    CHECK(DrawQueue::getLayer(key) == 0);
+}
+
+void testDepthOrder()
+{
+    // with the same state keys are ordered by depth, near first
+    float prev_depth = 0.0f;
+    uint64_t prev_key = DrawQueue::makeOpaqueKey(1, 2, 3, 4, prev_depth);
+
+    for (float depth = 0.01f; depth < 1000.0f; depth *= 1.01f)
+    {
+        uint64_t key = DrawQueue::makeOpaqueKey(1, 2, 3, 4, depth);
+        CHECK(key >= prev_key);
+        CHECK(DrawQueue::getLayer(key) >= DrawQueue::getLayer(prev_key));
+        CHECK(DrawQueue::getQuantizedDepth(key) >= DrawQueue::getQuantizedDepth(prev_key));
+
+        prev_key = key;
+    }
+
+    // the layers are [0, 16), [16, 32), [32, 64), [64, inf)
+    CHECK(DrawQueue::getDepthLayer(15.0f) == 0);
+    CHECK(DrawQueue::getDepthLayer(17.0f) == 1);
+    CHECK(DrawQueue::getDepthLayer(33.0f) == 2);
+    CHECK(DrawQueue::getDepthLayer(1000.0f) == DrawQueue::DEPTH_LAYERS_COUNT - 1);
+}
+} // namespace
+
+int main()
+{
+    testRandomKeys();
+    testDuplicateKeys();
+    testHighDigits();
+    testKeyFields();
+    testDepthOrder();
+
+    return test::checkResult();
+}
@@ -0,0 +1,104 @@
+#include "check.hpp"
+#include "frame_scheduler.hpp"
+
+namespace
+{
+constexpr float FRAME_DURATION = 1.0f / 60.0f;
+
+using engine::FrameScheduler;
+
+void testFirstFrame()
+{
+    FrameScheduler scheduler(FRAME_DURATION);
+
+    // the first frame is requested and due immediately
+    CHECK(scheduler.getWaitTime(0.0f) == 0.0f);
+    CHECK(scheduler.getWaitTime(100.0f) == 0.0f);
+
+    // no previous frame, so the delta is one frame
+    CHECK(test::areClose(scheduler.beginFrame(5.0f), FRAME_DURATION));
+    CHECK(scheduler.getStats().frames_count == 1);
+}
+
+void testWaitTime()
+{
+    FrameScheduler scheduler(FRAME_DURATION);
+    scheduler.beginFrame(1.0f);
+
+    // nothing changed since the last frame
+    CHECK(scheduler.getWaitTime(1.0f) == FrameScheduler::WAIT_FOREVER);
+    CHECK(scheduler.getWaitTime(10.0f) == FrameScheduler::WAIT_FOREVER);
+
+    scheduler.requestFrame();
+
+    // requested frames keep the frame rate
+    CHECK(test::areClose(scheduler.getWaitTime(1.0f), FRAME_DURATION));
+    CHECK(test::areClose(scheduler.getWaitTime(1.005f), FRAME_DURATION - 0.005f));
+    CHECK(scheduler.getWaitTime(1.02f) == 0.0f);
+    CHECK(scheduler.getWaitTime(2.0f) == 0.0f);
+
+    // time went back, e.g. after TimeSystem::unpause()
+    CHECK(scheduler.getWaitTime(0.5f) == 0.0f);
+
+    // requests don't pile up
+    scheduler.requestFrame();
+    scheduler.beginFrame(2.0f);
+    CHECK(scheduler.getWaitTime(3.0f) == FrameScheduler::WAIT_FOREVER);
+}
+
+void testDeltaTime()
+{
+    FrameScheduler scheduler(FRAME_DURATION);
+    scheduler.beginFrame(1.0f);
+
+    CHECK(test::areClose(scheduler.beginFrame(1.02f), 0.02f));
+    CHECK(test::areClose(scheduler.beginFrame(1.05f), 0.03f));
+
+    // animations don't jump after the loop slept
+    scheduler.addIdleTime(3.0f, 0.001f);
+    CHECK(test::areClose(scheduler.beginFrame(4.05f), FRAME_DURATION));
+
+    // the sleep is accounted only once
+    CHECK(test::areClose(scheduler.beginFrame(4.1f), 0.05f));
+
+    // time went back
+    CHECK(test::areClose(scheduler.beginFrame(2.0f), FRAME_DURATION));
+
+    CHECK(scheduler.getStats().frames_count == 6);
+}
+
+void testIdleStats()
+{
+    FrameScheduler scheduler(FRAME_DURATION);
+
+    const FrameScheduler::Stats & stats = scheduler.getStats();
+    CHECK(stats.idle_count == 0);
+    CHECK(stats.idle_time == 0.0f);
+    CHECK(stats.idle_cpu_time == 0.0f);
+
+    scheduler.addIdleTime(0.5f, 0.001f);
+    scheduler.addIdleTime(0.25f, 0.002f);
+
+    CHECK(stats.idle_count == 2);
+    CHECK(test::areClose(stats.idle_time, 0.75f));
+    CHECK(test::areClose(stats.idle_cpu_time, 0.003f));
+
+    scheduler.beginFrame(1.0f);
+    scheduler.resetStats();
+
+    CHECK(stats.frames_count == 0);
+    CHECK(stats.idle_count == 0);
+    CHECK(stats.idle_time == 0.0f);
+    CHECK(stats.idle_cpu_time == 0.0f);
+}
+} // namespace
+
+int main()
+{
+    testFirstFrame();
+    testWaitTime();
+    testDeltaTime();
+    testIdleStats();
+
+    return test::checkResult();
+}
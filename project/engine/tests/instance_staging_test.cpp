@@ -0,0 +1,168 @@
+#include "check.hpp"
+#include "instance_staging.hpp"
+
+namespace
+{
+using Staging = engine::InstanceStaging<uint32_t>;
+
+// a staging buffer with the given size which was already uploaded
+Staging makeUploaded(uint32_t size)
+{
+    Staging staging;
+    staging.resize(size);
+    staging.getDirtyRanges();
+    staging.clearDirty();
+
+    return staging;
+}
+
+void testMerge()
+{
+    Staging staging = makeUploaded(256);
+    CHECK(!staging.isDirty());
+    CHECK(staging.getDirtyRanges().empty());
+
+    // 10 and 27 are MERGE_GAP indices apart, so they are merged,
+    // 45 is one index further from 27 and starts a new range
+    staging.set(27, 1);
+    staging.set(10, 2);
+    staging.set(27 + 1 + Staging::MERGE_GAP + 1, 3);
+    CHECK(staging.isDirty());
+
+    const std::vector<Staging::Range> & ranges = staging.getDirtyRanges();
+    CHECK(ranges.size() == 2);
+    CHECK(ranges[0].begin == 10 && ranges[0].end == 28);
+    CHECK(ranges[1].begin == 45 && ranges[1].end == 46);
+
+    CHECK(staging.data()[10] == 2);
+    CHECK(staging.data()[27] == 1);
+    CHECK(staging.data()[45] == 3);
+
+    staging.clearDirty();
+    CHECK(!staging.isDirty());
+    CHECK(staging.getDirtyRanges().empty());
+}
+
+void testDuplicates()
+{
+    Staging staging = makeUploaded(256);
+
+    staging.set(100, 1);
+    staging.set(5, 2);
+    staging.set(100, 3);
+    staging.set(5, 4);
+
+    const std::vector<Staging::Range> & ranges = staging.getDirtyRanges();
+    CHECK(ranges.size() == 2);
+    CHECK(ranges[0].begin == 5 && ranges[0].end == 6);
+    CHECK(ranges[1].begin == 100 && ranges[1].end == 101);
+
+    // the last value is kept
+    CHECK(staging.data()[100] == 3);
+    CHECK(staging.data()[5] == 4);
+}
+
+void testResize()
+{
+    Staging staging;
+    CHECK(staging.getCapacity() == 0);
+
+    staging.resize(10);
+    CHECK(staging.size() == 10);
+    CHECK(staging.getCapacity() == Staging::MIN_CAPACITY);
+
+    staging.getDirtyRanges();
+    staging.clearDirty();
+
+    // growing within the capacity keeps it, but everything is uploaded again
+    staging.resize(Staging::MIN_CAPACITY);
+    CHECK(staging.getCapacity() == Staging::MIN_CAPACITY);
+    CHECK(staging.isDirty());
+
+    const std::vector<Staging::Range> & ranges = staging.getDirtyRanges();
+    CHECK(ranges.size() == 1);
+    CHECK(ranges[0].begin == 0 && ranges[0].end == Staging::MIN_CAPACITY);
+    staging.clearDirty();
+
+    // the capacity is doubled when exceeded
+    staging.resize(Staging::MIN_CAPACITY + 1);
+    CHECK(staging.getCapacity() == 2 * Staging::MIN_CAPACITY);
+
+    // and is set to the size if doubling isn't enough
+    staging.resize(10 * Staging::MIN_CAPACITY);
+    CHECK(staging.getCapacity() == 10 * Staging::MIN_CAPACITY);
+
+    // single sets don't split the all-dirty range
+    staging.set(3, 1);
+    CHECK(staging.getDirtyRanges().size() == 1);
+    CHECK(staging.getDirtyRanges()[0].end == 10 * Staging::MIN_CAPACITY);
+
+    // shrinking keeps the capacity
+    staging.resize(1);
+    CHECK(staging.getCapacity() == 10 * Staging::MIN_CAPACITY);
+    CHECK(staging.getDirtyRanges().size() == 1);
+    CHECK(staging.getDirtyRanges()[0].end == 1);
+
+    // an empty buffer has nothing to upload
+    staging.resize(0);
+    CHECK(staging.getDirtyRanges().empty());
+}
+
+void testGrow()
+{
+    Staging staging = makeUploaded(10);
+    staging.set(2, 7);
+
+    // the old instances and their dirty state are kept,
+    // the new ones are uploaded only when set
+    staging.grow(20);
+    CHECK(staging.size() == 20);
+    CHECK(staging.getCapacity() == Staging::MIN_CAPACITY);
+    CHECK(staging.data()[2] == 7);
+
+    staging.set(15, 1);
+
+    const std::vector<Staging::Range> & ranges = staging.getDirtyRanges();
+    CHECK(ranges.size() == 1);
+    CHECK(ranges[0].begin == 2 && ranges[0].end == 16);
+    staging.clearDirty();
+
+    // the capacity grows like with resize()
+    staging.grow(Staging::MIN_CAPACITY + 1);
+    CHECK(staging.getCapacity() == 2 * Staging::MIN_CAPACITY);
+    CHECK(!staging.isDirty());
+}
+
+void testInvalidate()
+{
+    Staging staging = makeUploaded(100);
+
+    staging.set(50, 1);
+    staging.invalidate();
+
+    const std::vector<Staging::Range> & ranges = staging.getDirtyRanges();
+    CHECK(ranges.size() == 1);
+    CHECK(ranges[0].begin == 0 && ranges[0].end == 100);
+
+    staging.clearDirty();
+    CHECK(!staging.isDirty());
+    CHECK(staging.getDirtyRanges().empty());
+
+    // after clearDirty() single indices are tracked again
+    staging.set(70, 2);
+    CHECK(staging.getDirtyRanges().size() == 1);
+    CHECK(staging.getDirtyRanges()[0].begin == 70);
+    CHECK(staging.getDirtyRanges()[0].end == 71);
+}
+} // namespace
+
+int main()
+{
+    testMerge();
+    testDuplicates();
+    testResize();
+    testGrow();
+    testInvalidate();
+
+    return test::checkResult();
+}
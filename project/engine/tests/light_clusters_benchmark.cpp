@@ -0,0 +1,108 @@
+#include "benchmark.hpp"
+#include "light_clusters.hpp"
+#include "thread_pool.hpp"
+
+#include <cmath>
+#include <random>
+
+namespace
+{
+constexpr uint32_t LIGHTS_COUNT = 1024;
+constexpr uint32_t RUNS_COUNT = 50;
+
+constexpr float NEAR = 0.1f;
+constexpr float FAR = 1000.0f;
+
+// exposes the cluster boxes for the brute force reference
+class BenchmarkClusters : public engine::LightClusters
+{
+public:
+    const std::vector<math::BoundingBox> & getBoxes() const { return boxes; }
+};
+
+// the same as Camera::setPerspective()
+glm::mat4 makeProj(float fovy, float aspect, float near, float far)
+{
+    float p1 = 1.0f / std::tan(fovy / 2.0f);
+    float p0 = p1 / aspect;
+
+    return glm::mat4(p0, 0.0f, 0.0f, 0.0f,
+                     0.0f, p1, 0.0f, 0.0f,
+                     0.0f, 0.0f, near / (near - far), 1.0f,
+                     0.0f, 0.0f, (-far * near) / (near - far), 0.0f);
+}
+
+// every light against every cluster box, lists a few more lights than update():
+// a box bounds its tile loosely, while update() also culls by the tile range
+uint32_t cullBruteForce(const std::vector<math::BoundingBox> & boxes,
+                        const std::vector<engine::LightClusters::Sphere> & lights,
+                        std::vector<uint32_t> & indices)
+{
+    indices.clear();
+
+    for (const math::BoundingBox & box : boxes)
+    {
+        for (uint32_t i = 0; i != LIGHTS_COUNT; ++i)
+        {
+            glm::vec3 offset = glm::clamp(lights[i].center, box.min, box.max) - lights[i].center;
+            if (glm::dot(offset, offset) <= lights[i].radius * lights[i].radius)
+                indices.push_back(i);
+        }
+    }
+
+    return uint32_t(indices.size());
+}
+} // namespace
+
+int main()
+{
+    engine::ThreadPool::init();
+
+    glm::mat4 proj = makeProj(1.0f, 16.0f / 9.0f, NEAR, FAR);
+
+    // most of the lights are near the camera, like in a scene with a falloff of detail
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> ndc(-1.2f, 1.2f);
+    std::exponential_distribution<float> depth(1.0f / 60.0f);
+    std::uniform_real_distribution<float> radius(1.0f, 8.0f);
+
+    std::vector<engine::LightClusters::Sphere> lights(LIGHTS_COUNT);
+    for (engine::LightClusters::Sphere & light : lights)
+    {
+        float z = depth(generator);
+        light.center = glm::vec3(ndc(generator) * z / proj[0][0],
+                                 ndc(generator) * z / proj[1][1],
+                                 z);
+        light.radius = radius(generator);
+    }
+
+    BenchmarkClusters clusters;
+
+    double update = test::measure(1, RUNS_COUNT, [&]()
+    {
+        clusters.update(glm::mat4(1.0f), proj, lights.data(), LIGHTS_COUNT);
+    });
+
+    std::vector<uint32_t> indices;
+    uint32_t brute_force_count = 0;
+    double brute_force = test::measure(1, RUNS_COUNT / 10, [&]()
+    {
+        brute_force_count = cullBruteForce(clusters.getBoxes(), lights, indices);
+    });
+
+    std::printf("%u lights, %u clusters, us per update:\n",
+                LIGHTS_COUNT,
+                engine::LightClusters::CLUSTERS_COUNT);
+    std::printf("  LightClusters::update(), %u threads  %9.1f (%zu indices)\n",
+                engine::ThreadPool::getInstance()->getThreadsCount(),
+                update / 1000.0,
+                clusters.getIndices().size());
+    std::printf("  every light vs every cluster box      %9.1f (%u indices, x%.1f)\n",
+                brute_force / 1000.0,
+                brute_force_count,
+                brute_force / update);
+
+    engine::ThreadPool::del();
+
+    return 0;
+}
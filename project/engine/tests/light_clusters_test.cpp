@@ -0,0 +1,177 @@
+#include "check.hpp"
+#include "light_clusters.hpp"
+#include "thread_pool.hpp"
+
+#include <cmath>
+#include <random>
+#include <algorithm>
+
+namespace
+{
+using engine::LightClusters;
+
+constexpr float NEAR = 0.1f;
+constexpr float FAR = 1000.0f;
+constexpr float ASPECT = 16.0f / 9.0f;
+constexpr uint32_t SAMPLES_COUNT = 200000;
+
+// the same as Camera::setPerspective()
+glm::mat4 makeProj(float fovy, float aspect, float near, float far)
+{
+    float p1 = 1.0f / std::tan(fovy / 2.0f);
+    float p0 = p1 / aspect;
+
+    return glm::mat4(p0, 0.0f, 0.0f, 0.0f,
+                     0.0f, p1, 0.0f, 0.0f,
+                     0.0f, 0.0f, near / (near - far), 1.0f,
+                     0.0f, 0.0f, (-far * near) / (near - far), 0.0f);
+}
+
+// the cluster of a view space point, the same mapping as the shader uses
+uint32_t getCluster(const LightClusters & clusters,
+                    const glm::mat4 & proj,
+                    const glm::vec3 & point)
+{
+    float ndc_x = proj[0][0] * point.x / point.z;
+    float ndc_y = proj[1][1] * point.y / point.z;
+
+    auto toIndex = [](float value, uint32_t count)
+    {
+        int index = int(std::floor(value * count));
+        return uint32_t(std::min(std::max(index, 0), int(count) - 1));
+    };
+
+    uint32_t x = toIndex(ndc_x * 0.5f + 0.5f, LightClusters::TILES_X);
+    uint32_t y = toIndex(ndc_y * 0.5f + 0.5f, LightClusters::TILES_Y);
+    uint32_t slice = toIndex(std::log(point.z / clusters.getNear()) *
+                             clusters.getSliceScale() / LightClusters::SLICES,
+                             LightClusters::SLICES);
+
+    return LightClusters::getClusterIndex(x, y, slice);
+}
+
+bool isLightInCluster(const LightClusters & clusters, uint32_t cluster, uint32_t light)
+{
+    const LightClusters::Cluster & range = clusters.getClusters()[cluster];
+    const uint32_t * indices = clusters.getIndices().data() + range.offset;
+
+    return std::find(indices, indices + range.count, light) != indices + range.count;
+}
+
+// a random point inside of the frustum, the depth is exponential like the slices
+glm::vec3 samplePoint(std::mt19937 & generator, const glm::mat4 & proj)
+{
+    std::uniform_real_distribution<float> ndc(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> t(0.0f, 1.0f);
+
+    float z = NEAR * std::pow(FAR / NEAR, t(generator));
+
+    return glm::vec3(ndc(generator) * z / proj[0][0],
+                     ndc(generator) * z / proj[1][1],
+                     z);
+}
+
+// every sampled point inside of a light has to find the light in its cluster,
+// the view is identity, so world space is view space
+void testSampledPoints()
+{
+    glm::mat4 proj = makeProj(1.0f, ASPECT, NEAR, FAR);
+
+    std::mt19937 generator(1);
+    std::vector<LightClusters::Sphere> lights;
+
+    for (uint32_t i = 0; i != 256; ++i)
+    {
+        glm::vec3 center = samplePoint(generator, proj);
+        float radius = 0.05f * center.z + float(i % 7);
+
+        lights.push_back({center, radius});
+    }
+
+    // crossing the near plane and the screen borders
+    lights.push_back({glm::vec3(0.0f, 0.0f, 0.0f), 2.0f});
+    lights.push_back({glm::vec3(30.0f, 0.0f, 10.0f), 25.0f});
+
+    LightClusters clusters;
+    clusters.update(glm::mat4(1.0f), proj, lights.data(), uint32_t(lights.size()));
+
+    CHECK(std::abs(clusters.getNear() - NEAR) < 1e-3f);
+    CHECK(clusters.getClusters().size() == LightClusters::CLUSTERS_COUNT);
+
+    uint32_t missed_count = 0;
+    uint32_t tested_count = 0;
+    for (uint32_t s = 0; s != SAMPLES_COUNT; ++s)
+    {
+        glm::vec3 point = samplePoint(generator, proj);
+        uint32_t cluster = getCluster(clusters, proj, point);
+
+        for (uint32_t i = 0, size = lights.size(); i != size; ++i)
+        {
+            glm::vec3 offset = point - lights[i].center;
+            if (glm::dot(offset, offset) > lights[i].radius * lights[i].radius) continue;
+
+            ++tested_count;
+            if (!isLightInCluster(clusters, cluster, i)) ++missed_count;
+        }
+    }
+
+    CHECK(tested_count > 1000);
+    CHECK(missed_count == 0);
+}
+
+// lights behind the camera or outside of the sides aren't listed anywhere
+void testCulledLights()
+{
+    glm::mat4 proj = makeProj(1.0f, ASPECT, NEAR, FAR);
+
+    LightClusters::Sphere lights[] =
+    {
+        {glm::vec3(0.0f, 0.0f, -10.0f), 5.0f},
+        {glm::vec3(-500.0f, 0.0f, 100.0f), 10.0f},
+        {glm::vec3(0.0f, 0.0f, 2000.0f), 10.0f},
+    };
+
+    LightClusters clusters;
+    clusters.update(glm::mat4(1.0f), proj, lights, 3);
+
+    CHECK(clusters.getIndices().empty());
+
+    for (const LightClusters::Cluster & cluster : clusters.getClusters())
+        CHECK(cluster.count == 0);
+}
+
+// the lists are stored in the cluster order without gaps
+void testLayout()
+{
+    glm::mat4 proj = makeProj(1.0f, ASPECT, NEAR, FAR);
+
+    std::mt19937 generator(2);
+    std::vector<LightClusters::Sphere> lights;
+    for (uint32_t i = 0; i != 64; ++i)
+        lights.push_back({samplePoint(generator, proj), 5.0f});
+
+    LightClusters clusters;
+    clusters.update(glm::mat4(1.0f), proj, lights.data(), uint32_t(lights.size()));
+
+    uint32_t offset = 0;
+    for (const LightClusters::Cluster & cluster : clusters.getClusters())
+    {
+        CHECK(cluster.offset == offset);
+        offset += cluster.count;
+    }
+    CHECK(offset == clusters.getIndices().size());
+}
+} // namespace
+
+int main()
+{
+    engine::ThreadPool::init();
+
+    testSampledPoints();
+    testCulledLights();
+    testLayout();
+
+    engine::ThreadPool::del();
+
+    return test::checkResult();
+}
@@ -0,0 +1,38 @@
+#include "benchmark.hpp"
+#include "particle_pool.hpp"
+
+namespace
+{
+using engine::ParticlePool;
+
+constexpr uint32_t PARTICLES_COUNT = 100000;
+constexpr uint32_t RUNS_COUNT = 50;
+
+// slow enough, so no particle dies during the runs
+constexpr ParticlePool::Motion MOTION = {1e-4f, 1.0f, 0.1f, 0.5f, 1.0f, 1.0f};
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+} // namespace
+
+int main()
+{
+    std::printf("%u particles, ns per particle:\n", PARTICLES_COUNT);
+
+    test::forEachLevel([](math::SIMDLevel level)
+    {
+        ParticlePool pool(PARTICLES_COUNT);
+        for (uint32_t i = 0; i != PARTICLES_COUNT; ++i)
+            pool.spawn(glm::vec3(float(i), 0.0f, 0.0f), 1.0f, 1.0f, 0.0f, glm::vec4(1.0f));
+
+        double update = test::measure(PARTICLES_COUNT, RUNS_COUNT, [&]()
+        {
+            pool.update(MOTION, DELTA_TIME, level);
+        });
+
+        std::printf("  ParticlePool::update(), %-6s  %6.2f (%u alive)\n",
+                    test::getLevelName(level),
+                    update,
+                    pool.size());
+    });
+
+    return 0;
+}
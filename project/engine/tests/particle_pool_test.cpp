@@ -0,0 +1,194 @@
+#include "check.hpp"
+#include "particle_pool.hpp"
+#include "random.hpp"
+
+#include <vector>
+#include <cstring>
+
+namespace
+{
+using engine::ParticlePool;
+using math::SIMDLevel;
+
+constexpr ParticlePool::Motion MOTION = {0.5f, 1.0f, 0.25f, 0.2f, 2.5f, 0.625f};
+
+std::vector<SIMDLevel> getLevels()
+{
+    std::vector<SIMDLevel> levels;
+    for (SIMDLevel level : {SIMDLevel::SCALAR, SIMDLevel::SSE, SIMDLevel::AVX2})
+    {
+        if (level <= math::getSupportedSIMDLevel()) levels.push_back(level);
+    }
+
+    return levels;
+}
+
+bool areSame(const std::vector<float> & a, const std::vector<float> & b, uint32_t count)
+{
+    return std::memcmp(a.data(), b.data(), count * sizeof(float)) == 0;
+}
+
+bool areSame(const ParticlePool & a, const ParticlePool & b)
+{
+    if (a.size() != b.size() || a.getUpdatedCount() != b.getUpdatedCount()) return false;
+
+    for (uint32_t i = 0, size = a.getUpdatedCount(); i != size; ++i)
+    {
+        if (a.getRemap(i) != b.getRemap(i)) return false;
+    }
+
+    uint32_t count = a.size();
+    return areSame(a.position_x, b.position_x, count) &&
+           areSame(a.position_y, b.position_y, count) &&
+           areSame(a.position_z, b.position_z, count) &&
+           areSame(a.particle_size, b.particle_size, count) &&
+           areSame(a.thickness, b.thickness, count) &&
+           areSame(a.angle, b.angle, count) &&
+           areSame(a.tint_r, b.tint_r, count) &&
+           areSame(a.tint_g, b.tint_g, count) &&
+           areSame(a.tint_b, b.tint_b, count) &&
+           areSame(a.alpha, b.alpha, count) &&
+           areSame(a.lifetime, b.lifetime, count);
+}
+
+// the angle is the spawn number, so the order can be checked
+void spawn(ParticlePool & pool, math::Random & random, float number)
+{
+    pool.spawn(random.range(glm::vec3(-10.0f), glm::vec3(10.0f)),
+               random.range(0.5f, 2.0f),
+               1.0f,
+               number,
+               glm::vec4(random.range(glm::vec3(0.0f), glm::vec3(1.0f)), 0.0f));
+}
+
+void testSpawn()
+{
+    ParticlePool pool(3);
+    CHECK(pool.capacity() == 3);
+    CHECK(pool.size() == 0);
+
+    glm::vec4 tint(0.1f, 0.2f, 0.3f, 0.4f);
+    CHECK(pool.spawn(glm::vec3(1.0f, 2.0f, 3.0f), 4.0f, 5.0f, 6.0f, tint));
+    CHECK(pool.spawn(glm::vec3(0.0f), 1.0f, 1.0f, 1.0f, tint));
+    CHECK(pool.spawn(glm::vec3(0.0f), 1.0f, 1.0f, 2.0f, tint));
+
+    // the pool is full
+    CHECK(!pool.spawn(glm::vec3(0.0f), 1.0f, 1.0f, 3.0f, tint));
+    CHECK(pool.size() == 3);
+
+    CHECK(pool.getPosition(0) == glm::vec3(1.0f, 2.0f, 3.0f));
+    CHECK(pool.particle_size[0] == 4.0f);
+    CHECK(pool.thickness[0] == 5.0f);
+    CHECK(pool.angle[0] == 6.0f);
+    CHECK(pool.getTint(0) == tint);
+    CHECK(pool.lifetime[0] == 0.0f);
+}
+
+// the particles die after 1 / life_speed seconds,
+// the rest keep their order and the remap tells where they went
+void testCompact()
+{
+    ParticlePool pool(8);
+    ParticlePool::Motion motion = {0.25f, 0.0f, 0.0f, 0.5f, 1.0f, 1.0f};
+    glm::vec4 tint(1.0f);
+
+    pool.spawn(glm::vec3(0.0f), 1.0f, 1.0f, 0.0f, tint);
+    pool.update(motion, 1.0f);
+    pool.spawn(glm::vec3(0.0f), 1.0f, 1.0f, 1.0f, tint);
+    pool.update(motion, 1.0f);
+    pool.spawn(glm::vec3(0.0f), 1.0f, 1.0f, 2.0f, tint);
+    pool.update(motion, 1.0f);
+    CHECK(pool.size() == 3);
+
+    // the first particle reaches the lifetime 1
+    pool.update(motion, 1.0f);
+    CHECK(pool.size() == 2);
+    CHECK(pool.getUpdatedCount() == 3);
+    CHECK(pool.getRemap(0) == ParticlePool::DEAD_INDEX);
+    CHECK(pool.getRemap(1) == 0);
+    CHECK(pool.getRemap(2) == 1);
+    CHECK(pool.angle[0] == 1.0f);
+    CHECK(pool.angle[1] == 2.0f);
+
+    pool.update(motion, 1.0f);
+    pool.update(motion, 1.0f);
+    CHECK(pool.size() == 0);
+
+    // a faded out particle dies before its lifetime ends
+    ParticlePool::Motion fading = {0.01f, 0.0f, 0.0f, 0.0f, 1.0f, 0.3f};
+    pool.spawn(glm::vec3(0.0f), 1.0f, 1.0f, 0.0f, glm::vec4(1.0f, 1.0f, 1.0f, 0.0f));
+    pool.update(fading, 1.0f);
+    CHECK(pool.size() == 1);
+    CHECK(pool.getTint(0).w < 0.0f);
+    pool.update(fading, 1.0f);
+    CHECK(pool.size() == 0);
+}
+
+// the remap of every update() is a bijection of the survivors onto [0; size())
+// which keeps their order, the angle tells which particle is which
+void testRemap()
+{
+    ParticlePool pool(256);
+    math::Random random(3);
+    float spawned_count = 0.0f;
+
+    for (uint32_t frame = 0; frame != 300; ++frame)
+    {
+        for (uint32_t i = 0, count = random.index(6); i != count; ++i)
+            spawn(pool, random, spawned_count++);
+
+        std::vector<float> angles(pool.angle.begin(), pool.angle.begin() + pool.size());
+
+        pool.update(MOTION, random.range(0.01f, 0.1f));
+        CHECK(pool.getUpdatedCount() == angles.size());
+
+        uint32_t next_index = 0;
+        for (uint32_t i = 0, size = pool.getUpdatedCount(); i != size; ++i)
+        {
+            uint32_t index = pool.getRemap(i);
+            if (index == ParticlePool::DEAD_INDEX) continue;
+
+            CHECK(index == next_index++);
+            CHECK(pool.angle[index] == angles[i]);
+        }
+
+        CHECK(next_index == pool.size());
+    }
+
+    CHECK(pool.size() > 0);
+}
+
+// every level gives the same bits as the scalar code,
+// the counts go through all the SIMD tails as particles spawn and die
+void testLevels()
+{
+    std::vector<SIMDLevel> levels = getLevels();
+    std::vector<ParticlePool> pools(levels.size(), ParticlePool(1024));
+    std::vector<math::Random> randoms(levels.size(), math::Random(5));
+
+    for (uint32_t frame = 0; frame != 300; ++frame)
+    {
+        for (uint32_t l = 0, size = levels.size(); l != size; ++l)
+        {
+            for (uint32_t i = 0, count = randoms[l].index(8); i != count; ++i)
+                spawn(pools[l], randoms[l], float(frame));
+
+            pools[l].update(MOTION, randoms[l].range(0.001f, 0.05f), levels[l]);
+
+            if (l != 0) CHECK(areSame(pools[l], pools[0]));
+        }
+    }
+
+    CHECK(pools[0].size() > 0);
+}
+} // namespace
+
+int main()
+{
+    testSpawn();
+    testCompact();
+    testRemap();
+    testLevels();
+
+    return test::checkResult();
+}
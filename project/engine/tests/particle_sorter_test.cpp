@@ -0,0 +1,160 @@
+#include "check.hpp"
+#include "particle_sorter.hpp"
+#include "random.hpp"
+
+#include <vector>
+#include <cmath>
+#include <cfloat>
+
+namespace
+{
+using engine::ParticlePool;
+using engine::ParticleSorter;
+
+constexpr ParticlePool::Motion MOTION = {0.5f, 1.0f, 0.25f, 0.2f, 2.5f, 0.625f};
+
+constexpr uint32_t EMITTERS_COUNT = 3;
+constexpr uint32_t FRAMES_COUNT = 300;
+
+float getDistance2(const ParticlePool & pool, uint32_t index, const glm::vec3 & camera_pos)
+{
+    glm::vec3 offset = pool.getPosition(index) - camera_pos;
+    return glm::dot(offset, offset);
+}
+
+// every live particle once, the farthest first
+void checkSorted(const ParticleSorter & sorter,
+                 const std::vector<const ParticlePool *> & pools,
+                 const glm::vec3 & camera_pos)
+{
+    uint32_t particles_count = 0;
+    std::vector<std::vector<uint32_t>> seen(pools.size());
+    for (uint32_t e = 0, size = pools.size(); e != size; ++e)
+    {
+        particles_count += pools[e]->size();
+        seen[e].assign(pools[e]->size(), 0);
+    }
+
+    CHECK(sorter.size() == particles_count);
+
+    float prev_distance_2 = FLT_MAX;
+    for (uint32_t i = 0, size = sorter.size(); i != size; ++i)
+    {
+        const ParticleSorter::Entry & entry = sorter.getEntry(i);
+        CHECK(entry.emitter < pools.size());
+        CHECK(entry.index < pools[entry.emitter]->size());
+
+        ++seen[entry.emitter][entry.index];
+
+        float distance_2 = getDistance2(*pools[entry.emitter], entry.index, camera_pos);
+        CHECK(distance_2 <= prev_distance_2);
+        prev_distance_2 = distance_2;
+    }
+
+    for (const std::vector<uint32_t> & counts : seen)
+    {
+        for (uint32_t count : counts) CHECK(count == 1);
+    }
+}
+
+// particles spawn and die in every frame, the camera moves slowly,
+// returns how many sorts kept the last frame's order
+uint32_t simulate(ParticleSorter::SortMode sort_mode)
+{
+    std::vector<ParticlePool> emitters(EMITTERS_COUNT, ParticlePool(512));
+    math::Random random(9);
+
+    ParticleSorter sorter;
+    sorter.setSortMode(sort_mode);
+
+    std::vector<const ParticlePool *> pools;
+    glm::vec3 camera_pos;
+    uint32_t incremental_count = 0;
+
+    for (uint32_t frame = 0; frame != FRAMES_COUNT; ++frame)
+    {
+        // an emitter is added in the middle
+        uint32_t emitters_count = frame < FRAMES_COUNT / 2 ? EMITTERS_COUNT - 1 : EMITTERS_COUNT;
+        if (pools.size() != emitters_count)
+        {
+            pools.push_back(&emitters[pools.size()]);
+            sorter.invalidate();
+        }
+
+        for (uint32_t e = 0; e != emitters_count; ++e)
+        {
+            for (uint32_t i = 0, count = random.index(6); i != count; ++i)
+            {
+                emitters[e].spawn(random.range(glm::vec3(-10.0f), glm::vec3(10.0f)),
+                                  1.0f,
+                                  1.0f,
+                                  0.0f,
+                                  glm::vec4(1.0f));
+            }
+
+            emitters[e].update(MOTION, random.range(0.01f, 0.05f));
+        }
+
+        camera_pos = glm::vec3(20.0f * cosf(frame * 0.01f), 2.0f, 20.0f * sinf(frame * 0.01f));
+
+        sorter.sort(pools, camera_pos);
+        checkSorted(sorter, pools, camera_pos);
+
+        incremental_count += sorter.wasIncremental();
+    }
+
+    // the camera on the other side reverses most of the order
+    camera_pos = -camera_pos;
+    sorter.sort(pools, camera_pos);
+    checkSorted(sorter, pools, camera_pos);
+    CHECK(!sorter.wasIncremental());
+
+    return incremental_count;
+}
+
+void testRadix()
+{
+    CHECK(simulate(ParticleSorter::SortMode::RADIX) == 0);
+}
+
+void testIncremental()
+{
+    // not the first frame and the frame after the emitter was added,
+    // the spawned particles are appended, so a few frames with few particles fall back
+    uint32_t incremental_count = simulate(ParticleSorter::SortMode::INCREMENTAL);
+    CHECK(incremental_count <= FRAMES_COUNT - 2);
+    CHECK(incremental_count > FRAMES_COUNT * 9 / 10);
+}
+
+void testEmpty()
+{
+    ParticleSorter sorter;
+    std::vector<const ParticlePool *> pools;
+
+    sorter.sort(pools, glm::vec3(0.0f));
+    CHECK(sorter.size() == 0);
+
+    ParticlePool pool(4);
+    pools.push_back(&pool);
+    sorter.invalidate();
+
+    sorter.sort(pools, glm::vec3(0.0f));
+    CHECK(sorter.size() == 0);
+
+    pool.spawn(glm::vec3(1.0f), 1.0f, 1.0f, 0.0f, glm::vec4(1.0f));
+    pool.update(MOTION, 0.01f);
+
+    sorter.sort(pools, glm::vec3(0.0f));
+    CHECK(sorter.size() == 1);
+    CHECK(sorter.wasIncremental());
+}
+} // namespace
+
+int main()
+{
+    testRadix();
+    testIncremental();
+    testEmpty();
+
+    return test::checkResult();
+}
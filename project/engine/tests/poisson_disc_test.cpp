@@ -0,0 +1,194 @@
+#include "check.hpp"
+#include "random.hpp"
+#include "thread_pool.hpp"
+
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cfloat>
+#include <algorithm>
+
+namespace
+{
+using math::PoissonDiscSampler;
+
+constexpr float RADIUS = 1.0f;
+constexpr uint64_t SEED = 5;
+
+// small tiles, so most of the samples are near seams
+const glm::vec2 SIZE(61.5f, 37.0f);
+constexpr float TILE_SIZE = 4.0f;
+
+std::vector<glm::vec2> sampleAll(const glm::vec2 & size, float tile_size)
+{
+    PoissonDiscSampler sampler(size, RADIUS, tile_size, 30, SEED);
+    sampler.sampleAll();
+
+    std::vector<glm::vec2> samples;
+    sampler.getSamples(samples);
+
+    return samples;
+}
+
+// thread i samples every threads_count-th tile of a pass starting from i
+std::vector<glm::vec2> sampleThreads(uint32_t threads_count)
+{
+    PoissonDiscSampler sampler(SIZE, RADIUS, TILE_SIZE, 30, SEED);
+
+    for (uint32_t pass = 0; pass != PoissonDiscSampler::PASSES_COUNT; ++pass)
+    {
+        const std::vector<uint32_t> & tiles = sampler.getPassTiles(pass);
+
+        std::vector<std::thread> threads;
+        for (uint32_t i = 0; i != threads_count; ++i)
+        {
+            threads.emplace_back([&, i]()
+            {
+                for (uint32_t j = i, size = tiles.size(); j < size; j += threads_count)
+                    sampler.sampleTile(tiles[j]);
+            });
+        }
+
+        for (std::thread & thread : threads) thread.join();
+    }
+
+    std::vector<glm::vec2> samples;
+    sampler.getSamples(samples);
+
+    return samples;
+}
+
+// as GrassField does
+std::vector<glm::vec2> sampleThreadPool()
+{
+    engine::ThreadPool * thread_pool = engine::ThreadPool::getInstance();
+
+    PoissonDiscSampler sampler(SIZE, RADIUS, TILE_SIZE, 30, SEED);
+
+    for (uint32_t pass = 0; pass != PoissonDiscSampler::PASSES_COUNT; ++pass)
+    {
+        const std::vector<uint32_t> & tiles = sampler.getPassTiles(pass);
+
+        thread_pool->parallelFor(uint32_t(tiles.size()),
+                                 1,
+                                 [&](uint32_t begin, uint32_t end)
+                                 {
+                                     for (uint32_t i = begin; i != end; ++i)
+                                         sampler.sampleTile(tiles[i]);
+                                 });
+    }
+
+    std::vector<glm::vec2> samples;
+    sampler.getSamples(samples);
+
+    return samples;
+}
+
+bool areIdentical(const std::vector<glm::vec2> & a, const std::vector<glm::vec2> & b)
+{
+    return a.size() == b.size() &&
+           std::memcmp(a.data(), b.data(), a.size() * sizeof(glm::vec2)) == 0;
+}
+
+void checkSpacing(const std::vector<glm::vec2> & samples, const glm::vec2 & size, float tile_size)
+{
+    CHECK(!samples.empty());
+
+    uint32_t close_count = 0;
+    uint32_t seam_count = 0; // pairs in different tiles
+
+    for (uint32_t i = 0, count = samples.size(); i != count; ++i)
+    {
+        const glm::vec2 & a = samples[i];
+        CHECK(a.x >= 0.0f && a.x < size.x && a.y >= 0.0f && a.y < size.y);
+
+        for (uint32_t j = i + 1; j != count; ++j)
+        {
+            const glm::vec2 & b = samples[j];
+
+            glm::vec2 offset = b - a;
+            float distance_2 = glm::dot(offset, offset);
+            if (distance_2 < RADIUS * RADIUS) ++close_count;
+
+            // the tiles are rounded up to cells, so seams are near multiples of tile_size
+            if (distance_2 < 4.0f * RADIUS * RADIUS &&
+                (int(a.x / tile_size) != int(b.x / tile_size) ||
+                 int(a.y / tile_size) != int(b.y / tile_size))) ++seam_count;
+        }
+    }
+
+    CHECK(close_count == 0);
+
+    // the seams were checked
+    if (tile_size < size.x) CHECK(seam_count != 0);
+}
+
+void testSpacing()
+{
+    checkSpacing(sampleAll(SIZE, TILE_SIZE), SIZE, TILE_SIZE);
+
+    // tiles are at least 2 cells
+    checkSpacing(sampleAll(SIZE, 0.5f), SIZE, 0.5f);
+
+    // a partial last tile
+    const glm::vec2 size(20.3f, 9.1f);
+    checkSpacing(sampleAll(size, 6.0f), size, 6.0f);
+
+    // one tile
+    checkSpacing(sampleAll(size, 100.0f), size, 100.0f);
+}
+
+void testFill()
+{
+    // without gaps at the seams: samples are dense, Bridson's sampling leaves
+    // no free disc of 2 * radius, every probe has a sample closer than 2 * radius
+    std::vector<glm::vec2> samples = sampleAll(SIZE, TILE_SIZE);
+
+    uint32_t far_count = 0;
+    for (float y = 0.25f; y < SIZE.y; y += 0.5f)
+    {
+        for (float x = 0.25f; x < SIZE.x; x += 0.5f)
+        {
+            float min_distance_2 = FLT_MAX;
+            for (const glm::vec2 & sample : samples)
+            {
+                glm::vec2 offset = sample - glm::vec2(x, y);
+                min_distance_2 = std::min(min_distance_2, glm::dot(offset, offset));
+            }
+
+            if (min_distance_2 >= 4.0f * RADIUS * RADIUS) ++far_count;
+        }
+    }
+
+    CHECK(far_count == 0);
+}
+
+void testThreadsCount()
+{
+    std::vector<glm::vec2> expected = sampleAll(SIZE, TILE_SIZE);
+
+    for (uint32_t threads_count : { 1u, 2u, 3u, 8u })
+        CHECK(areIdentical(sampleThreads(threads_count), expected));
+
+    engine::ThreadPool::init();
+    CHECK(areIdentical(sampleThreadPool(), expected));
+    engine::ThreadPool::del();
+
+    // other seeds give other samples
+    PoissonDiscSampler sampler(SIZE, RADIUS, TILE_SIZE, 30, SEED + 1);
+    sampler.sampleAll();
+
+    std::vector<glm::vec2> other;
+    sampler.getSamples(other);
+    CHECK(!areIdentical(other, expected));
+}
+} // namespace
+
+int main()
+{
+    testSpacing();
+    testFill();
+    testThreadsCount();
+
+    return test::checkResult();
+}
@@ -0,0 +1,72 @@
+#include "benchmark.hpp"
+#include "random.hpp"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t VALUES_COUNT = 1 << 16;
+constexpr uint32_t OLD_VALUES_COUNT = 1 << 12; // it's too slow for more
+constexpr uint32_t RUNS_COUNT = 20;
+
+// the function Random replaced: a new device and engine per call
+float randomFromRange(float min, float max)
+{
+    std::random_device random_device;
+    std::mt19937 mersenne_random(random_device());
+
+    std::uniform_real_distribution<float> distribution(min, max);
+    return distribution(random_device);
+}
+} // namespace
+
+int main()
+{
+    std::vector<float> values(VALUES_COUNT);
+    float sum = 0.0f;
+
+    std::printf("ns per value:\n");
+
+    double old = test::measure(OLD_VALUES_COUNT, RUNS_COUNT, [&]()
+    {
+        for (uint32_t i = 0; i != OLD_VALUES_COUNT; ++i)
+            values[i] = randomFromRange(0.0f, 1.0f);
+    });
+    std::printf("  randomFromRange()         %8.2f\n", old);
+
+    std::mt19937 mersenne_random(1);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    double mersenne = test::measure(VALUES_COUNT, RUNS_COUNT, [&]()
+    {
+        for (uint32_t i = 0; i != VALUES_COUNT; ++i)
+            values[i] = distribution(mersenne_random);
+    });
+    std::printf("  std::mt19937, one engine  %8.2f\n", mersenne);
+
+    math::Random random(1);
+    double range = test::measure(VALUES_COUNT, RUNS_COUNT, [&]()
+    {
+        for (uint32_t i = 0; i != VALUES_COUNT; ++i)
+            values[i] = random.range(0.0f, 1.0f);
+    });
+    std::printf("  Random::range()           %8.2f (x%.0f)\n", range, old / range);
+
+    test::forEachLevel([&](math::SIMDLevel level)
+    {
+        double fill = test::measure(VALUES_COUNT, RUNS_COUNT, [&]()
+        {
+            random.fill(values.data(), VALUES_COUNT, 0.0f, 1.0f, level);
+        });
+        std::printf("  Random::fill(), %-6s    %8.2f (x%.0f)\n",
+                    test::getLevelName(level),
+                    fill,
+                    old / fill);
+    });
+
+    // keeps the values alive
+    for (float value : values) sum += value;
+    std::printf("mean %.3f\n", sum / VALUES_COUNT);
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "check.hpp"
+#include "random.hpp"
+
+#include <vector>
+#include <cstring>
+
+namespace
+{
+using math::Random;
+using math::SIMDLevel;
+
+constexpr uint32_t VALUES_COUNT = 1000;
+
+// counts which aren't multiples of LANES_COUNT and already consumed values
+// exercise the scalar head and tail of fill()
+constexpr uint32_t COUNTS[] = {0, 1, 7, 8, 9, 64, 67, VALUES_COUNT};
+constexpr uint32_t SKIPS[] = {0, 3, 8};
+
+std::vector<SIMDLevel> getLevels()
+{
+    std::vector<SIMDLevel> levels;
+    for (SIMDLevel level : {SIMDLevel::SCALAR, SIMDLevel::SSE, SIMDLevel::AVX2})
+    {
+        if (level <= math::getSupportedSIMDLevel()) levels.push_back(level);
+    }
+
+    return levels;
+}
+
+// FMA rounds once, the scalar code twice, so AVX2 can differ in the last bit
+bool areEqual(float a, float b, SIMDLevel level)
+{
+    if (level != SIMDLevel::AVX2) return std::memcmp(&a, &b, sizeof(float)) == 0;
+
+    return std::fabs(a - b) <= std::fabs(b) * 2.0f * 1.2e-7f;
+}
+
+void testDeterminism()
+{
+    Random a(42);
+    Random b(42);
+    Random other_seed(43);
+    Random other_stream(42, 1);
+
+    uint32_t equal_count = 0;
+    uint32_t other_seed_count = 0;
+    uint32_t other_stream_count = 0;
+
+    std::vector<uint32_t> first;
+    for (uint32_t i = 0; i != VALUES_COUNT; ++i)
+    {
+        uint32_t value = a.next();
+        first.push_back(value);
+
+        equal_count += value == b.next();
+        other_seed_count += value == other_seed.next();
+        other_stream_count += value == other_stream.next();
+    }
+
+    CHECK(equal_count == VALUES_COUNT);
+    CHECK(other_seed_count < 5);
+    CHECK(other_stream_count < 5);
+
+    // setSeed() restarts the sequence, the buffered values are dropped
+    a.setSeed(42);
+    uint32_t restarted_count = 0;
+    for (uint32_t i = 0; i != VALUES_COUNT; ++i)
+        restarted_count += a.next() == first[i];
+
+    CHECK(restarted_count == VALUES_COUNT);
+}
+
+void testRanges()
+{
+    Random random(7);
+
+    for (uint32_t i = 0; i != 100000; ++i)
+    {
+        float value = random.nextFloat();
+        CHECK(value >= 0.0f && value < 1.0f);
+
+        float ranged = random.range(-3.0f, 5.0f);
+        CHECK(ranged >= -3.0f && ranged < 5.0f);
+
+        CHECK(random.index(13) < 13);
+    }
+}
+
+// fill() gives the same values as the same number of range() calls
+// and leaves the generator in the same state at every SIMD level
+void testFill()
+{
+    for (SIMDLevel level : getLevels())
+    {
+        for (uint32_t skip : SKIPS)
+        {
+            for (uint32_t count : COUNTS)
+            {
+                Random expected_random(1);
+                Random random(1);
+
+                for (uint32_t i = 0; i != skip; ++i)
+                {
+                    expected_random.next();
+                    random.next();
+                }
+
+                std::vector<float> values(count);
+                random.fill(values.data(), count, -2.0f, 10.0f, level);
+
+                uint32_t mismatches_count = 0;
+                for (uint32_t i = 0; i != count; ++i)
+                {
+                    if (!areEqual(values[i], expected_random.range(-2.0f, 10.0f), level))
+                        ++mismatches_count;
+                }
+
+                CHECK(mismatches_count == 0);
+                CHECK(random.next() == expected_random.next());
+            }
+        }
+    }
+}
+
+void testFillVec3()
+{
+    glm::vec3 min(-1.0f, 0.0f, 100.0f);
+    glm::vec3 max(1.0f, 0.5f, 200.0f);
+
+    for (SIMDLevel level : getLevels())
+    {
+        Random expected_random(2);
+        Random random(2);
+
+        std::vector<glm::vec3> values(VALUES_COUNT);
+        random.fill(values.data(), VALUES_COUNT, min, max, level);
+
+        // [0; 1) is filled first, FMA doesn't change it
+        uint32_t mismatches_count = 0;
+        for (uint32_t i = 0; i != VALUES_COUNT; ++i)
+        {
+            glm::vec3 expected = expected_random.range(min, max);
+            if (values[i].x != expected.x ||
+                values[i].y != expected.y ||
+                values[i].z != expected.z) ++mismatches_count;
+        }
+
+        CHECK(mismatches_count == 0);
+        CHECK(random.next() == expected_random.next());
+    }
+}
+
+void testFillAngles()
+{
+    for (SIMDLevel level : getLevels())
+    {
+        Random random(3);
+
+        std::vector<float> angles(VALUES_COUNT);
+        random.fillAngles(angles.data(), VALUES_COUNT, level);
+
+        for (float angle : angles)
+            CHECK(angle >= 0.0f && angle <= 2.0f * math::PI);
+    }
+}
+} // namespace
+
+int main()
+{
+    testDeterminism();
+    testRanges();
+    testFill();
+    testFillVec3();
+    testFillAngles();
+
+    return test::checkResult();
+}
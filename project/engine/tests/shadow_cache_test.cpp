@@ -0,0 +1,201 @@
+#include "check.hpp"
+#include "shadow_cache.hpp"
+
+#include <vector>
+
+namespace
+{
+using engine::ShadowCache;
+
+constexpr uint32_t ALL_FACES = (1u << ShadowCache::FACES_COUNT) - 1;
+
+// a caster is drawn into one face of one cubemap,
+// its signature stands for the hash of the transform
+struct Caster
+{
+    uint32_t cubemap;
+    uint32_t face;
+    uint64_t signature;
+};
+
+// one frame of the renderer: every face gets the hash of its casters
+void renderFrame(ShadowCache & cache,
+                 const std::vector<glm::vec3> & lights,
+                 const std::vector<Caster> & casters)
+{
+    cache.begin(lights.data(), uint32_t(lights.size()));
+
+    for (uint32_t c = 0, cubemaps_count = lights.size(); c != cubemaps_count; ++c)
+    {
+        for (uint32_t face = 0; face != ShadowCache::FACES_COUNT; ++face)
+        {
+            uint64_t signature = engine::hashBytes(nullptr, 0);
+
+            for (const Caster & caster : casters)
+            {
+                if (caster.cubemap == c && caster.face == face)
+                    signature = engine::hashBytes(&caster.signature, sizeof(uint64_t), signature);
+            }
+
+            cache.addCasters(c, face, signature);
+        }
+    }
+
+    cache.end();
+}
+
+struct Scene
+{
+    std::vector<glm::vec3> lights = {glm::vec3(0.0f), glm::vec3(10.0f, 0.0f, 0.0f)};
+    std::vector<Caster> casters = {{0, 0, 100}, {0, 0, 101}, {0, 3, 102}, {1, 5, 103}};
+};
+
+// the first frame renders everything, the second one nothing
+ShadowCache makeRendered(const Scene & scene)
+{
+    ShadowCache cache;
+
+    renderFrame(cache, scene.lights, scene.casters);
+    renderFrame(cache, scene.lights, scene.casters);
+
+    return cache;
+}
+
+void testFirstFrame()
+{
+    Scene scene;
+    ShadowCache cache;
+
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getCubemapsCount() == 2);
+    CHECK(cache.getFaceMask(0) == ALL_FACES);
+    CHECK(cache.getFaceMask(1) == ALL_FACES);
+    CHECK(cache.getInvalidFacesCount() == 2 * ShadowCache::FACES_COUNT);
+    CHECK(cache.getSavedFacesCount() == 0);
+
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getFaceMask(0) == 0);
+    CHECK(cache.getFaceMask(1) == 0);
+    CHECK(cache.getInvalidFacesCount() == 0);
+    CHECK(cache.getSavedFacesCount() == 2 * ShadowCache::FACES_COUNT);
+}
+
+void testMovedLight()
+{
+    Scene scene;
+    ShadowCache cache = makeRendered(scene);
+
+    // all faces of the moved light, even the ones without casters
+    scene.lights[1].y += 0.5f;
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getFaceMask(0) == 0);
+    CHECK(cache.getFaceMask(1) == ALL_FACES);
+    CHECK(cache.getSavedFacesCount() == ShadowCache::FACES_COUNT);
+
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getFaceMask(1) == 0);
+}
+
+void testMovedCaster()
+{
+    Scene scene;
+    ShadowCache cache = makeRendered(scene);
+
+    scene.casters[1].signature = 201;
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getFaceMask(0) == 1u << 0);
+    CHECK(cache.isFaceInvalid(0, 0));
+    CHECK(!cache.isFaceInvalid(0, 3));
+    CHECK(cache.getFaceMask(1) == 0);
+    CHECK(cache.getInvalidFacesCount() == 1);
+    CHECK(cache.getSavedFacesCount() == 2 * ShadowCache::FACES_COUNT - 1);
+
+    // a caster moved into another face invalidates both of them
+    scene.casters[2].face = 4;
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getFaceMask(0) == ((1u << 3) | (1u << 4)));
+    CHECK(cache.getInvalidFacesCount() == 2);
+}
+
+void testSpawnedCaster()
+{
+    Scene scene;
+    ShadowCache cache = makeRendered(scene);
+
+    scene.casters.push_back({1, 2, 104});
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getFaceMask(0) == 0);
+    CHECK(cache.getFaceMask(1) == 1u << 2);
+    CHECK(cache.getInvalidFacesCount() == 1);
+}
+
+void testDespawnedCaster()
+{
+    Scene scene;
+    ShadowCache cache = makeRendered(scene);
+
+    // the face has other casters, but one is missing
+    scene.casters.erase(scene.casters.begin());
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getFaceMask(0) == 1u << 0);
+    CHECK(cache.getFaceMask(1) == 0);
+
+    // the last caster of the face, it has to be cleared
+    scene.casters.pop_back();
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getFaceMask(0) == 0);
+    CHECK(cache.getFaceMask(1) == 1u << 5);
+    CHECK(cache.getInvalidFacesCount() == 1);
+}
+
+void testNewCubemaps()
+{
+    Scene scene;
+    ShadowCache cache = makeRendered(scene);
+
+    // the new cubemap was never rendered, the old ones are kept
+    scene.lights.push_back(glm::vec3(0.0f, 10.0f, 0.0f));
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getCubemapsCount() == 3);
+    CHECK(cache.getFaceMask(0) == 0);
+    CHECK(cache.getFaceMask(1) == 0);
+    CHECK(cache.getFaceMask(2) == ALL_FACES);
+    CHECK(cache.getSavedFacesCount() == 2 * ShadowCache::FACES_COUNT);
+
+    // the removed light doesn't affect the remaining ones
+    scene.lights.pop_back();
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getCubemapsCount() == 2);
+    CHECK(cache.getInvalidFacesCount() == 0);
+
+    // and a light added again after being removed is rendered again
+    scene.lights.push_back(glm::vec3(0.0f, 10.0f, 0.0f));
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getFaceMask(2) == ALL_FACES);
+}
+
+void testInvalidate()
+{
+    Scene scene;
+    ShadowCache cache = makeRendered(scene);
+
+    cache.invalidate();
+    renderFrame(cache, scene.lights, scene.casters);
+    CHECK(cache.getFaceMask(0) == ALL_FACES);
+    CHECK(cache.getFaceMask(1) == ALL_FACES);
+    CHECK(cache.getSavedFacesCount() == 0);
+}
+} // namespace
+
+int main()
+{
+    testFirstFrame();
+    testMovedLight();
+    testMovedCaster();
+    testSpawnedCaster();
+    testDespawnedCaster();
+    testNewCubemaps();
+    testInvalidate();
+
+    return test::checkResult();
+}
@@ -0,0 +1,151 @@
+#include "check.hpp"
+#include "state_cache.hpp"
+
+namespace
+{
+using engine::StateCache;
+using State = StateCache::State;
+
+// stands for D3D objects, only the addresses are compared
+struct Object {};
+
+Object shader_a, shader_b;
+Object buffer_a, buffer_b;
+Object srv_a, srv_b, srv_c;
+
+void testSkipCounting()
+{
+    StateCache cache;
+
+    // nothing is known about the state at the start
+    CHECK(cache.set(State::PIXEL_SHADER, &shader_a));
+    CHECK(!cache.set(State::PIXEL_SHADER, &shader_a));
+    CHECK(!cache.set(State::PIXEL_SHADER, &shader_a));
+    CHECK(cache.set(State::PIXEL_SHADER, &shader_b));
+
+    // states don't share the cached values
+    CHECK(cache.set(State::VERTEX_SHADER, &shader_b));
+    CHECK(!cache.set(State::VERTEX_SHADER, &shader_b));
+
+    // unbinding is cached as well
+    CHECK(cache.set(State::GEOMETRY_SHADER, nullptr));
+    CHECK(!cache.set(State::GEOMETRY_SHADER, nullptr));
+
+    cache.beginFrame();
+    CHECK(cache.getIssuedCount() == 4);
+    CHECK(cache.getSkippedCount() == 4);
+}
+
+void testBeginFrame()
+{
+    StateCache cache;
+
+    // no frame was finished yet
+    CHECK(cache.getIssuedCount() == 0);
+    CHECK(cache.getSkippedCount() == 0);
+
+    cache.set(State::RASTERIZER, &shader_a);
+    cache.set(State::RASTERIZER, &shader_a);
+
+    // the counters of the current frame aren't visible until it ends
+    CHECK(cache.getIssuedCount() == 0);
+
+    cache.beginFrame();
+    CHECK(cache.getIssuedCount() == 1);
+    CHECK(cache.getSkippedCount() == 1);
+
+    // the bound state survives the frame
+    cache.set(State::RASTERIZER, &shader_a);
+    cache.set(State::RASTERIZER, &shader_a);
+    cache.set(State::RASTERIZER, &shader_a);
+
+    cache.beginFrame();
+    CHECK(cache.getIssuedCount() == 0);
+    CHECK(cache.getSkippedCount() == 3);
+
+    // a frame without calls
+    cache.beginFrame();
+    CHECK(cache.getIssuedCount() == 0);
+    CHECK(cache.getSkippedCount() == 0);
+}
+
+void testVertexBuffers()
+{
+    StateCache cache;
+
+    CHECK(cache.setVertexBuffer(0, &buffer_a, 16, 0));
+    CHECK(!cache.setVertexBuffer(0, &buffer_a, 16, 0));
+
+    CHECK(cache.setVertexBuffer(0, &buffer_a, 32, 0));
+    CHECK(cache.setVertexBuffer(0, &buffer_a, 32, 64));
+    CHECK(cache.setVertexBuffer(0, &buffer_b, 32, 64));
+    CHECK(!cache.setVertexBuffer(0, &buffer_b, 32, 64));
+
+    // slots are independent
+    CHECK(cache.setVertexBuffer(1, &buffer_b, 32, 64));
+    CHECK(!cache.setVertexBuffer(0, &buffer_b, 32, 64));
+
+    CHECK(cache.setVertexBuffer(1, nullptr, 0, 0));
+    CHECK(!cache.setVertexBuffer(1, nullptr, 0, 0));
+}
+
+void testPixelSRVs()
+{
+    StateCache cache;
+
+    Object * srvs[] = {&srv_a, &srv_b, nullptr};
+    CHECK(cache.setPixelSRVs(0, 3, srvs));
+    CHECK(!cache.setPixelSRVs(0, 3, srvs));
+
+    // the range is issued if any slot differs
+    Object * changed[] = {&srv_c, nullptr};
+    CHECK(cache.setPixelSRVs(1, 2, changed));
+
+    Object * changed_last[] = {&srv_a, &srv_b, &srv_c};
+    CHECK(cache.setPixelSRVs(0, 3, changed_last));
+    CHECK(!cache.setPixelSRVs(1, 2, changed_last + 1));
+}
+
+void testInvalidate()
+{
+    StateCache cache;
+
+    Object * srvs[] = {&srv_a, nullptr};
+    Object * no_srvs[] = {nullptr, nullptr};
+
+    cache.set(State::BLEND_STATE, &shader_a);
+    cache.set(State::INPUT_LAYOUT, nullptr);
+    cache.setVertexBuffer(2, &buffer_a, 16, 0);
+    cache.setPixelSRVs(4, 2, srvs);
+    cache.setPixelSRVs(8, 2, no_srvs);
+
+    // only the SRVs are forgotten, including the slots bound as nullptr
+    cache.invalidatePixelSRVs();
+    CHECK(cache.setPixelSRVs(4, 2, srvs));
+    CHECK(cache.setPixelSRVs(8, 2, no_srvs));
+    CHECK(!cache.set(State::BLEND_STATE, &shader_a));
+    CHECK(!cache.setVertexBuffer(2, &buffer_a, 16, 0));
+
+    // everything is issued again, nullptr too
+    cache.invalidate();
+    CHECK(cache.set(State::BLEND_STATE, &shader_a));
+    CHECK(cache.set(State::INPUT_LAYOUT, nullptr));
+    CHECK(cache.setVertexBuffer(2, &buffer_a, 16, 0));
+    CHECK(cache.setPixelSRVs(4, 2, srvs));
+    CHECK(cache.setPixelSRVs(8, 2, no_srvs));
+
+    CHECK(!cache.set(State::INPUT_LAYOUT, nullptr));
+    CHECK(!cache.setPixelSRVs(8, 2, no_srvs));
+}
+} // namespace
+
+int main()
+{
+    testSkipCounting();
+    testBeginFrame();
+    testVertexBuffers();
+    testPixelSRVs();
+    testInvalidate();
+
+    return test::checkResult();
+}
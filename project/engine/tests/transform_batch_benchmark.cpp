@@ -0,0 +1,96 @@
+#include "benchmark.hpp"
+#include "transform_batch.hpp"
+
+#include <vector>
+#include <random>
+
+namespace
+{
+constexpr uint32_t TRANSFORMS_COUNT = 100000;
+constexpr uint32_t RUNS_COUNT = 20;
+
+std::vector<math::Transform> generateTransforms()
+{
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+    std::vector<math::Transform> transforms;
+    for (uint32_t i = 0; i != TRANSFORMS_COUNT; ++i)
+    {
+        transforms.push_back(math::Transform(glm::vec3(position(generator), position(generator), position(generator)),
+                                             math::EulerAngles(angle(generator), angle(generator), angle(generator)),
+                                             glm::vec3(scale(generator), scale(generator), scale(generator))));
+    }
+
+    return transforms;
+}
+
+float getMaxError(const glm::mat4 & expected, const glm::mat4x3 & actual)
+{
+    float error = 0.0f;
+    for (int column = 0; column != 4; ++column)
+    {
+        for (int row = 0; row != 3; ++row)
+            error = std::max(error, std::fabs(expected[column][row] - actual[column][row]));
+    }
+
+    return error;
+}
+} // namespace
+
+int main()
+{
+    std::vector<math::Transform> transforms = generateTransforms();
+
+    math::TransformBatch batch;
+    for (const math::Transform & transform : transforms) batch.push_back(transform);
+
+    std::vector<glm::mat4> matrices(TRANSFORMS_COUNT);
+    std::vector<glm::mat4> matrices_inv(TRANSFORMS_COUNT);
+    std::vector<glm::mat4x3> world(TRANSFORMS_COUNT);
+    std::vector<glm::mat4x3> world_inv(TRANSFORMS_COUNT);
+
+    std::printf("%u transforms, ns per transform:\n", TRANSFORMS_COUNT);
+
+    double to_mat4 = test::measure(TRANSFORMS_COUNT, RUNS_COUNT, [&]()
+    {
+        for (uint32_t i = 0; i != TRANSFORMS_COUNT; ++i)
+            matrices[i] = transforms[i].toMat4();
+    });
+    std::printf("  Transform::toMat4()                %7.2f\n", to_mat4);
+
+    double to_mat4_inverse = test::measure(TRANSFORMS_COUNT, RUNS_COUNT, [&]()
+    {
+        for (uint32_t i = 0; i != TRANSFORMS_COUNT; ++i)
+        {
+            matrices[i] = transforms[i].toMat4();
+            matrices_inv[i] = glm::inverse(matrices[i]);
+        }
+    });
+    std::printf("  toMat4() + glm::inverse()          %7.2f\n", to_mat4_inverse);
+
+    test::forEachLevel([&](math::SIMDLevel level)
+    {
+        double batched = test::measure(TRANSFORMS_COUNT, RUNS_COUNT, [&]()
+        {
+            math::computeAffineMatrices(batch, world.data(), world_inv.data(), level);
+        });
+
+        float error = 0.0f;
+        for (uint32_t i = 0; i != TRANSFORMS_COUNT; ++i)
+        {
+            error = std::max(error, getMaxError(matrices[i], world[i]));
+            error = std::max(error, getMaxError(matrices_inv[i], world_inv[i]));
+        }
+
+        std::printf("  computeAffineMatrices(), %-6s    %7.2f (x%.1f, max error %g)\n",
+                    test::getLevelName(level),
+                    batched,
+                    to_mat4_inverse / batched,
+                    error);
+    });
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "check.hpp"
+#include "transform_system.hpp"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+using engine::TransformSystem;
+
+constexpr uint32_t NODES_COUNT = 1000;
+constexpr uint32_t ERASED_COUNT = 300;
+
+// translations only, so the world position is the sum along the parents
+math::Transform translation(const glm::vec3 & position)
+{
+    return math::Transform(position, math::EulerAngles(0.0f, 0.0f, 0.0f), glm::vec3(1.0f));
+}
+
+glm::vec3 getWorldPos(TransformSystem * trans_sys, uint32_t transform_id)
+{
+    return trans_sys->getWorld(transform_id)[3];
+}
+
+glm::vec3 getExpectedPos(TransformSystem * trans_sys, uint32_t transform_id)
+{
+    glm::vec3 position(0.0f);
+    for (uint32_t id = transform_id; id != TransformSystem::NO_PARENT; id = trans_sys->getParent(id))
+        position += trans_sys->getTransform(id).position;
+
+    return position;
+}
+
+bool areClose(const glm::vec3 & a, const glm::vec3 & b)
+{
+    return test::areClose(a.x, b.x, 1e-3f) &&
+           test::areClose(a.y, b.y, 1e-3f) &&
+           test::areClose(a.z, b.z, 1e-3f);
+}
+
+void testHierarchy()
+{
+    TransformSystem::init();
+    TransformSystem * trans_sys = TransformSystem::getInstance();
+
+    uint32_t a = trans_sys->insert(translation(glm::vec3(1.0f, 0.0f, 0.0f)));
+    uint32_t b = trans_sys->insert(translation(glm::vec3(0.0f, 2.0f, 0.0f)), a);
+    uint32_t c = trans_sys->insert(translation(glm::vec3(0.0f, 0.0f, 3.0f)), b);
+    uint32_t d = trans_sys->insert(translation(glm::vec3(0.0f, 5.0f, 0.0f)), a);
+
+    CHECK(areClose(getWorldPos(trans_sys, c), glm::vec3(1.0f, 2.0f, 3.0f)));
+    CHECK(areClose(getWorldPos(trans_sys, d), glm::vec3(1.0f, 5.0f, 0.0f)));
+
+    // children follow the modified parent
+    trans_sys->modifyTransform(a).position = glm::vec3(10.0f, 0.0f, 0.0f);
+    trans_sys->updateMatrices();
+    CHECK(areClose(getWorldPos(trans_sys, c), glm::vec3(10.0f, 2.0f, 3.0f)));
+    CHECK(areClose(getWorldPos(trans_sys, d), glm::vec3(10.0f, 5.0f, 0.0f)));
+
+    // c is moved to the parent of b
+    trans_sys->erase(b);
+    CHECK(!trans_sys->isValid(b));
+    CHECK(trans_sys->getParent(c) == a);
+    CHECK(areClose(getWorldPos(trans_sys, c), glm::vec3(10.0f, 0.0f, 3.0f)));
+    CHECK(areClose(getWorldPos(trans_sys, d), glm::vec3(10.0f, 5.0f, 0.0f)));
+
+    // children of a root become roots
+    trans_sys->erase(a);
+    CHECK(trans_sys->getParent(c) == TransformSystem::NO_PARENT);
+    CHECK(trans_sys->getParent(d) == TransformSystem::NO_PARENT);
+    CHECK(areClose(getWorldPos(trans_sys, c), glm::vec3(0.0f, 0.0f, 3.0f)));
+    CHECK(areClose(getWorldPos(trans_sys, d), glm::vec3(0.0f, 5.0f, 0.0f)));
+
+    // the slot of a is reused, the stale id stays invalid
+    uint32_t e = trans_sys->insert(translation(glm::vec3(1.0f)), c);
+    CHECK(!trans_sys->isValid(a));
+    CHECK(trans_sys->findWorld(a) == nullptr);
+    CHECK(areClose(getWorldPos(trans_sys, e), glm::vec3(1.0f, 1.0f, 4.0f)));
+
+    TransformSystem::del();
+}
+
+// random trees, random modifications and erases of inner nodes
+void testRandomHierarchy()
+{
+    TransformSystem::init();
+    TransformSystem * trans_sys = TransformSystem::getInstance();
+
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+
+    std::vector<uint32_t> ids;
+    for (uint32_t i = 0; i != NODES_COUNT; ++i)
+    {
+        uint32_t parent_id = ids.empty() || generator() % 8 == 0 ?
+            TransformSystem::NO_PARENT :
+            ids[generator() % ids.size()];
+
+        glm::vec3 local(position(generator), position(generator), position(generator));
+        ids.push_back(trans_sys->insert(translation(local), parent_id));
+    }
+    trans_sys->updateMatrices();
+
+    for (uint32_t i = 0; i != ERASED_COUNT; ++i)
+    {
+        uint32_t index = generator() % ids.size();
+
+        trans_sys->erase(ids[index]);
+        ids[index] = ids.back();
+        ids.pop_back();
+
+        uint32_t modified_id = ids[generator() % ids.size()];
+        trans_sys->modifyTransform(modified_id).position += glm::vec3(position(generator));
+
+        if (i % 16 == 0) trans_sys->updateMatrices();
+    }
+
+    uint32_t mismatches = 0;
+    for (uint32_t id : ids)
+        mismatches += !areClose(getWorldPos(trans_sys, id), getExpectedPos(trans_sys, id));
+
+    CHECK(mismatches == 0);
+
+    TransformSystem::del();
+}
+} // namespace
+
+int main()
+{
+    testHierarchy();
+    testRandomHierarchy();
+
+    return test::checkResult();
+}
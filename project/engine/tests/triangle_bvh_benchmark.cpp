@@ -0,0 +1,126 @@
+#include "benchmark.hpp"
+#include "triangle_bvh.hpp"
+
+#include <vector>
+#include <random>
+
+namespace
+{
+constexpr uint32_t TRIANGLES_COUNT = 100000;
+constexpr uint32_t IMAGE_WIDTH = 256;
+constexpr uint32_t IMAGE_HEIGHT = 256;
+constexpr uint32_t RUNS_COUNT = 10;
+
+// packets are tiles of 4x2 pixels
+constexpr uint32_t TILE_WIDTH = 4;
+constexpr uint32_t TILE_HEIGHT = math::RayPacket::SIZE / TILE_WIDTH;
+
+std::shared_ptr<math::Mesh> generateMesh()
+{
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+
+    auto mesh = std::make_shared<math::Mesh>();
+    mesh->box = math::BoundingBox::empty();
+
+    // small triangles without an index buffer
+    for (uint32_t i = 0; i != TRIANGLES_COUNT; ++i)
+    {
+        glm::vec3 center(position(generator), position(generator), position(generator));
+
+        for (uint32_t v = 0; v != 3; ++v)
+        {
+            engine::Vertex vertex = {};
+            vertex.position = center + glm::vec3(offset(generator), offset(generator), offset(generator));
+
+            mesh->box.expand(vertex.position);
+            mesh->vertices.push_back(vertex);
+        }
+    }
+
+    return mesh;
+}
+
+// primary rays of a camera at z = -30 looking at the origin, in tile order
+std::vector<math::Ray> generateRays()
+{
+    std::vector<math::Ray> rays;
+    glm::vec3 origin(0.0f, 0.0f, -30.0f);
+
+    for (uint32_t tile_y = 0; tile_y != IMAGE_HEIGHT; tile_y += TILE_HEIGHT)
+    {
+        for (uint32_t tile_x = 0; tile_x != IMAGE_WIDTH; tile_x += TILE_WIDTH)
+        {
+            for (uint32_t y = tile_y; y != tile_y + TILE_HEIGHT; ++y)
+            {
+                for (uint32_t x = tile_x; x != tile_x + TILE_WIDTH; ++x)
+                {
+                    glm::vec3 direction((x + 0.5f) / IMAGE_WIDTH - 0.5f,
+                                        (y + 0.5f) / IMAGE_HEIGHT - 0.5f,
+                                        1.0f);
+                    rays.push_back(math::Ray(origin, direction));
+                }
+            }
+        }
+    }
+
+    return rays;
+}
+} // namespace
+
+int main()
+{
+    math::TriangleBVH bvh;
+    bvh.initialize(generateMesh());
+
+    std::vector<math::Ray> rays = generateRays();
+    std::vector<math::MeshIntersection> nearest(rays.size());
+    uint32_t rays_count = uint32_t(rays.size());
+
+    std::printf("%u triangles, %u rays, ns per ray:\n", TRIANGLES_COUNT, rays_count);
+
+    uint32_t hits_count = 0;
+
+    test::forEachLevel([&](math::SIMDLevel level)
+    {
+        math::setSIMDLevel(level);
+
+        double single = test::measure(rays_count, RUNS_COUNT, [&]()
+        {
+            for (uint32_t i = 0; i != rays_count; ++i)
+            {
+                nearest[i].reset(0.0f);
+                bvh.intersect(rays[i], nearest[i]);
+            }
+        });
+
+        double packets = test::measure(rays_count, RUNS_COUNT, [&]()
+        {
+            for (uint32_t first = 0; first != rays_count; first += math::RayPacket::SIZE)
+            {
+                math::RayPacket packet;
+                packet.clear();
+                for (uint32_t i = 0; i != math::RayPacket::SIZE; ++i)
+                {
+                    packet.set(i, rays[first + i]);
+                    nearest[first + i].reset(0.0f);
+                }
+
+                bvh.intersect(packet, nearest.data() + first);
+            }
+        });
+
+        std::printf("  %-6s  single rays %8.1f  packets %8.1f (x%.2f)\n",
+                    test::getLevelName(level),
+                    single,
+                    packets,
+                    single / packets);
+    });
+
+    // keeps the results alive
+    for (const math::MeshIntersection & intersection : nearest) hits_count += intersection.valid();
+    std::printf("%u hits\n", hits_count);
+
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include "check.hpp"
+#include "triangle_bvh.hpp"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+using math::Ray;
+using math::RayPacket;
+using math::SIMDLevel;
+using math::MeshIntersection;
+
+constexpr uint32_t TRIANGLES_COUNT = 2000;
+constexpr uint32_t PACKETS_COUNT = 500;
+constexpr float SCENE_SIZE = 10.0f;
+
+std::shared_ptr<math::Mesh> createMesh(std::mt19937 & generator)
+{
+    std::uniform_real_distribution<float> position(-SCENE_SIZE, SCENE_SIZE);
+    std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+
+    auto mesh = std::make_shared<math::Mesh>();
+    mesh->box = math::BoundingBox::empty();
+
+    for (uint32_t i = 0; i != TRIANGLES_COUNT; ++i)
+    {
+        glm::vec3 center(position(generator), position(generator), position(generator));
+
+        math::Mesh::Triangle triangle;
+        for (uint32_t v = 0; v != 3; ++v)
+        {
+            engine::Vertex vertex = {};
+            vertex.position = center + glm::vec3(offset(generator), offset(generator), offset(generator));
+
+            mesh->box.expand(vertex.position);
+            triangle.indices[v] = uint32_t(mesh->vertices.size());
+            mesh->vertices.push_back(vertex);
+        }
+        mesh->triangles.push_back(triangle);
+    }
+
+    return mesh;
+}
+
+// coherent rays from near one point towards near one target,
+// like the rays of neighbouring pixels
+std::vector<Ray> createRays(std::mt19937 & generator)
+{
+    std::uniform_real_distribution<float> position(-2.0f * SCENE_SIZE, 2.0f * SCENE_SIZE);
+    std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+
+    std::vector<Ray> rays;
+    for (uint32_t p = 0; p != PACKETS_COUNT; ++p)
+    {
+        glm::vec3 origin(position(generator), position(generator), position(generator));
+        glm::vec3 target = 0.5f * glm::vec3(position(generator), position(generator), position(generator));
+
+        for (uint32_t i = 0; i != RayPacket::SIZE; ++i)
+        {
+            glm::vec3 jitter_vec(jitter(generator), jitter(generator), jitter(generator));
+            rays.push_back(Ray(origin, target + jitter_vec - origin));
+        }
+    }
+
+    return rays;
+}
+
+bool areSame(const MeshIntersection & a, const MeshIntersection & b)
+{
+    if (a.valid() != b.valid()) return false;
+    if (!a.valid()) return true;
+
+    return a.triangle == b.triangle && test::areClose(a.t, b.t);
+}
+
+std::vector<MeshIntersection> intersectRays(const math::TriangleBVH & bvh,
+                                            const std::vector<Ray> & rays)
+{
+    std::vector<MeshIntersection> result(rays.size());
+    for (uint32_t i = 0, size = uint32_t(rays.size()); i != size; ++i)
+    {
+        result[i].reset(0.0f);
+        bvh.intersect(rays[i], result[i]);
+    }
+
+    return result;
+}
+
+// packets must find exactly what single rays find, at every level
+void testPacketsMatchRays()
+{
+    std::mt19937 generator(1);
+
+    math::TriangleBVH bvh;
+    bvh.initialize(createMesh(generator));
+
+    std::vector<Ray> rays = createRays(generator);
+
+    math::setSIMDLevel(SIMDLevel::SCALAR);
+    std::vector<MeshIntersection> expected = intersectRays(bvh, rays);
+
+    uint32_t hits_count = 0;
+    for (const MeshIntersection & intersection : expected) hits_count += intersection.valid();
+
+    // both hits and misses are tested
+    CHECK(hits_count != 0);
+    CHECK(hits_count != rays.size());
+
+    for (SIMDLevel level : {SIMDLevel::SCALAR, SIMDLevel::SSE, SIMDLevel::AVX2})
+    {
+        if (level > math::getSupportedSIMDLevel()) continue;
+        math::setSIMDLevel(level);
+
+        // single rays use SoA triangle blocks of the level
+        std::vector<MeshIntersection> single = intersectRays(bvh, rays);
+
+        uint32_t single_mismatches = 0;
+        uint32_t packet_mismatches = 0;
+        uint32_t found_mismatches = 0;
+
+        for (uint32_t first = 0, size = uint32_t(rays.size()); first != size; first += RayPacket::SIZE)
+        {
+            RayPacket packet;
+            packet.clear();
+
+            MeshIntersection nearest[RayPacket::SIZE];
+            for (uint32_t i = 0; i != RayPacket::SIZE; ++i)
+            {
+                packet.set(i, rays[first + i]);
+                nearest[i].reset(0.0f);
+            }
+
+            uint32_t found = bvh.intersect(packet, nearest);
+
+            for (uint32_t i = 0; i != RayPacket::SIZE; ++i)
+            {
+                single_mismatches += !areSame(single[first + i], expected[first + i]);
+                packet_mismatches += !areSame(nearest[i], expected[first + i]);
+                found_mismatches += bool(found & (1u << i)) != expected[first + i].valid();
+            }
+        }
+
+        CHECK(single_mismatches == 0);
+        CHECK(packet_mismatches == 0);
+        CHECK(found_mismatches == 0);
+    }
+
+    math::setSIMDLevel(math::getSupportedSIMDLevel());
+}
+
+// lanes out of the mask are neither traced nor written
+void testPartialPackets()
+{
+    std::mt19937 generator(2);
+
+    math::TriangleBVH bvh;
+    bvh.initialize(createMesh(generator));
+
+    std::vector<Ray> rays = createRays(generator);
+    std::vector<MeshIntersection> expected = intersectRays(bvh, rays);
+
+    uint32_t mismatches = 0;
+    uint32_t written_count = 0;
+
+    for (uint32_t first = 0, size = uint32_t(rays.size()); first != size; first += RayPacket::SIZE)
+    {
+        uint32_t lanes_count = 1 + (first / RayPacket::SIZE) % RayPacket::SIZE;
+
+        RayPacket packet;
+        packet.clear();
+
+        MeshIntersection nearest[RayPacket::SIZE];
+        for (uint32_t i = 0; i != RayPacket::SIZE; ++i) nearest[i].reset(0.0f);
+        for (uint32_t i = 0; i != lanes_count; ++i) packet.set(i, rays[first + i]);
+
+        uint32_t found = bvh.intersect(packet, nearest);
+
+        for (uint32_t i = 0; i != lanes_count; ++i)
+            mismatches += !areSame(nearest[i], expected[first + i]);
+
+        for (uint32_t i = lanes_count; i != RayPacket::SIZE; ++i)
+            written_count += nearest[i].valid() || (found & (1u << i));
+    }
+
+    CHECK(mismatches == 0);
+    CHECK(written_count == 0);
+
+    // an empty packet finds nothing
+    RayPacket packet;
+    packet.clear();
+    MeshIntersection nearest[RayPacket::SIZE];
+    for (uint32_t i = 0; i != RayPacket::SIZE; ++i) nearest[i].reset(0.0f);
+
+    CHECK(bvh.intersect(packet, nearest) == 0);
+}
+} // namespace
+
+int main()
+{
+    testPacketsMatchRays();
+    testPartialPackets();
+
+    return test::checkResult();
+}